@@ -515,6 +515,7 @@ class fetch(Command):
 build_enable = None
 build_omit = None
 build_enable_all_extensions = False
+build_enable_scanstatus = False
 
 bparent = build.build
 
@@ -524,21 +525,24 @@ class apsw_build(bparent):
                   [ ("enable=", None, "Enable SQLite options (comma separated list)"),
                     ("omit=", None, "Omit SQLite functionality (comma separated list)"),
                     ("enable-all-extensions", None, "Enable all SQLite extensions"),
+                    ("enable-scanstatus", None, "Enable query plan scan status (Cursor.scanstatus)"),
                     ]
-    boolean_options = bparent.boolean_options + ["enable-all-extensions"]
+    boolean_options = bparent.boolean_options + ["enable-all-extensions", "enable-scanstatus"]
 
     def initialize_options(self):
         v = bparent.initialize_options(self)
         self.enable = None
         self.omit = None
         self.enable_all_extensions = build_enable_all_extensions
+        self.enable_scanstatus = build_enable_scanstatus
         return v
 
     def finalize_options(self):
-        global build_enable, build_omit, build_enable_all_extensions
+        global build_enable, build_omit, build_enable_all_extensions, build_enable_scanstatus
         build_enable = self.enable
         build_omit = self.omit
         build_enable_all_extensions = self.enable_all_extensions
+        build_enable_scanstatus = self.enable_scanstatus
         return bparent.finalize_options(self)
 
 
@@ -568,19 +572,27 @@ class apsw_build_ext(beparent):
                   [ ("enable=", None, "Enable SQLite options (comma separated list)"),
                     ("omit=", None, "Omit SQLite functionality (comma separated list)"),
                     ("enable-all-extensions", None, "Enable all SQLite extensions"),
+                    ("enable-scanstatus", None, "Enable query plan scan status (Cursor.scanstatus)"),
                     ]
-    boolean_options = beparent.boolean_options + ["enable-all-extensions"]
+    boolean_options = beparent.boolean_options + ["enable-all-extensions", "enable-scanstatus"]
 
     def initialize_options(self):
         v = beparent.initialize_options(self)
         self.enable = build_enable
         self.omit = build_omit
         self.enable_all_extensions = build_enable_all_extensions
+        self.enable_scanstatus = build_enable_scanstatus
         return v
 
     def finalize_options(self):
         v = beparent.finalize_options(self)
 
+        if self.enable_scanstatus:
+            if not self.enable:
+                self.enable = "stmt_scanstatus"
+            else:
+                self.enable = self.enable + ",stmt_scanstatus"
+
         if self.enable_all_extensions:
             exts = ["fts4", "fts3", "fts3_parenthesis", "rtree", "stat4", "json1", "fts5", "rbu", "geopoly"]
             if find_in_path("icu-config"):
@@ -734,6 +746,12 @@ class apsw_build_ext(beparent):
                os.path.getmtime(__file__)>os.path.getmtime("src/shell.c"):
             create_c_file("tools/shell.py", "src/shell.c")
 
+        # asyncio
+        if not os.path.exists("src/aio.c") or \
+               os.path.getmtime("src/aio.c")<os.path.getmtime("tools/aio.py") or \
+               os.path.getmtime(__file__)>os.path.getmtime("src/aio.c"):
+            create_c_file("tools/aio.py", "src/aio.c")
+
         # done ...
         return v
 
@@ -880,6 +898,7 @@ for f in (findamalgamation(), ):
         depends.append(f)
 # we produce a .c file from this
 depends.append("tools/shell.py")
+depends.append("tools/aio.py")
 
 # work out version number
 version = read_whole_file(os.path.join("src", "apswversion.h"), "rt").split()[2].strip('"')
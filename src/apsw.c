@@ -66,6 +66,12 @@ API Reference
 /* system headers */
 #include <assert.h>
 #include <stdarg.h>
+#ifdef _WIN32
+#include <io.h>
+#define apsw_write(fd, buf, len) _write((fd), (buf), (unsigned)(len))
+#else
+#define apsw_write write
+#endif
 
 /* Get the version number */
 #include "apswversion.h"
@@ -156,9 +162,18 @@ static PyObject *apswmodule;
 /* Zeroblob and blob */
 #include "blob.c"
 
+/* Arrow C Data Interface export */
+#include "arrow.c"
+
 /* cursors */
 #include "cursor.c"
 
+/* prepared statements */
+#include "prepared.c"
+
+/* connection pools */
+#include "pool.c"
+
 /* virtual tables */
 #include "vtable.c"
 
@@ -1254,6 +1269,7 @@ static PyMethodDef module_methods[] = {
 };
 
 static void add_shell(PyObject *module);
+static void add_aio(PyObject *module);
 
 #if PY_MAJOR_VERSION >= 3
 static struct PyModuleDef apswmoduledef = {
@@ -1291,7 +1307,7 @@ PyInit_apsw(void)
     goto fail;
   }
 
-  if (PyType_Ready(&ConnectionType) < 0 || PyType_Ready(&APSWCursorType) < 0 || PyType_Ready(&ZeroBlobBindType) < 0 || PyType_Ready(&APSWBlobType) < 0 || PyType_Ready(&APSWVFSType) < 0 || PyType_Ready(&APSWVFSFileType) < 0 || PyType_Ready(&APSWURIFilenameType) < 0 || PyType_Ready(&APSWStatementType) < 0 || PyType_Ready(&APSWBufferType) < 0 || PyType_Ready(&FunctionCBInfoType) < 0
+  if (PyType_Ready(&ConnectionType) < 0 || PyType_Ready(&APSWCursorType) < 0 || PyType_Ready(&APSWLazyRowType) < 0 || PyType_Ready(&ZeroBlobBindType) < 0 || PyType_Ready(&APSWBlobType) < 0 || PyType_Ready(&APSWPreparedStatementType) < 0 || PyType_Ready(&APSWConnectionPoolType) < 0 || PyType_Ready(&APSWPoolCheckoutType) < 0 || PyType_Ready(&APSWVFSType) < 0 || PyType_Ready(&APSWVFSFileType) < 0 || PyType_Ready(&APSWURIFilenameType) < 0 || PyType_Ready(&APSWStatementType) < 0 || PyType_Ready(&APSWBufferType) < 0 || PyType_Ready(&FunctionCBInfoType) < 0
 #ifdef EXPERIMENTAL
       || PyType_Ready(&APSWBackupType) < 0
 #endif
@@ -1322,9 +1338,18 @@ PyInit_apsw(void)
   Py_INCREF(&APSWCursorType);
   PyModule_AddObject(m, "Cursor", (PyObject *)&APSWCursorType);
 
+  Py_INCREF(&APSWLazyRowType);
+  PyModule_AddObject(m, "LazyRow", (PyObject *)&APSWLazyRowType);
+
   Py_INCREF(&APSWBlobType);
   PyModule_AddObject(m, "Blob", (PyObject *)&APSWBlobType);
 
+  Py_INCREF(&APSWPreparedStatementType);
+  PyModule_AddObject(m, "PreparedStatement", (PyObject *)&APSWPreparedStatementType);
+
+  Py_INCREF(&APSWConnectionPoolType);
+  PyModule_AddObject(m, "ConnectionPool", (PyObject *)&APSWConnectionPoolType);
+
   Py_INCREF(&APSWBackupType);
   PyModule_AddObject(m, "Backup", (PyObject *)&APSWBackupType);
 
@@ -1901,6 +1926,7 @@ modules etc. For example::
   }
 
   add_shell(m);
+  add_aio(m);
 
   PyModule_AddObject(m, "compile_options", get_compile_options());
   PyModule_AddObject(m, "keywords", get_keywords());
@@ -1953,6 +1979,37 @@ add_shell(PyObject *apswmodule)
 #endif
 }
 
+/* apsw.aio is compiled in the same way as the shell.  It needs async
+   def and the current asynchronous iterator protocol. */
+static void
+add_aio(PyObject *apswmodule)
+{
+#if !defined(PYPY_VERSION) && PY_VERSION_HEX >= 0x03060000
+  PyObject *res = NULL, *aio, *aiodict, *msvciscrap = NULL;
+
+  aio = PyImport_AddModule("apsw.aio");
+  if (!aio)
+    return;
+  aiodict = PyModule_GetDict(aio);
+  PyDict_SetItemString(aiodict, "__builtins__", PyEval_GetBuiltins());
+  PyDict_SetItemString(aiodict, "apsw", apswmodule);
+
+  msvciscrap = PyBytes_FromFormat(
+#include "aio.c"
+  );
+  if (msvciscrap)
+    res = PyRun_StringFlags(PyBytes_AS_STRING(msvciscrap), Py_file_input, aiodict, aiodict, NULL);
+  if (!res)
+    PyErr_Print();
+  assert(res);
+  Py_XDECREF(res);
+  Py_XDECREF(msvciscrap);
+
+  Py_INCREF(aio);
+  PyModule_AddObject(apswmodule, "aio", aio);
+#endif
+}
+
 #ifdef APSW_TESTFIXTURES
 static int
 APSW_Should_Fault(const char *name)
@@ -0,0 +1,568 @@
+/*
+  Arrow C Data Interface export of query results
+
+  See the accompanying LICENSE file.
+*/
+
+/* The structures are from
+   https://arrow.apache.org/docs/format/CDataInterface.html which
+   says producers should copy them rather than depend on Arrow.
+   sqlite3_int64 is used for int64_t since the sizes are the same. */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+  /* Array type description */
+  const char* format;
+  const char* name;
+  const char* metadata;
+  sqlite3_int64 flags;
+  sqlite3_int64 n_children;
+  struct ArrowSchema** children;
+  struct ArrowSchema* dictionary;
+
+  /* Release callback */
+  void (*release)(struct ArrowSchema*);
+  /* Opaque producer-specific data */
+  void* private_data;
+};
+
+struct ArrowArray {
+  /* Array data description */
+  sqlite3_int64 length;
+  sqlite3_int64 null_count;
+  sqlite3_int64 offset;
+  sqlite3_int64 n_buffers;
+  sqlite3_int64 n_children;
+  const void** buffers;
+  struct ArrowArray** children;
+  struct ArrowArray* dictionary;
+
+  /* Release callback */
+  void (*release)(struct ArrowArray*);
+  /* Opaque producer-specific data */
+  void* private_data;
+};
+
+#endif  /* ARROW_C_DATA_INTERFACE */
+
+/* Arrow release callbacks can be called from any thread without the
+   GIL, so all memory handed over to Arrow comes from malloc and is
+   freed with free.  None of the functions here call Python APIs
+   except the capsule ones at the end, so they can be used while
+   holding the database mutex. */
+
+/* What a result column is exported as.  A column with only null
+   values stays ARROW_UNDECIDED and is exported as the Arrow null
+   type. */
+enum { ARROW_UNDECIDED, ARROW_INT64, ARROW_DOUBLE, ARROW_UTF8, ARROW_BINARY };
+
+/* Arrow format strings for the above.  Text and blobs use the large
+   (64 bit offset) variants so there is no 2GB limit per column. */
+static const char *arrow_formats[]={"n", "l", "g", "U", "Z"};
+
+typedef struct
+{
+  int kind;                        /* ARROW_ value */
+  int declared;                    /* kind came from the declared type so integers are never promoted to double */
+  sqlite3_int64 nullcount;
+  unsigned char *validity;         /* bitmap with a bit per row, NULL until the first null value */
+  void *values;                    /* a value per row, or nrows+1 offsets into data for text and blobs */
+  char *data;                      /* text and blob bytes */
+  sqlite3_int64 datalen;
+  sqlite3_int64 dataalloc;
+} arrowcolumn;
+
+typedef struct
+{
+  int ncols;
+  sqlite3_int64 nrows;
+  sqlite3_int64 rowalloc;          /* rows the validity and values buffers have space for */
+  arrowcolumn *columns;
+  char **names;
+} arrowbuilder;
+
+/* Case insensitive check if decltype contains the (upper case) word */
+static int
+arrow_decltype_has(const char *decltype, const char *word)
+{
+  size_t n=strlen(word);
+
+  for(;*decltype;decltype++)
+    {
+      size_t i;
+      for(i=0;i<n && decltype[i] && toupper((unsigned char)decltype[i])==word[i];i++);
+      if(i==n)
+        return 1;
+    }
+  return 0;
+}
+
+/* Uses the same rules as SQLite uses to work out column affinity.
+   NUMERIC affinity and no declared type leave the kind to be decided
+   by the values. */
+static int
+arrow_kind_from_decltype(const char *decltype)
+{
+  if(!decltype)
+    return ARROW_UNDECIDED;
+  if(arrow_decltype_has(decltype, "INT"))
+    return ARROW_INT64;
+  if(arrow_decltype_has(decltype, "CHAR") || arrow_decltype_has(decltype, "CLOB") || arrow_decltype_has(decltype, "TEXT"))
+    return ARROW_UTF8;
+  if(arrow_decltype_has(decltype, "BLOB"))
+    return ARROW_BINARY;
+  if(arrow_decltype_has(decltype, "REAL") || arrow_decltype_has(decltype, "FLOA") || arrow_decltype_has(decltype, "DOUB"))
+    return ARROW_DOUBLE;
+  return ARROW_UNDECIDED;
+}
+
+static void
+arrowbuilder_free(arrowbuilder *ab)
+{
+  int i;
+
+  for(i=0;i<ab->ncols;i++)
+    {
+      if(ab->columns)
+        {
+          free(ab->columns[i].validity);
+          free(ab->columns[i].values);
+          free(ab->columns[i].data);
+        }
+      if(ab->names)
+        free(ab->names[i]);
+    }
+  free(ab->columns);
+  free(ab->names);
+  memset(ab, 0, sizeof(*ab));
+}
+
+/* Sets up the columns from the current statement.  The database
+   mutex must be held.  Returns SQLITE_OK or SQLITE_NOMEM. */
+static int
+arrowbuilder_init(arrowbuilder *ab, sqlite3_stmt *stmt, int ncols)
+{
+  int i;
+
+  memset(ab, 0, sizeof(*ab));
+  ab->columns=calloc(ncols?ncols:1, sizeof(arrowcolumn));
+  ab->names=calloc(ncols?ncols:1, sizeof(char*));
+  if(!ab->columns || !ab->names)
+    goto nomem;
+  ab->ncols=ncols;
+
+  for(i=0;i<ncols;i++)
+    {
+      const char *name, *decltype;
+      size_t len;
+
+      PYSQLITE_LOCKED_CALL(name=sqlite3_column_name(stmt, i));
+      if(!name)
+        goto nomem;
+      len=strlen(name);
+      ab->names[i]=malloc(len+1);
+      if(!ab->names[i])
+        goto nomem;
+      memcpy(ab->names[i], name, len+1);
+
+      PYSQLITE_LOCKED_CALL(decltype=sqlite3_column_decltype(stmt, i));
+      ab->columns[i].kind=arrow_kind_from_decltype(decltype);
+      ab->columns[i].declared=(ab->columns[i].kind!=ARROW_UNDECIDED);
+    }
+  return SQLITE_OK;
+
+ nomem:
+  arrowbuilder_free(ab);
+  return SQLITE_NOMEM;
+}
+
+/* Allocates the values buffer once the column kind is known.  Rows
+   so far are all null and get zero values (or offsets). */
+static int
+arrowcolumn_allocvalues(arrowcolumn *col, sqlite3_int64 rowalloc)
+{
+  col->values=calloc((size_t)rowalloc+1, sizeof(sqlite3_int64));
+  return col->values?SQLITE_OK:SQLITE_NOMEM;
+}
+
+/* Makes space for another row in every column */
+static int
+arrowbuilder_grow(arrowbuilder *ab)
+{
+  sqlite3_int64 newalloc=ab->rowalloc?ab->rowalloc*2:1024;
+  int i;
+
+  for(i=0;i<ab->ncols;i++)
+    {
+      arrowcolumn *col=&ab->columns[i];
+      if(col->values)
+        {
+          void *newvalues=realloc(col->values, ((size_t)newalloc+1)*sizeof(sqlite3_int64));
+          if(!newvalues)
+            return SQLITE_NOMEM;
+          col->values=newvalues;
+        }
+      if(col->validity)
+        {
+          unsigned char *newvalidity=realloc(col->validity, (size_t)(newalloc+7)/8);
+          if(!newvalidity)
+            return SQLITE_NOMEM;
+          memset(newvalidity+(ab->rowalloc+7)/8, 0, (size_t)((newalloc+7)/8-(ab->rowalloc+7)/8));
+          col->validity=newvalidity;
+        }
+    }
+  ab->rowalloc=newalloc;
+  return SQLITE_OK;
+}
+
+static int
+arrowcolumn_adddata(arrowcolumn *col, const void *bytes, int len)
+{
+  if(col->datalen+len>col->dataalloc)
+    {
+      sqlite3_int64 newalloc=col->dataalloc?col->dataalloc:4096;
+      char *newdata;
+
+      while(newalloc<col->datalen+len)
+        newalloc*=2;
+      newdata=realloc(col->data, (size_t)newalloc);
+      if(!newdata)
+        return SQLITE_NOMEM;
+      col->data=newdata;
+      col->dataalloc=newalloc;
+    }
+  if(len)
+    memcpy(col->data+col->datalen, bytes, len);
+  col->datalen+=len;
+  return SQLITE_OK;
+}
+
+/* Appends the current row of stmt.  The database mutex must be held.
+   Values not matching the column kind are converted using SQLite's
+   own rules (eg sqlite3_column_int64 of text), except that a column
+   whose kind came from the values is promoted from integer to double
+   when a floating point value turns up.  Returns SQLITE_OK or
+   SQLITE_NOMEM. */
+static int
+arrowbuilder_addrow(arrowbuilder *ab, sqlite3_stmt *stmt)
+{
+  sqlite3_int64 row=ab->nrows;
+  int i;
+
+  if(row==ab->rowalloc && arrowbuilder_grow(ab)!=SQLITE_OK)
+    return SQLITE_NOMEM;
+
+  for(i=0;i<ab->ncols;i++)
+    {
+      arrowcolumn *col=&ab->columns[i];
+      int coltype;
+
+      PYSQLITE_LOCKED_CALL(coltype=sqlite3_column_type(stmt, i));
+
+      if(col->kind==ARROW_UNDECIDED && coltype!=SQLITE_NULL)
+        col->kind=(coltype==SQLITE_INTEGER)?ARROW_INT64:(coltype==SQLITE_FLOAT)?ARROW_DOUBLE:(coltype==SQLITE_TEXT)?ARROW_UTF8:ARROW_BINARY;
+      if(col->kind!=ARROW_UNDECIDED && !col->values && arrowcolumn_allocvalues(col, ab->rowalloc)!=SQLITE_OK)
+        return SQLITE_NOMEM;
+
+      if(coltype==SQLITE_NULL)
+        {
+          if(!col->validity)
+            {
+              col->validity=malloc((size_t)(ab->rowalloc+7)/8);
+              if(!col->validity)
+                return SQLITE_NOMEM;
+              /* all earlier rows were valid */
+              memset(col->validity, 0, (size_t)(ab->rowalloc+7)/8);
+              memset(col->validity, 0xff, (size_t)(row/8));
+              if(row%8)
+                col->validity[row/8]=(unsigned char)((1<<(row%8))-1);
+            }
+          col->nullcount++;
+          if(col->kind==ARROW_UTF8 || col->kind==ARROW_BINARY)
+            ((sqlite3_int64*)col->values)[row+1]=col->datalen;
+          else if(col->kind==ARROW_INT64)
+            ((sqlite3_int64*)col->values)[row]=0;
+          else if(col->kind==ARROW_DOUBLE)
+            ((double*)col->values)[row]=0;
+          continue;
+        }
+
+      if(col->validity)
+        col->validity[row/8]|=(unsigned char)(1<<(row%8));
+
+      if(col->kind==ARROW_INT64 && coltype==SQLITE_FLOAT && !col->declared)
+        {
+          sqlite3_int64 r;
+          for(r=0;r<row;r++)
+            ((double*)col->values)[r]=(double)((sqlite3_int64*)col->values)[r];
+          col->kind=ARROW_DOUBLE;
+        }
+
+      switch(col->kind)
+        {
+        case ARROW_INT64:
+          PYSQLITE_LOCKED_CALL(((sqlite3_int64*)col->values)[row]=sqlite3_column_int64(stmt, i));
+          break;
+        case ARROW_DOUBLE:
+          PYSQLITE_LOCKED_CALL(((double*)col->values)[row]=sqlite3_column_double(stmt, i));
+          break;
+        default:
+          {
+            const void *bytes;
+            int len;
+            if(col->kind==ARROW_UTF8)
+              PYSQLITE_LOCKED_CALL(bytes=sqlite3_column_text(stmt, i));
+            else
+              PYSQLITE_LOCKED_CALL(bytes=sqlite3_column_blob(stmt, i));
+            PYSQLITE_LOCKED_CALL(len=sqlite3_column_bytes(stmt, i));
+            if(arrowcolumn_adddata(col, bytes, len)!=SQLITE_OK)
+              return SQLITE_NOMEM;
+            ((sqlite3_int64*)col->values)[row+1]=col->datalen;
+          }
+          break;
+        }
+    }
+  ab->nrows++;
+  return SQLITE_OK;
+}
+
+/* RELEASE CALLBACKS */
+
+static void
+arrow_release_child_schema(struct ArrowSchema *schema)
+{
+  free((void*)schema->name);
+  schema->release=NULL;
+}
+
+/* The private data is the children pointer array followed by the
+   child structures */
+static void
+arrow_release_schema(struct ArrowSchema *schema)
+{
+  sqlite3_int64 i;
+
+  for(i=0;i<schema->n_children;i++)
+    if(schema->children[i]->release)
+      schema->children[i]->release(schema->children[i]);
+  free(schema->private_data);
+  schema->release=NULL;
+}
+
+/* The private data is the buffers pointer array */
+static void
+arrow_release_child_array(struct ArrowArray *array)
+{
+  int i;
+
+  for(i=0;i<3;i++)
+    free((void*)array->buffers[i]);
+  free(array->private_data);
+  array->release=NULL;
+}
+
+/* The private data is the buffers pointer array followed by the
+   children pointer array and the child structures */
+static void
+arrow_release_array(struct ArrowArray *array)
+{
+  sqlite3_int64 i;
+
+  for(i=0;i<array->n_children;i++)
+    if(array->children[i]->release)
+      array->children[i]->release(array->children[i]);
+  free(array->private_data);
+  array->release=NULL;
+}
+
+/* Moves the built columns into schema and array as a struct type
+   with one child per column (the Arrow representation of a record
+   batch).  The builder is freed whether this succeeds or not.
+   Returns SQLITE_OK or SQLITE_NOMEM. */
+static int
+arrowbuilder_export(arrowbuilder *ab, struct ArrowSchema *schema, struct ArrowArray *array)
+{
+  struct ArrowSchema *childschemas;
+  struct ArrowArray *childarrays;
+  void **schemaprivate=NULL, **arrayprivate=NULL;
+  int i, ncols=ab->ncols;
+
+  memset(schema, 0, sizeof(*schema));
+  memset(array, 0, sizeof(*array));
+
+  schemaprivate=malloc(ncols*(sizeof(void*)+sizeof(struct ArrowSchema))+1);
+  arrayprivate=malloc(sizeof(void*)+ncols*(sizeof(void*)+sizeof(struct ArrowArray)));
+  if(!schemaprivate || !arrayprivate)
+    goto nomem;
+
+  schema->format="+s";
+  schema->name="";
+  schema->n_children=ncols;
+  schema->children=(struct ArrowSchema**)schemaprivate;
+  schema->release=arrow_release_schema;
+  schema->private_data=schemaprivate;
+  childschemas=(struct ArrowSchema*)(schemaprivate+ncols);
+
+  array->length=ab->nrows;
+  array->n_buffers=1;
+  array->buffers=(const void**)arrayprivate;
+  arrayprivate[0]=NULL;
+  array->n_children=ncols;
+  array->children=(struct ArrowArray**)(arrayprivate+1);
+  array->release=arrow_release_array;
+  array->private_data=arrayprivate;
+  childarrays=(struct ArrowArray*)(arrayprivate+1+ncols);
+
+  /* children not yet filled in have a NULL release so the release
+     callbacks above skip them on failure */
+  for(i=0;i<ncols;i++)
+    {
+      schema->children[i]=&childschemas[i];
+      array->children[i]=&childarrays[i];
+      memset(&childschemas[i], 0, sizeof(struct ArrowSchema));
+      memset(&childarrays[i], 0, sizeof(struct ArrowArray));
+    }
+
+  for(i=0;i<ncols;i++)
+    {
+      arrowcolumn *col=&ab->columns[i];
+      struct ArrowSchema *cs=&childschemas[i];
+      struct ArrowArray *ca=&childarrays[i];
+      const void **buffers;
+
+      /* Arrow requires a non-NULL data buffer even when empty */
+      if((col->kind==ARROW_UTF8 || col->kind==ARROW_BINARY) && !col->data)
+        {
+          col->data=malloc(1);
+          if(!col->data)
+            goto nomem;
+        }
+      buffers=calloc(3, sizeof(void*));
+      if(!buffers)
+        goto nomem;
+
+      cs->format=arrow_formats[col->kind];
+      cs->name=ab->names[i];
+      ab->names[i]=NULL;
+      cs->flags=ARROW_FLAG_NULLABLE;
+      cs->release=arrow_release_child_schema;
+
+      ca->length=ab->nrows;
+      ca->buffers=buffers;
+      ca->private_data=(void*)buffers;
+      ca->release=arrow_release_child_array;
+      switch(col->kind)
+        {
+        case ARROW_UNDECIDED:
+          ca->null_count=ab->nrows;
+          ca->n_buffers=0;
+          break;
+        case ARROW_INT64:
+        case ARROW_DOUBLE:
+          ca->null_count=col->nullcount;
+          ca->n_buffers=2;
+          break;
+        default:
+          ca->null_count=col->nullcount;
+          ca->n_buffers=3;
+          break;
+        }
+      if(col->kind!=ARROW_UNDECIDED)
+        {
+          buffers[0]=col->validity;
+          buffers[1]=col->values;
+          col->validity=NULL;
+          col->values=NULL;
+        }
+      if(ca->n_buffers==3)
+        {
+          buffers[2]=col->data;
+          col->data=NULL;
+        }
+    }
+
+  arrowbuilder_free(ab);
+  return SQLITE_OK;
+
+ nomem:
+  if(schema->release)
+    {
+      schema->release(schema);
+      array->release(array);
+    }
+  else
+    {
+      free(schemaprivate);
+      free(arrayprivate);
+    }
+  arrowbuilder_free(ab);
+  return SQLITE_NOMEM;
+}
+
+/* PYTHON CAPSULES */
+
+/* Capsule names from the Arrow PyCapsule interface */
+#define ARROW_SCHEMA_CAPSULE "arrow_schema"
+#define ARROW_ARRAY_CAPSULE "arrow_array"
+
+/* Consumers such as pyarrow move the structure out of the capsule,
+   setting release to NULL, so we only release it if they didn't */
+static void
+arrow_schema_capsule_destructor(PyObject *capsule)
+{
+  struct ArrowSchema *schema=PyCapsule_GetPointer(capsule, ARROW_SCHEMA_CAPSULE);
+  if(schema && schema->release)
+    schema->release(schema);
+  free(schema);
+}
+
+static void
+arrow_array_capsule_destructor(PyObject *capsule)
+{
+  struct ArrowArray *array=PyCapsule_GetPointer(capsule, ARROW_ARRAY_CAPSULE);
+  if(array && array->release)
+    array->release(array);
+  free(array);
+}
+
+/* Returns a new reference to a tuple of schema and array capsules
+   made from the builder, which is always freed */
+static PyObject *
+arrowbuilder_capsules(arrowbuilder *ab)
+{
+  struct ArrowSchema *schema=malloc(sizeof(struct ArrowSchema));
+  struct ArrowArray *array=malloc(sizeof(struct ArrowArray));
+  PyObject *schemacapsule=NULL, *arraycapsule=NULL, *res=NULL;
+
+  if(!schema || !array || arrowbuilder_export(ab, schema, array)!=SQLITE_OK)
+    {
+      arrowbuilder_free(ab);
+      free(schema);
+      free(array);
+      return PyErr_NoMemory();
+    }
+
+  schemacapsule=PyCapsule_New(schema, ARROW_SCHEMA_CAPSULE, arrow_schema_capsule_destructor);
+  if(!schemacapsule)
+    {
+      schema->release(schema);
+      free(schema);
+    }
+  arraycapsule=PyCapsule_New(array, ARROW_ARRAY_CAPSULE, arrow_array_capsule_destructor);
+  if(!arraycapsule)
+    {
+      array->release(array);
+      free(array);
+    }
+  if(schemacapsule && arraycapsule)
+    res=PyTuple_Pack(2, schemacapsule, arraycapsule);
+
+  Py_XDECREF(schemacapsule);
+  Py_XDECREF(arraycapsule);
+  return res;
+}
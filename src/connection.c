@@ -59,17 +59,37 @@ struct Connection {
   PyObject *commithook;
   PyObject *walhook;
   PyObject *progresshandler;
+  int progresssteps;               /* nsteps for progresshandler */
   PyObject *authorizer;
   PyObject *collationneeded;
   PyObject *exectrace;
   PyObject *rowtrace;
 
+  /* cursors return rows with named fields */
+  int namedrows;
+
+  /* cursors return rows that decode columns on access */
+  int lazyrows;
+
   /* if we are using one of our VFS since sqlite doesn't reference count them */
   PyObject *vfs;
 
   /* used for nested with (contextmanager) statements */
   long savepointlevel;
 
+  /* query timeouts.  deadline is for the statement currently being
+     stepped (zero for none) and is only changed while holding the
+     database mutex */
+  double querytimeout;             /* default for cursors in seconds, zero for none */
+  int deadlines;                   /* the progress handler checks deadlines */
+  sqlite3_int64 deadline;          /* apsw_monotonic_us value */
+
+  /* busy handling done in C - NULL until setbusypolicy is called */
+  struct busypolicy *busypolicy;
+
+  /* batching writes from group_execute - NULL until group_commit is called */
+  struct groupcommit *groupcommit;
+
   /* informational attributes */
   PyObject *open_flags;
   PyObject *open_vfs;
@@ -106,6 +126,9 @@ struct APSWCursor;
 static void APSWCursor_init(struct APSWCursor *, Connection *);
 static PyTypeObject APSWCursorType;
 
+struct APSWPreparedStatement;
+static void APSWPreparedStatement_init(struct APSWPreparedStatement *self, Connection *connection, APSWStatement *statement);
+
 struct ZeroBlobBind;
 static PyTypeObject ZeroBlobBindType;
 
@@ -120,6 +143,43 @@ FunctionCBInfo_dealloc(FunctionCBInfo *self)
   Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
+/* With group_commit, writes from group_execute are queued and the
+   first thread to find no batch in progress becomes the leader.  It
+   waits for more writes to arrive, runs them all in one transaction,
+   wakes the other threads, and passes leadership on to the first
+   write that arrived while it was busy.  The members are only touched
+   while holding the GIL. */
+struct groupcommitentry {
+  PyObject *statements;
+  PyObject *bindings;              /* can be NULL */
+  PyThread_type_lock wakeup;       /* held until done or asked to lead */
+  int done;
+  PyObject *etype, *evalue, *etb;  /* exception for this write */
+  struct groupcommitentry *next;
+};
+
+struct groupcommit {
+  sqlite3_int64 window_us;         /* how long the leader waits for more writes */
+  int maxbatch;                    /* most writes in one transaction */
+  struct groupcommitentry *head, *tail;
+  int count;                       /* entries in the queue */
+  int leading;                     /* a thread is the leader */
+  int leaderwaiting;               /* the leader is waiting on full */
+  int fullsignalled;               /* full has been released */
+  PyThread_type_lock full;         /* released to wake the leader early */
+};
+
+static void
+groupcommit_free(struct groupcommit *gc)
+{
+  assert(!gc->head && !gc->leading);
+  if(gc->fullsignalled)
+    PyThread_acquire_lock(gc->full, WAIT_LOCK);
+  PyThread_release_lock(gc->full);
+  PyThread_free_lock(gc->full);
+  PyMem_Free(gc);
+}
+
 /** .. class:: Connection
 
 
@@ -290,6 +350,11 @@ Connection_dealloc(Connection* self)
   Py_CLEAR(self->dependents);
   Py_CLEAR(self->dependent_remove);
 
+  /* nothing can be waiting since they would hold a reference */
+  if(self->groupcommit)
+    groupcommit_free(self->groupcommit);
+  PyMem_Free(self->busypolicy);
+
   Py_TYPE(self)->tp_free((PyObject*)self);
 }
 
@@ -327,12 +392,20 @@ Connection_new(PyTypeObject *type, APSW_ARGUNUSED PyObject *args, APSW_ARGUNUSED
       self->commithook=0;
       self->walhook=0;
       self->progresshandler=0;
+      self->progresssteps=0;
       self->authorizer=0;
       self->collationneeded=0;
       self->exectrace=0;
       self->rowtrace=0;
+      self->namedrows=0;
+      self->lazyrows=0;
       self->vfs=0;
       self->savepointlevel=0;
+      self->querytimeout=0;
+      self->deadlines=0;
+      self->deadline=0;
+      self->busypolicy=0;
+      self->groupcommit=0;
       self->open_flags=0;
       self->open_vfs=0;
       self->weakreflist=0;
@@ -702,6 +775,62 @@ Connection_cursor(Connection *self)
   return (PyObject*)cursor;
 }
 
+/** .. method:: prepare(sql, persistent=True) -> PreparedStatement
+
+  Prepares a single statement and returns a :class:`PreparedStatement`
+  which can be executed many times without going through the
+  :ref:`statement cache <statementcache>`.  See
+  :ref:`preparedstatements`.
+
+  :param sql: The text of exactly one statement.
+  :param persistent: Tells SQLite the statement will be kept and
+     reused many times, so it allocates the statement's memory in a
+     way that doesn't get in the way of shorter lived allocations.
+
+  -* sqlite3_prepare_v3
+*/
+static PyObject *
+Connection_prepare(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"sql", "persistent", NULL};
+  PyObject *sql, *persistent=NULL;
+  int ispersistent=1;
+  APSWStatement *statement=NULL;
+  struct APSWPreparedStatement *prepared=NULL;
+  PyObject *weakref;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:prepare(sql, persistent=True)", kwlist, &sql, &persistent))
+    return NULL;
+
+  if(persistent)
+    {
+      ispersistent=PyObject_IsTrue(persistent);
+      if(ispersistent<0)
+        return NULL;
+    }
+
+  INUSE_CALL(statement=statementcache_prepare_owned(self->stmtcache, sql, ispersistent));
+  if(!statement)
+    return NULL;
+
+  prepared=PyObject_New(struct APSWPreparedStatement, &APSWPreparedStatementType);
+  if(!prepared)
+    {
+      Py_DECREF(statement);
+      return NULL;
+    }
+
+  APSWPreparedStatement_init(prepared, self, statement);
+  weakref=PyWeakref_NewRef((PyObject*)prepared, self->dependent_remove);
+  PyList_Append(self->dependents, weakref);
+  Py_DECREF(weakref);
+
+  return (PyObject*)prepared;
+}
+
 /** .. method:: setbusytimeout(millseconds)
 
   If the database is locked such as when another connection is making
@@ -1313,6 +1442,38 @@ progresshandlercb(void *context)
   return ok;
 }
 
+/* How many SQLite instructions between deadline checks when there is
+   no Python progress handler */
+#define QUERYTIMEOUT_NSTEPS 1000
+
+/* The progress handler given to SQLite.  Deadlines are checked without
+   needing the GIL, and then the Python progress handler if any is
+   called. */
+static int
+progresscb(void *context)
+{
+  Connection *self=(Connection *)context;
+
+  if(self->deadline && apsw_monotonic_us()>=self->deadline)
+    return 1;
+  if(self->progresshandler && self->progresssteps>0)
+    return progresshandlercb(context);
+  return 0;
+}
+
+/* Installs progresscb as needed by the Python progress handler and
+   deadlines */
+static void
+Connection_installprogress(Connection *self)
+{
+  if(self->progresshandler && self->progresssteps>0)
+    _PYSQLITE_CALL_V(sqlite3_progress_handler(self->db, self->progresssteps, progresscb, self));
+  else if(self->deadlines)
+    _PYSQLITE_CALL_V(sqlite3_progress_handler(self->db, QUERYTIMEOUT_NSTEPS, progresscb, self));
+  else
+    _PYSQLITE_CALL_V(sqlite3_progress_handler(self->db, 0, NULL, NULL));
+}
+
 /** .. method:: setprogresshandler(callable[, nsteps=20])
 
   Sets a callable which is invoked every *nsteps* SQLite
@@ -1320,6 +1481,9 @@ progresshandlercb(void *context)
   or zero to continue. (If there is an error in your Python *callable*
   then non-zero will be returned).
 
+  :ref:`Query timeouts <querytimeouts>` are checked as often as the
+  callable is invoked.
+
   .. seealso::
 
      * :ref:`Example <example-progress-handler>`
@@ -1341,26 +1505,71 @@ Connection_setprogresshandler(Connection *self, PyObject *args)
     return NULL;
 
   if(callable==Py_None)
-    {
-      PYSQLITE_VOID_CALL(sqlite3_progress_handler(self->db, 0, NULL, NULL));
-      callable=NULL;
-      goto finally;
-    }
-
-  if(!PyCallable_Check(callable))
+    callable=NULL;
+  else if(!PyCallable_Check(callable))
     return PyErr_Format(PyExc_TypeError, "progress handler must be callable");
-
-  PYSQLITE_VOID_CALL(sqlite3_progress_handler(self->db, nsteps, progresshandlercb, self));
-  Py_INCREF(callable);
-
- finally:
+  else
+    Py_INCREF(callable);
 
   Py_XDECREF(self->progresshandler);
   self->progresshandler=callable;
+  self->progresssteps=nsteps;
+  INUSE_CALL(Connection_installprogress(self));
 
   Py_RETURN_NONE;
 }
 
+/** .. method:: setquerytimeout(seconds)
+
+  Sets the default *timeout* for :meth:`Cursor.execute` and
+  :meth:`Cursor.executemany`.  Statements still running that many
+  seconds after being executed fail with :exc:`QueryTimeoutError`.
+  Use zero for no timeout, which is the default.
+
+  .. seealso::
+
+     * :ref:`Query timeouts <querytimeouts>`
+
+  -* sqlite3_progress_handler
+*/
+static PyObject *
+Connection_setquerytimeout(Connection *self, PyObject *args)
+{
+  double seconds;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTuple(args, "d:setquerytimeout(seconds)", &seconds))
+    return NULL;
+
+  if(seconds<0 || seconds>1e9)
+    return PyErr_Format(PyExc_ValueError, "seconds must be between zero and one billion");
+
+  self->querytimeout=seconds;
+  if(seconds && !self->deadlines)
+    {
+      self->deadlines=1;
+      INUSE_CALL(Connection_installprogress(self));
+    }
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: getquerytimeout() -> float
+
+  Returns the default query timeout set by
+  :meth:`~Connection.setquerytimeout`.
+*/
+static PyObject *
+Connection_getquerytimeout(Connection *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  return PyFloat_FromDouble(self->querytimeout);
+}
+
 static int
 authorizercb(void *context, int operation, const char *paramone, const char *paramtwo, const char *databasename, const char *triggerview)
 {
@@ -1674,6 +1883,249 @@ Connection_setbusyhandler(Connection *self, PyObject *callable)
   Py_RETURN_NONE;
 }
 
+/* Busy handling done entirely in C, configured by setbusypolicy.  The
+   callback is made by SQLite with the GIL released and the database
+   mutex held, so everything else must hold the mutex to read or
+   change this. */
+struct busypolicy {
+  /* configuration */
+  sqlite3_int64 timeout_us;        /* maximum total wait */
+  double initial_us;               /* first sleep */
+  double max_us;                   /* longest sleep */
+  double multiplier;               /* sleep grows by this each retry */
+  double jitter;                   /* fraction of each sleep that is random */
+  int max_attempts;                /* zero for unlimited */
+
+  sqlite3_uint64 random;           /* xorshift state for jitter */
+  sqlite3_int64 episode_start;     /* when the current busy episode started */
+  sqlite3_int64 episode_waited_us; /* time slept in the current episode */
+
+  /* statistics */
+  sqlite3_int64 episodes;          /* times a lock was busy */
+  sqlite3_int64 retries;           /* sleeps made */
+  sqlite3_int64 giveups;           /* episodes ending in SQLITE_BUSY */
+  sqlite3_int64 waited_us;         /* total time in busy episodes */
+  sqlite3_int64 max_waited_us;     /* longest busy episode */
+};
+
+static int
+busypolicycb(void *context, int ncall)
+{
+  struct busypolicy *bp=(struct busypolicy*)context;
+  sqlite3_int64 now, remaining;
+  double sleep_us;
+  int i;
+
+  now=apsw_monotonic_us();
+
+  if(ncall==0)
+    {
+      bp->episodes++;
+      bp->episode_start=now;
+      bp->episode_waited_us=0;
+    }
+
+  remaining=bp->timeout_us-(now-bp->episode_start);
+  if(remaining<=0 || (bp->max_attempts && ncall>=bp->max_attempts))
+    {
+      bp->giveups++;
+      return 0;
+    }
+
+  sleep_us=bp->initial_us;
+  for(i=0;i<ncall && sleep_us<bp->max_us;i++)
+    sleep_us*=bp->multiplier;
+  if(sleep_us>bp->max_us)
+    sleep_us=bp->max_us;
+
+  if(bp->jitter>0)
+    {
+      /* xorshift64 */
+      bp->random^=bp->random<<13;
+      bp->random^=bp->random>>7;
+      bp->random^=bp->random<<17;
+      sleep_us-=sleep_us*bp->jitter*((double)(bp->random>>11)/9007199254740992.0);
+    }
+
+  if(sleep_us>remaining)
+    sleep_us=(double)remaining;
+
+  bp->retries++;
+  /* the sleep is rounded up to whole milliseconds */
+  sqlite3_sleep((int)((sleep_us+999)/1000)); /* PYSQLITE_CALL not needed - SQLite calls us without the GIL */
+
+  now=apsw_monotonic_us()-now;
+  bp->waited_us+=now;
+  bp->episode_waited_us+=now;
+  if(bp->episode_waited_us>bp->max_waited_us)
+    bp->max_waited_us=bp->episode_waited_us;
+  return 1;
+}
+
+/** .. method:: setbusypolicy(timeout_ms, initial_ms=1, max_ms=100, multiplier=2, jitter=0.5, max_attempts=0)
+
+  Installs a busy handler that runs entirely in C with the GIL
+  released, so waiting for locks doesn't need to run any Python code.
+  It retries with exponential backoff.  The first sleep is *initial_ms*,
+  and each following sleep is *multiplier* times longer up to *max_ms*.
+  A random *jitter* fraction of each sleep is removed so that
+  connections waiting on the same lock don't all retry at the same
+  moment.  The handler gives up, returning :exc:`BusyError` to the
+  caller, once *timeout_ms* has passed or after *max_attempts* retries.
+
+  Sleeps are rounded up to whole milliseconds.  Use
+  :meth:`~Connection.busy_stats` to see how much contention there has
+  been.
+
+  If you previously called :meth:`~Connection.setbusyhandler` or
+  :meth:`~Connection.setbusytimeout` then calling this overrides
+  that, and calling either of them overrides this.
+
+  :param timeout_ms: Maximum milliseconds to keep retrying a lock.
+  :param initial_ms: Milliseconds to sleep before the first retry.
+  :param max_ms: Longest milliseconds to sleep between retries.
+  :param multiplier: How much longer each sleep is than the previous.
+  :param jitter: Fraction (0 to 1) of each sleep that is randomized.
+  :param max_attempts: Most retries, or zero for no limit.
+
+  .. seealso::
+
+     * :ref:`Busy handling <busyhandling>`
+
+  -* sqlite3_busy_handler
+*/
+static PyObject *
+Connection_setbusypolicy(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"timeout_ms", "initial_ms", "max_ms", "multiplier", "jitter", "max_attempts", NULL};
+  double timeout_ms, initial_ms=1, max_ms=100, multiplier=2, jitter=0.5;
+  int max_attempts=0, res;
+  struct busypolicy *bp;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "d|ddddi:setbusypolicy(timeout_ms, initial_ms=1, max_ms=100, multiplier=2, jitter=0.5, max_attempts=0)",
+                                  kwlist, &timeout_ms, &initial_ms, &max_ms, &multiplier, &jitter, &max_attempts))
+    return NULL;
+
+  if(timeout_ms<0 || timeout_ms>1e9)
+    return PyErr_Format(PyExc_ValueError, "timeout_ms must be between zero and one billion");
+  if(initial_ms<0 || max_ms<initial_ms || max_ms>1e9)
+    return PyErr_Format(PyExc_ValueError, "initial_ms must be at least zero and no more than max_ms");
+  if(multiplier<1)
+    return PyErr_Format(PyExc_ValueError, "multiplier must be at least one");
+  if(jitter<0 || jitter>1)
+    return PyErr_Format(PyExc_ValueError, "jitter must be between zero and one");
+  if(max_attempts<0)
+    return PyErr_Format(PyExc_ValueError, "max_attempts must be at least zero");
+
+  if(!self->busypolicy)
+    {
+      self->busypolicy=PyMem_Malloc(sizeof(struct busypolicy));
+      if(!self->busypolicy)
+        return PyErr_NoMemory();
+      memset(self->busypolicy, 0, sizeof(struct busypolicy));
+      self->busypolicy->random=((sqlite3_uint64)(size_t)self) ^ (sqlite3_uint64)apsw_monotonic_us();
+      if(!self->busypolicy->random)
+        self->busypolicy->random=1;
+    }
+  bp=self->busypolicy;
+
+  /* the handler may be running on another thread's statement */
+  PYSQLITE_DB_MUTEX_ENTER(self->db);
+  bp->timeout_us=(sqlite3_int64)(timeout_ms*1000);
+  bp->initial_us=initial_ms*1000;
+  bp->max_us=max_ms*1000;
+  bp->multiplier=multiplier;
+  bp->jitter=jitter;
+  bp->max_attempts=max_attempts;
+  PYSQLITE_DB_MUTEX_LEAVE(self->db);
+
+  PYSQLITE_CON_CALL(res=sqlite3_busy_handler(self->db, busypolicycb, bp));
+  SET_EXC(res, self->db);
+  if(res!=SQLITE_OK)
+    return NULL;
+
+  Py_CLEAR(self->busyhandler);
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: busy_stats(reset=False) -> dict
+
+  Returns statistics gathered by :meth:`~Connection.setbusypolicy`
+  about waiting for locks.  Nothing is gathered when using
+  :meth:`~Connection.setbusytimeout` or
+  :meth:`~Connection.setbusyhandler`.
+
+  :param reset: If True then the statistics are set back to zero after
+     being returned.
+
+  .. list-table::
+    :header-rows: 1
+    :widths: auto
+
+    * - Key
+      - Meaning
+    * - episodes
+      - How many times a lock was busy
+    * - retries
+      - How many times the handler slept and tried again
+    * - giveups
+      - How many episodes ended with :exc:`BusyError` due to the
+        timeout or attempt limit
+    * - wait_seconds
+      - Total time spent sleeping between retries
+    * - max_wait_seconds
+      - The longest time spent sleeping for one busy lock
+*/
+static PyObject *
+Connection_busy_stats(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"reset", NULL};
+  PyObject *resetobj=NULL;
+  int reset=0;
+  struct busypolicy stats;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|O:busy_stats(reset=False)", kwlist, &resetobj))
+    return NULL;
+
+  if(resetobj)
+    {
+      reset=PyObject_IsTrue(resetobj);
+      if(reset<0)
+        return NULL;
+    }
+
+  memset(&stats, 0, sizeof(stats));
+  if(self->busypolicy)
+    {
+      /* the handler updates the counters with the mutex held while
+         other threads' statements are busy */
+      struct busypolicy *bp=self->busypolicy;
+
+      PYSQLITE_DB_MUTEX_ENTER(self->db);
+      stats=*bp;
+      if(reset)
+        {
+          bp->episodes=bp->retries=bp->giveups=bp->waited_us=bp->max_waited_us=0;
+          bp->episode_waited_us=0;
+        }
+      PYSQLITE_DB_MUTEX_LEAVE(self->db);
+    }
+
+  return Py_BuildValue("{s:L,s:L,s:L,s:d,s:d}",
+                       "episodes", stats.episodes,
+                       "retries", stats.retries,
+                       "giveups", stats.giveups,
+                       "wait_seconds", stats.waited_us/1000000.0,
+                       "max_wait_seconds", stats.max_waited_us/1000000.0);
+}
+
 #if defined(EXPERIMENTAL) && !defined(SQLITE_OMIT_LOAD_EXTENSION)  /* extension loading */
 
 /** .. method:: enableloadextension(enable)
@@ -3003,6 +3455,88 @@ Connection_getrowtrace(Connection *self)
   return ret;
 }
 
+/** .. method:: setnamedrows(enable)
+
+  Sets if :class:`cursors <Cursor>` return rows with named fields,
+  unless overridden by :meth:`Cursor.setnamedrows`.  See that method
+  for details.
+*/
+
+static PyObject *
+Connection_setnamedrows(Connection *self, PyObject *enable)
+{
+  int res;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  res=PyObject_IsTrue(enable);
+  if(res==-1)
+    return NULL;
+#if PY_VERSION_HEX < 0x03030000
+  if(res)
+    return PyErr_Format(PyExc_NotImplementedError, "Named rows need Python 3.3 or later");
+#endif
+
+  self->namedrows=res;
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: getnamedrows() -> bool
+
+  Returns the setting from :meth:`~Connection.setnamedrows`.
+*/
+static PyObject *
+Connection_getnamedrows(Connection *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(self->namedrows)
+    Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+/** .. method:: setlazyrows(enable)
+
+  Sets if :class:`cursors <Cursor>` return :class:`LazyRow` objects,
+  unless overridden by :meth:`Cursor.setlazyrows`.  See that method
+  for details.
+*/
+
+static PyObject *
+Connection_setlazyrows(Connection *self, PyObject *enable)
+{
+  int res;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  res=PyObject_IsTrue(enable);
+  if(res==-1)
+    return NULL;
+
+  self->lazyrows=res;
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: getlazyrows() -> bool
+
+  Returns the setting from :meth:`~Connection.setlazyrows`.
+*/
+static PyObject *
+Connection_getlazyrows(Connection *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(self->lazyrows)
+    Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
 /** .. method:: __enter__() -> context
 
   You can use the database as a `context manager
@@ -3356,6 +3890,504 @@ Connection_txn_state(Connection *self, PyObject *args)
   return PyErr_Format(PyExc_ValueError, "unknown schema");
 }
 
+/** .. method:: statement_cache_limits(entries=-1, bytes=-1, instances=-1) -> (int, int, int)
+
+  Returns the limits of the :ref:`statement cache <statementcache>` as
+  a tuple of the maximum number of entries, the maximum bytes used and
+  the maximum instances of the same query, and changes those given
+  that are not negative.  The bytes for each statement are the length
+  of its query text plus the memory SQLite reports the prepared
+  statement using.  Least recently used statements are discarded until
+  both limits are met, and statements bigger than the bytes limit are
+  not cached.  Zero entries turns off the cache.
+
+  More than one instance of a query is cached when it is executed
+  while already executing, such as by nested cursors, so each of them
+  gets a cached statement.  Reducing *instances* doesn't discard
+  existing extra instances until they are least recently used.
+
+  The initial limits are the *statementcachesize* given to
+  :class:`Connection`, 16MB and 4 instances.
+
+  :returns: The limits in place on entry to the call.
+
+  -* sqlite3_stmt_status
+*/
+static PyObject *
+Connection_statement_cache_limits(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"entries", "bytes", "instances", NULL};
+  int entries=-1, instances=-1;
+  Py_ssize_t nbytes=-1;
+  PyObject *res;
+  StatementCache *sc;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|ini:statement_cache_limits(entries=-1, bytes=-1, instances=-1)", kwlist, &entries, &nbytes, &instances))
+    return NULL;
+
+  if(instances==0)
+    return PyErr_Format(PyExc_ValueError, "There must be at least one instance of a query allowed");
+
+  sc=self->stmtcache;
+  res=Py_BuildValue("(InI)", sc->maxentries, sc->maxbytes, sc->maxinstances);
+  if(!res)
+    return NULL;
+
+  if(entries>=0 || nbytes>=0 || instances>0)
+    if(statementcache_setlimits(sc, (entries>=0)?(unsigned)entries:sc->maxentries, (nbytes>=0)?nbytes:sc->maxbytes,
+                                (instances>0)?(unsigned)instances:sc->maxinstances))
+      {
+        Py_DECREF(res);
+        return NULL;
+      }
+
+  return res;
+}
+
+/** .. method:: statement_cache_stats(queries=False) -> dict
+
+  Returns information about the :ref:`statement cache <statementcache>`
+  as a dict.  The counters cover the life of the connection.
+
+    hits
+      Statements reused from the cache
+    misses
+      Statements that were prepared because they weren't in the cache
+    hits_inuse
+      Statements in the cache where all the instances were already
+      executing, such as the same query in nested cursors, so another
+      had to be prepared
+    evictions
+      Statements discarded to stay within the
+      :meth:`limits <Connection.statement_cache_limits>`
+    too_big
+      Statements not cached because they exceeded the bytes limit
+    entries, bytes
+      Number of statements currently cached and the bytes they use
+    max_entries, max_bytes, max_instances
+      The current limits
+
+  If *queries* is True then there is also a *queries* key with a list
+  of dicts for each statement in the cache, in no particular order,
+  with the *query* text, number of *hits*, *bytes* used and whether it
+  is *inuse*.  Lots of misses and entries with no hits usually mean
+  the query text varies, for example by including values instead of
+  using bindings.  Each dict also has the SQLite counters for the
+  statement described in :meth:`Cursor.statement_status`, covering
+  every execution since it was prepared.  For example to find the
+  queries doing the most work, which often need an index::
+
+    queries=connection.statement_cache_stats(True)["queries"]
+    queries.sort(key=lambda q: q["vm_steps"], reverse=True)
+*/
+static PyObject *
+Connection_statement_cache_stats(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"queries", NULL};
+  PyObject *queries=NULL;
+  int showqueries=0;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|O:statement_cache_stats(queries=False)", kwlist, &queries))
+    return NULL;
+
+  if(queries)
+    {
+      showqueries=PyObject_IsTrue(queries);
+      if(showqueries<0)
+        return NULL;
+    }
+
+  return statementcache_stats(self->stmtcache, showqueries);
+}
+
+/** .. method:: statement_cache_manifest() -> list
+
+  Returns a list of the query text of the statements in the
+  :ref:`statement cache <statementcache>`, least recently used first,
+  with each query present once.  Save the list and give it to
+  :meth:`~Connection.preload_statements` on a new connection, such as
+  after your program restarts, to recreate the cache contents.
+*/
+static PyObject *
+Connection_statement_cache_manifest(Connection *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  return statementcache_manifest(self->stmtcache);
+}
+
+/** .. method:: preload_statements(queries) -> None
+
+  Prepares each query text from the iterable *queries* and places the
+  statements in the :ref:`statement cache <statementcache>` without
+  executing them, so the first executions of those queries don't have
+  to wait for them to be prepared.  Queries containing multiple
+  statements have each of them cached the same way :meth:`Cursor.execute`
+  would.  Preparing fails if a query refers to tables that don't
+  exist yet, so do this after your schema is set up.  Preloads count as
+  cache misses in :meth:`~Connection.statement_cache_stats` and are
+  subject to the :meth:`limits <Connection.statement_cache_limits>`, so
+  later queries evict earlier ones if there are too many.
+
+  .. seealso::
+
+    * :meth:`~Connection.statement_cache_manifest`
+*/
+static PyObject *
+Connection_preload_statements(Connection *self, PyObject *queries)
+{
+  PyObject *iterator, *query=NULL;
+  int res=0;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  iterator=PyObject_GetIter(queries);
+  if(!iterator)
+    return NULL;
+
+  while(!res && (query=PyIter_Next(iterator)))
+    {
+      if(Py_TYPE(query)==&APSWPreparedStatementType)
+        {
+          PyErr_Format(PyExc_TypeError, "Expected query text not a PreparedStatement");
+          res=-1;
+        }
+      else
+        INUSE_CALL(res=statementcache_preload(self->stmtcache, query));
+      Py_DECREF(query);
+    }
+
+  Py_DECREF(iterator);
+  if(res || PyErr_Occurred())
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+/** .. method:: group_commit(window_ms, max_batch=100) -> None
+
+  Turns on group commit for :meth:`~Connection.group_execute`.  Each
+  commit has to wait for the data to be written to storage (fsync),
+  which limits how many small write transactions per second can be
+  done.  With group commit, writes made by :meth:`~Connection.group_execute`
+  from many threads are queued and then run together in one
+  transaction, so there is only one commit for all of them.
+
+  A batch is started by the first write to arrive, and it waits up to
+  *window_ms* milliseconds for more writes before running them,
+  or less if *max_batch* writes are queued sooner.  A larger window
+  means fewer commits but each write takes longer to complete.
+
+  You can call this again to change the values.
+
+  :param window_ms: Milliseconds to wait for more writes.  Zero means
+     only writes already queued are included.
+  :param max_batch: Most writes in one transaction.
+*/
+static PyObject *
+Connection_group_commit(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"window_ms", "max_batch", NULL};
+  double window_ms;
+  int max_batch=100;
+
+  CHECK_USE(NULL);
+  CHECK_CLOSED(self, NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "d|i:group_commit(window_ms, max_batch=100)", kwlist, &window_ms, &max_batch))
+    return NULL;
+
+  if(window_ms<0 || window_ms>1000000)
+    return PyErr_Format(PyExc_ValueError, "window_ms must be between zero and one million");
+  if(max_batch<1)
+    return PyErr_Format(PyExc_ValueError, "max_batch must be at least one");
+
+  if(!self->groupcommit)
+    {
+      struct groupcommit *gc=PyMem_Malloc(sizeof(struct groupcommit));
+      if(!gc)
+        return PyErr_NoMemory();
+      memset(gc, 0, sizeof(struct groupcommit));
+      gc->full=PyThread_allocate_lock();
+      if(!gc->full)
+        {
+          PyMem_Free(gc);
+          return PyErr_NoMemory();
+        }
+      /* held while there is nothing to wake */
+      PyThread_acquire_lock(gc->full, WAIT_LOCK);
+      self->groupcommit=gc;
+    }
+
+  self->groupcommit->window_us=(sqlite3_int64)(window_ms*1000);
+  self->groupcommit->maxbatch=max_batch;
+
+  Py_RETURN_NONE;
+}
+
+/* Runs statements on cursor discarding any result rows.  Returns 0 on
+   success or -1 with an exception set. */
+static int
+groupcommit_exec(PyObject *cursor, PyObject *statements, PyObject *bindings)
+{
+  PyObject *res, *rows;
+
+  if(bindings)
+    res=Call_PythonMethodV(cursor, "execute", 1, "(OO)", statements, bindings);
+  else
+    res=Call_PythonMethodV(cursor, "execute", 1, "(O)", statements);
+  if(!res)
+    return -1;
+  rows=PySequence_List(res);
+  Py_DECREF(res);
+  if(!rows)
+    return -1;
+  Py_DECREF(rows);
+  return 0;
+}
+
+/* Runs the batch of entries in one transaction.  Each entry is inside
+   a savepoint so one failing doesn't undo the others.  If the
+   transaction can't be started or committed then every entry gets
+   that exception. */
+static void
+groupcommit_run(Connection *self, struct groupcommitentry *batch)
+{
+  struct groupcommitentry *entry;
+  PyObject *cursor, *res, *etype=NULL, *evalue=NULL, *etb=NULL;
+  PyObject *sql_begin, *sql_savepoint, *sql_rollbackto, *sql_release, *sql_commit, *sql_rollback;
+
+  sql_begin=MAKESTR("begin immediate");
+  sql_savepoint=MAKESTR("savepoint \"apsw-group-commit\"");
+  sql_rollbackto=MAKESTR("rollback to \"apsw-group-commit\"");
+  sql_release=MAKESTR("release \"apsw-group-commit\"");
+  sql_commit=MAKESTR("commit");
+  sql_rollback=MAKESTR("rollback");
+  cursor=NULL;
+  if(!sql_begin || !sql_savepoint || !sql_rollbackto || !sql_release || !sql_commit || !sql_rollback)
+    goto finally;
+
+  cursor=Connection_cursor(self);
+  if(!cursor || groupcommit_exec(cursor, sql_begin, NULL))
+    goto finally;
+
+  for(entry=batch;entry;entry=entry->next)
+    {
+      if(groupcommit_exec(cursor, sql_savepoint, NULL))
+        break;
+      if(groupcommit_exec(cursor, entry->statements, entry->bindings))
+        {
+          PyErr_Fetch(&entry->etype, &entry->evalue, &entry->etb);
+          if(groupcommit_exec(cursor, sql_rollbackto, NULL))
+            break;
+        }
+      if(groupcommit_exec(cursor, sql_release, NULL))
+        break;
+    }
+
+  if(!PyErr_Occurred())
+    groupcommit_exec(cursor, sql_commit, NULL);
+
+  if(PyErr_Occurred() && self->db && !sqlite3_get_autocommit(self->db))
+    {
+      PyErr_Fetch(&etype, &evalue, &etb);
+      if(groupcommit_exec(cursor, sql_rollback, NULL))
+        apsw_write_unraiseable(NULL);
+      PyErr_Restore(etype, evalue, etb);
+    }
+
+ finally:
+  if(cursor)
+    {
+      PyErr_Fetch(&etype, &evalue, &etb);
+      res=Call_PythonMethodV(cursor, "close", 1, "(i)", 1);
+      if(!res)
+        apsw_write_unraiseable(NULL);
+      Py_XDECREF(res);
+      PyErr_Restore(etype, evalue, etb);
+    }
+
+  /* the whole batch failed */
+  if(PyErr_Occurred())
+    {
+      PyErr_Fetch(&etype, &evalue, &etb);
+      PyErr_NormalizeException(&etype, &evalue, &etb);
+      for(entry=batch;entry;entry=entry->next)
+        {
+          Py_CLEAR(entry->etype);
+          Py_CLEAR(entry->evalue);
+          Py_CLEAR(entry->etb);
+          Py_XINCREF(etype);
+          Py_XINCREF(evalue);
+          Py_XINCREF(etb);
+          entry->etype=etype;
+          entry->evalue=evalue;
+          entry->etb=etb;
+        }
+      Py_XDECREF(etype);
+      Py_XDECREF(evalue);
+      Py_XDECREF(etb);
+    }
+
+  Py_XDECREF(cursor);
+  Py_XDECREF(sql_begin);
+  Py_XDECREF(sql_savepoint);
+  Py_XDECREF(sql_rollbackto);
+  Py_XDECREF(sql_release);
+  Py_XDECREF(sql_commit);
+  Py_XDECREF(sql_rollback);
+}
+
+/* The leader waits for the batch to fill, then runs it */
+static void
+groupcommit_lead(Connection *self)
+{
+  struct groupcommit *gc=self->groupcommit;
+  struct groupcommitentry *batch, *entry, *last;
+  int got=0, i;
+
+  if(gc->count<gc->maxbatch && gc->window_us)
+    {
+      gc->leaderwaiting=1;
+#if PY_VERSION_HEX >= 0x03020000
+      Py_BEGIN_ALLOW_THREADS
+        got=(PyThread_acquire_lock_timed(gc->full, (PY_TIMEOUT_T)gc->window_us, 0)==PY_LOCK_ACQUIRED);
+      Py_END_ALLOW_THREADS;
+#else
+      {
+        /* no timed waits so poll */
+        sqlite3_int64 deadline=apsw_monotonic_us()+gc->window_us;
+        while(!(got=PyThread_acquire_lock(gc->full, NOWAIT_LOCK)) && apsw_monotonic_us()<deadline)
+          _PYSQLITE_CALL_V(sqlite3_sleep(1));
+      }
+#endif
+      gc->leaderwaiting=0;
+      /* it may have been released after the wait timed out */
+      if(gc->fullsignalled && !got)
+        PyThread_acquire_lock(gc->full, WAIT_LOCK);
+      gc->fullsignalled=0;
+    }
+
+  /* take the batch from the queue */
+  batch=last=gc->head;
+  for(i=1;i<gc->maxbatch && last->next;i++)
+    last=last->next;
+  gc->head=last->next;
+  if(!gc->head)
+    gc->tail=NULL;
+  gc->count-=i;
+  last->next=NULL;
+
+  groupcommit_run(self, batch);
+
+  /* the entries belong to the waiting threads, so don't touch them
+     after they are woken */
+  for(entry=batch;entry;)
+    {
+      struct groupcommitentry *next=entry->next;
+      entry->done=1;
+      PyThread_release_lock(entry->wakeup);
+      entry=next;
+    }
+
+  /* hand over to the next writer */
+  if(gc->head)
+    PyThread_release_lock(gc->head->wakeup);
+  else
+    gc->leading=0;
+}
+
+/** .. method:: group_execute(statements, bindings=None) -> None
+
+  Queues writes to run in a shared transaction as described in
+  :meth:`~Connection.group_commit`, returning once that transaction
+  has committed.  Use this from many threads at the same time on the
+  same connection instead of doing a transaction per write.  It can't
+  be used while the connection has a transaction open.
+
+  If the *statements* fail then that exception is raised and their
+  changes are undone, but the other writes in the batch are still
+  committed.  If the whole transaction fails, such as
+  :exc:`BusyError` because another connection is writing, then every
+  write in the batch gets that exception.
+
+  Any result rows are discarded.
+
+  :raises ValueError: If :meth:`~Connection.group_commit` has not been
+    called
+*/
+static PyObject *
+Connection_group_execute(Connection *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"statements", "bindings", NULL};
+  struct groupcommit *gc;
+  struct groupcommitentry entry;
+
+  /* CHECK_USE isn't done because other threads are expected to be
+     using the connection at the same time */
+  CHECK_CLOSED(self, NULL);
+
+  gc=self->groupcommit;
+  if(!gc)
+    return PyErr_Format(PyExc_ValueError, "Call group_commit first to turn on group commit");
+
+  memset(&entry, 0, sizeof(entry));
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:group_execute(statements, bindings=None)", kwlist, &entry.statements, &entry.bindings))
+    return NULL;
+  if(entry.bindings==Py_None)
+    entry.bindings=NULL;
+
+  entry.wakeup=PyThread_allocate_lock();
+  if(!entry.wakeup)
+    return PyErr_NoMemory();
+  PyThread_acquire_lock(entry.wakeup, WAIT_LOCK);
+
+  if(gc->tail)
+    gc->tail->next=&entry;
+  else
+    gc->head=&entry;
+  gc->tail=&entry;
+  gc->count++;
+
+  if(gc->leading)
+    {
+      if(gc->count>=gc->maxbatch && gc->leaderwaiting && !gc->fullsignalled)
+        {
+          gc->fullsignalled=1;
+          PyThread_release_lock(gc->full);
+        }
+      Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(entry.wakeup, WAIT_LOCK);
+      Py_END_ALLOW_THREADS;
+    }
+  else
+    gc->leading=1;
+
+  /* if not done then it is our turn to lead */
+  if(!entry.done)
+    groupcommit_lead(self);
+  assert(entry.done);
+
+  /* make sure it is held so it can be released before freeing */
+  PyThread_acquire_lock(entry.wakeup, NOWAIT_LOCK);
+  PyThread_release_lock(entry.wakeup);
+  PyThread_free_lock(entry.wakeup);
+
+  if(entry.etype)
+    {
+      PyErr_Restore(entry.etype, entry.evalue, entry.etb);
+      return NULL;
+    }
+  Py_RETURN_NONE;
+}
+
 /** .. attribute:: filename
 
   The filename of the  database.
@@ -3398,6 +4430,8 @@ static PyMemberDef Connection_members[] = {
 };
 
 static PyMethodDef Connection_methods[] = {
+  {"prepare", (PyCFunction)Connection_prepare, METH_VARARGS|METH_KEYWORDS,
+   "Prepares a statement for repeated execution"},
   {"cursor", (PyCFunction)Connection_cursor, METH_NOARGS,
    "Create a new cursor" },
   {"close",  (PyCFunction)Connection_close, METH_VARARGS,
@@ -3412,6 +4446,14 @@ static PyMethodDef Connection_methods[] = {
    "Creates an aggregate function"},
   {"setbusyhandler", (PyCFunction)Connection_setbusyhandler, METH_O,
    "Sets the busy handler"},
+  {"setquerytimeout", (PyCFunction)Connection_setquerytimeout, METH_VARARGS,
+   "Sets the default query timeout"},
+  {"getquerytimeout", (PyCFunction)Connection_getquerytimeout, METH_NOARGS,
+   "Returns the default query timeout"},
+  {"setbusypolicy", (PyCFunction)Connection_setbusypolicy, METH_VARARGS|METH_KEYWORDS,
+   "Sets a busy handler with backoff implemented in C"},
+  {"busy_stats", (PyCFunction)Connection_busy_stats, METH_VARARGS|METH_KEYWORDS,
+   "Returns busy handling statistics"},
   {"changes", (PyCFunction)Connection_changes, METH_NOARGS,
    "Returns the number of rows changed by last query"},
   {"totalchanges", (PyCFunction)Connection_totalchanges, METH_NOARGS,
@@ -3470,6 +4512,14 @@ static PyMethodDef Connection_methods[] = {
    "Returns the current exec tracer function"},
   {"getrowtrace", (PyCFunction)Connection_getrowtrace, METH_NOARGS,
    "Returns the current row tracer function"},
+  {"setnamedrows", (PyCFunction)Connection_setnamedrows, METH_O,
+   "Sets if cursors return rows with named fields"},
+  {"getnamedrows", (PyCFunction)Connection_getnamedrows, METH_NOARGS,
+   "Returns if cursors return rows with named fields"},
+  {"setlazyrows", (PyCFunction)Connection_setlazyrows, METH_O,
+   "Sets if cursors return rows that decode columns on access"},
+  {"getlazyrows", (PyCFunction)Connection_getlazyrows, METH_NOARGS,
+   "Returns if cursors return rows that decode columns on access"},
   {"__enter__", (PyCFunction)Connection_enter, METH_NOARGS,
    "Context manager entry"},
   {"__exit__", (PyCFunction)Connection_exit, METH_VARARGS,
@@ -3488,6 +4538,18 @@ static PyMethodDef Connection_methods[] = {
    "Return filename of main or attached database"},
     {"txn_state", (PyCFunction)Connection_txn_state, METH_VARARGS,
      "Return transaction state"},
+    {"statement_cache_limits", (PyCFunction)Connection_statement_cache_limits, METH_VARARGS|METH_KEYWORDS,
+     "Get and set the statement cache limits"},
+    {"statement_cache_stats", (PyCFunction)Connection_statement_cache_stats, METH_VARARGS|METH_KEYWORDS,
+     "Statement cache statistics"},
+    {"statement_cache_manifest", (PyCFunction)Connection_statement_cache_manifest, METH_NOARGS,
+     "Returns the query text of the cached statements"},
+    {"preload_statements", (PyCFunction)Connection_preload_statements, METH_O,
+     "Prepares queries into the statement cache"},
+    {"group_commit", (PyCFunction)Connection_group_commit, METH_VARARGS|METH_KEYWORDS,
+     "Turns on group commit"},
+    {"group_execute", (PyCFunction)Connection_group_execute, METH_VARARGS|METH_KEYWORDS,
+     "Queues writes for group commit"},
     {0, 0, 0, 0} /* Sentinel */
 };
 
@@ -141,10 +141,35 @@ struct APSWCursor {
   PyObject *emiter;
   PyObject *emoriginalquery;
 
+  /* executemany of a single statement: the SQLite type each parameter
+     was bound as for the previous row (0 if not planned) */
+  unsigned char *bindplan;
+  int nbindplan;
+
+  /* objects whose memory is bound with SQLITE_STATIC (NULL if none) */
+  PyObject *pins;
+
   /* tracing functions */
   PyObject *exectrace;
   PyObject *rowtrace;
 
+  /* return rows with named fields (-1 means use the connection's setting) */
+  int namedrows;
+
+  /* return LazyRow objects (-1 means use the connection's setting) */
+  int lazyrows;
+
+  /* background stepping from execute(prefetch=N) */
+  struct prefetcher *prefetcher;
+
+  /* apsw_monotonic_us value when the current execution times out, zero for none */
+  sqlite3_int64 deadline;
+
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+  /* the statement most recently completed for scanstatus */
+  struct APSWStatement *laststatement;
+#endif
+
   /* weak reference support */
   PyObject *weakreflist;
 
@@ -154,12 +179,447 @@ struct APSWCursor {
 typedef struct APSWCursor APSWCursor;
 static PyTypeObject APSWCursorType;
 
+/* LAZY ROW TYPE */
+
+/* A copy of one column taken while the statement was on the row.
+   Text and blob bytes live in the row's data block at offset. */
+struct lazycolumn {
+  int type;                        /* SQLITE_INTEGER etc */
+  int len;                         /* bytes of text or blob */
+  union {
+    sqlite3_int64 i;
+    double d;
+    size_t offset;
+    const void *src;               /* only used while copying */
+  } u;
+};
+
+typedef struct {
+  PyObject_HEAD
+  int ncols;
+  struct lazycolumn *columns;      /* ncols entries */
+  PyObject **values;               /* decoded values, NULL until first accessed */
+  char *data;                      /* copied text and blob bytes (sqlite3_malloc) */
+} APSWLazyRow;
+
+static PyTypeObject APSWLazyRowType;
+
+/* ROW COPYING */
+
+/* Copies the current row of stmt into columns and *data, growing
+   *data (of *datasize bytes) with sqlite3_realloc64 as needed.  The
+   caller must hold the database mutex.  No Python APIs are used so it
+   can also be called by threads without the GIL.  Returns SQLITE_OK
+   or SQLITE_NOMEM. */
+static int
+rowcopy_capture(sqlite3_stmt *stmt, int ncols, struct lazycolumn *columns, char **data, size_t *datasize)
+{
+  struct lazycolumn *col;
+  size_t total=0;
+  int i;
+
+  for(i=0, col=columns; i<ncols; i++, col++)
+    {
+      PYSQLITE_LOCKED_CALL(col->type=sqlite3_column_type(stmt, i));
+      col->len=0;
+      switch(col->type)
+        {
+        case SQLITE_INTEGER:
+          PYSQLITE_LOCKED_CALL(col->u.i=sqlite3_column_int64(stmt, i));
+          break;
+        case SQLITE_FLOAT:
+          PYSQLITE_LOCKED_CALL(col->u.d=sqlite3_column_double(stmt, i));
+          break;
+        case SQLITE_TEXT:
+          PYSQLITE_LOCKED_CALL( (col->u.src=sqlite3_column_text(stmt, i), col->len=sqlite3_column_bytes(stmt, i)) );
+          break;
+        case SQLITE_BLOB:
+          PYSQLITE_LOCKED_CALL( (col->u.src=sqlite3_column_blob(stmt, i), col->len=sqlite3_column_bytes(stmt, i)) );
+          break;
+        }
+      total+=col->len;
+    }
+
+  if(!*data || total>=*datasize)
+    {
+      char *newdata;
+      PYSQLITE_LOCKED_CALL(newdata=sqlite3_realloc64(*data, total+1));
+      if(!newdata)
+        return SQLITE_NOMEM;
+      *data=newdata;
+      *datasize=total+1;
+    }
+
+  total=0;
+  for(i=0, col=columns; i<ncols; i++, col++)
+    if(col->type==SQLITE_TEXT || col->type==SQLITE_BLOB)
+      {
+        if(col->len)
+          memcpy(*data+total, col->u.src, col->len);
+        col->u.offset=total;
+        total+=col->len;
+      }
+  return SQLITE_OK;
+}
+
+/* Returns a new reference to a Python object for a copied column */
+static PyObject *
+rowcopy_convert(struct lazycolumn *col, const char *data)
+{
+  switch(col->type)
+    {
+    case SQLITE_INTEGER:
+#if PY_MAJOR_VERSION<3
+      if (col->u.i>=LONG_MIN && col->u.i<=LONG_MAX)
+        return PyInt_FromLong((long)col->u.i);
+#endif
+      return PyLong_FromLongLong(col->u.i);
+    case SQLITE_FLOAT:
+      return PyFloat_FromDouble(col->u.d);
+    case SQLITE_TEXT:
+      return convertutf8stringsize(data+col->u.offset, col->len);
+    case SQLITE_BLOB:
+      return converttobytes(data+col->u.offset, col->len);
+    case SQLITE_NULL:
+      Py_RETURN_NONE;
+    default:
+      return PyErr_Format(APSWException, "Unknown sqlite column type %d!", col->type);
+    }
+}
+
+/* PREFETCH */
+
+/* With execute(prefetch=N) a worker thread steps the statement and
+   copies rows into a ring of N slots while the cursor turns earlier
+   rows into Python objects.  The worker only holds the GIL when
+   callbacks such as user defined functions run on it, and to hand
+   over any exception they raised when it exits.  It is only started once a statement has returned its first row, so
+   statements that don't return rows never start a thread, and it
+   exits when the statement is done or has an error.  The cursor then
+   carries on as though it had made the sqlite3_step call itself.
+
+   Python locks are used as binary semaphores to wake the other side.
+   Only one thread ever waits on each of rowready and spaceready.  A
+   waiting side is only woken once half the slots are ready, so the
+   threads don't take turns sleeping on every row. */
+
+struct prefetchslot {
+  struct lazycolumn *columns;      /* ncols entries */
+  char *data;                      /* text and blob bytes (sqlite3_malloc) */
+  size_t datasize;                 /* allocated size of data */
+};
+
+typedef struct prefetcher {
+  int nslots;
+  struct prefetchslot *slots;
+  struct lazycolumn *columns;      /* storage for all slots' columns */
+  sqlite3 *db;
+  sqlite3_stmt *stmt;              /* statement the worker is stepping */
+  sqlite3_stmt *primed;            /* statement that returned its first row without the worker */
+  int ncols;
+  int current;                     /* slot with the cursor's current row or -1 */
+  int running;                     /* the worker thread exists */
+
+  PyThread_type_lock finished;     /* held until the worker exits */
+  PyThread_type_lock lock;         /* protects the members below */
+  PyThread_type_lock rowready;     /* released to wake the cursor */
+  PyThread_type_lock spaceready;   /* released to wake the worker */
+  int head;                        /* oldest filled slot */
+  int count;                       /* number of filled slots */
+  int result;                      /* sqlite3_step result that stopped the worker, -1 while going */
+  int nomem;                       /* result is from running out of memory copying a row */
+  int stop;                        /* the cursor wants the worker to exit */
+  int cursorwaiting;
+  int workerwaiting;
+
+  sqlite3_int64 deadline;          /* copied into *deadlinep while stepping */
+  sqlite3_int64 *deadlinep;        /* the connection's deadline */
+
+  /* exception raised by a callback on the worker, set when it exits */
+  PyObject *exctype, *excvalue, *exctraceback;
+} prefetcher;
+
+/* The connection's progress handler checks the deadline of whichever
+   statement is being stepped, which has to be set with the database
+   mutex held.  Statements run inside another one (eg by a user
+   defined function) are also bound by the outer deadline. */
+#define DEADLINE_ENTER(deadlinep, deadline) \
+  do { saveddeadline=*(deadlinep); if((deadline) && (!saveddeadline || (deadline)<saveddeadline)) *(deadlinep)=(deadline); } while(0)
+#define DEADLINE_LEAVE(deadlinep) \
+  do { *(deadlinep)=saveddeadline; } while(0)
+
+#define PREFETCH_WAKE(pf) ( ((pf)->nslots+1)/2 )
+
+static void
+prefetch_worker(void *arg)
+{
+  prefetcher *pf=(prefetcher*)arg;
+  struct prefetchslot *slot;
+  int res, nomem;
+  sqlite3_int64 saveddeadline;
+  PyGILState_STATE gilstate;
+  PyThreadState *tstate;
+
+  /* The thread state is kept for the life of the worker so callbacks
+     run while stepping all use it.  An exception they raise then
+     survives until it is fetched below for the cursor to raise, and
+     later callbacks see it is outstanding as they would on the
+     cursor's own thread. */
+  gilstate=PyGILState_Ensure();
+  tstate=PyEval_SaveThread();
+
+  for(;;)
+    {
+      PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+      while(pf->count==pf->nslots && !pf->stop)
+        {
+          pf->workerwaiting=1;
+          PyThread_release_lock(pf->lock);
+          PyThread_acquire_lock(pf->spaceready, WAIT_LOCK);
+          PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+        }
+      if(pf->stop)
+        {
+          PyThread_release_lock(pf->lock);
+          break;
+        }
+      /* the cursor only uses slots from head to head+count-1 */
+      slot=&pf->slots[(pf->head+pf->count)%pf->nslots];
+      PyThread_release_lock(pf->lock);
+
+      nomem=0;
+      PYSQLITE_NOGIL_MUTEX_ENTER(pf->db);
+      DEADLINE_ENTER(pf->deadlinep, pf->deadline);
+      PYSQLITE_LOCKED_CALL(res=sqlite3_step(pf->stmt));
+      DEADLINE_LEAVE(pf->deadlinep);
+      if(res==SQLITE_ROW && rowcopy_capture(pf->stmt, pf->ncols, slot->columns, &slot->data, &slot->datasize)!=SQLITE_OK)
+        {
+          res=SQLITE_NOMEM;
+          nomem=1;
+        }
+      PYSQLITE_DB_MUTEX_LEAVE(pf->db);
+
+      PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+      if(res==SQLITE_ROW)
+        pf->count++;
+      else
+        {
+          pf->result=res;
+          pf->nomem=nomem;
+        }
+      if(pf->cursorwaiting && (pf->count>=PREFETCH_WAKE(pf) || pf->result!=-1))
+        {
+          pf->cursorwaiting=0;
+          PyThread_release_lock(pf->rowready);
+        }
+      PyThread_release_lock(pf->lock);
+
+      if(res!=SQLITE_ROW)
+        break;
+    }
+
+  PyEval_RestoreThread(tstate);
+  if(PyErr_Occurred())
+    PyErr_Fetch(&pf->exctype, &pf->excvalue, &pf->exctraceback);
+  PyGILState_Release(gilstate);
+
+  PyThread_release_lock(pf->finished);
+}
+
+/* Makes a prefetcher with nslots row slots.  Returns NULL with an
+   exception on failure. */
+static prefetcher *
+prefetch_new(sqlite3 *db, int nslots)
+{
+  prefetcher *pf=PyMem_Malloc(sizeof(prefetcher));
+
+  if(!pf)
+    return (prefetcher*)PyErr_NoMemory();
+  memset(pf, 0, sizeof(prefetcher));
+  pf->db=db;
+  pf->nslots=nslots;
+  pf->current=-1;
+  pf->slots=PyMem_Malloc(sizeof(struct prefetchslot)*nslots);
+  if(pf->slots)
+    memset(pf->slots, 0, sizeof(struct prefetchslot)*nslots);
+  pf->finished=PyThread_allocate_lock();
+  pf->lock=PyThread_allocate_lock();
+  pf->rowready=PyThread_allocate_lock();
+  pf->spaceready=PyThread_allocate_lock();
+  if(!pf->slots || !pf->finished || !pf->lock || !pf->rowready || !pf->spaceready)
+    {
+      if(pf->finished) PyThread_free_lock(pf->finished);
+      if(pf->lock) PyThread_free_lock(pf->lock);
+      if(pf->rowready) PyThread_free_lock(pf->rowready);
+      if(pf->spaceready) PyThread_free_lock(pf->spaceready);
+      PyMem_Free(pf->slots);
+      PyMem_Free(pf);
+      return (prefetcher*)PyErr_NoMemory();
+    }
+  /* the semaphores start out taken */
+  PyThread_acquire_lock(pf->rowready, WAIT_LOCK);
+  PyThread_acquire_lock(pf->spaceready, WAIT_LOCK);
+  return pf;
+}
+
+/* Starts the worker on stmt which is positioned on its first row.
+   Returns zero on success.  On failure no exception is set and the
+   cursor should step the statement itself. */
+static int
+prefetch_start(prefetcher *pf, sqlite3_stmt *stmt)
+{
+  int i, ncols;
+
+  assert(!pf->running);
+  pf->primed=NULL;
+  ncols=sqlite3_column_count(stmt);
+  pf->columns=PyMem_Malloc(sizeof(struct lazycolumn)*(ncols?ncols:1)*pf->nslots);
+  if(!pf->columns)
+    return -1;
+  for(i=0;i<pf->nslots;i++)
+    pf->slots[i].columns=pf->columns+i*ncols;
+  pf->stmt=stmt;
+  pf->ncols=ncols;
+  pf->current=-1;
+  pf->head=pf->count=0;
+  pf->result=-1;
+  pf->nomem=pf->stop=0;
+  pf->cursorwaiting=pf->workerwaiting=0;
+
+  PyThread_acquire_lock(pf->finished, WAIT_LOCK);
+  if(PyThread_start_new_thread(prefetch_worker, pf)==(unsigned long)-1)
+    {
+      PyThread_release_lock(pf->finished);
+      PyMem_Free(pf->columns);
+      pf->columns=NULL;
+      pf->stmt=NULL;
+      return -1;
+    }
+  pf->running=1;
+  return 0;
+}
+
+/* Stops the worker if necessary and waits for it to exit.  An
+   exception from the worker is discarded unless keepexc is set in
+   which case it becomes the current exception. */
+static void
+prefetch_join(prefetcher *pf, int keepexc)
+{
+  if(!pf->running)
+    return;
+
+  Py_BEGIN_ALLOW_THREADS
+    {
+      PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+      pf->stop=1;
+      if(pf->workerwaiting)
+        {
+          pf->workerwaiting=0;
+          PyThread_release_lock(pf->spaceready);
+        }
+      PyThread_release_lock(pf->lock);
+      PyThread_acquire_lock(pf->finished, WAIT_LOCK);
+      PyThread_release_lock(pf->finished);
+    }
+  Py_END_ALLOW_THREADS;
+
+  PyMem_Free(pf->columns);
+  pf->columns=NULL;
+  pf->stmt=NULL;
+  pf->current=-1;
+  pf->running=0;
+
+  if(keepexc && pf->exctype)
+    PyErr_Restore(pf->exctype, pf->excvalue, pf->exctraceback);
+  else
+    {
+      Py_XDECREF(pf->exctype);
+      Py_XDECREF(pf->excvalue);
+      Py_XDECREF(pf->exctraceback);
+    }
+  pf->exctype=pf->excvalue=pf->exctraceback=NULL;
+}
+
+/* Waits for the worker's next row.  Returns SQLITE_ROW with the row
+   in slot current, or the sqlite3_step result that stopped the
+   worker in which case it has exited. */
+static int
+prefetch_next(prefetcher *pf)
+{
+  int res;
+
+  assert(pf->running);
+
+  /* the worker never waits while holding lock so it is taken without
+     releasing the GIL, which is only released if we have to wait */
+  PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+  if(pf->current>=0)
+    {
+      /* finished with the previous row */
+      pf->head=(pf->head+1)%pf->nslots;
+      pf->count--;
+      pf->current=-1;
+      if(pf->workerwaiting && pf->nslots-pf->count>=PREFETCH_WAKE(pf))
+        {
+          pf->workerwaiting=0;
+          PyThread_release_lock(pf->spaceready);
+        }
+    }
+  if(!pf->count && pf->result==-1)
+    {
+      Py_BEGIN_ALLOW_THREADS
+        while(!pf->count && pf->result==-1)
+          {
+            pf->cursorwaiting=1;
+            PyThread_release_lock(pf->lock);
+            PyThread_acquire_lock(pf->rowready, WAIT_LOCK);
+            PyThread_acquire_lock(pf->lock, WAIT_LOCK);
+          }
+      Py_END_ALLOW_THREADS;
+    }
+  if(pf->count)
+    {
+      pf->current=pf->head;
+      res=SQLITE_ROW;
+    }
+  else
+    res=pf->result;
+  PyThread_release_lock(pf->lock);
+
+  if(res!=SQLITE_ROW)
+    prefetch_join(pf, 1);
+  return res;
+}
+
+static void
+prefetch_free(prefetcher *pf)
+{
+  int i;
+
+  prefetch_join(pf, 0);
+  for(i=0;i<pf->nslots;i++)
+    sqlite3_free(pf->slots[i].data);
+  PyThread_free_lock(pf->finished);
+  PyThread_free_lock(pf->lock);
+  PyThread_free_lock(pf->rowready);
+  PyThread_free_lock(pf->spaceready);
+  PyMem_Free(pf->slots);
+  PyMem_Free(pf);
+}
+
 /* CURSOR CODE */
 
 /* Macro for getting a tracer.  If our tracer is NULL or None then return 0 else return connection tracer */
 
 #define ROWTRACE   ( (self->rowtrace && self->rowtrace!=Py_None) ? self->rowtrace : ( (self->rowtrace==Py_None) ? 0 : self->connection->rowtrace ) )
 
+#define NAMEDROWS  ( (self->namedrows>=0) ? self->namedrows : self->connection->namedrows )
+
+#define LAZYROWS   ( (self->lazyrows>=0) ? self->lazyrows : self->connection->lazyrows )
+
+/* the current row if it came from the prefetch worker, else NULL */
+#define PREFETCHSLOT ( (self->prefetcher && self->prefetcher->current>=0) ? &self->prefetcher->slots[self->prefetcher->current] : NULL )
+
 #define EXECTRACE  ( (self->exectrace && self->exectrace!=Py_None) ? self->exectrace : ( (self->exectrace==Py_None) ? 0 : self->connection->exectrace ) )
 
 
@@ -174,11 +634,29 @@ resetcursor(APSWCursor *self, int force)
   Py_CLEAR(self->description_cache[0]);
   Py_CLEAR(self->description_cache[1]);
 
+  /* the worker must be stopped before the statement is finalized */
+  if(self->prefetcher)
+    {
+      prefetch_free(self->prefetcher);
+      self->prefetcher=NULL;
+    }
+
   if(force)
     PyErr_Fetch(&etype, &eval, &etb);
 
   Py_XINCREF(nextquery);
 
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+  /* keep the statement so scanstatus can report on it after it
+     completes, and forget it when starting something else */
+  Py_CLEAR(self->laststatement);
+  if(self->statement)
+    {
+      Py_INCREF(self->statement);
+      self->laststatement=self->statement;
+    }
+#endif
+
   if(self->statement)
     {
       INUSE_CALL(res=statementcache_finalize(self->connection->stmtcache, self->statement, !force));
@@ -195,6 +673,7 @@ resetcursor(APSWCursor *self, int force)
     }
 
   Py_CLEAR(self->bindings);
+  Py_CLEAR(self->pins);
   self->bindingsoffset= -1;
 
   if(!force && self->status!=C_DONE && nextquery)
@@ -227,6 +706,9 @@ resetcursor(APSWCursor *self, int force)
 
   Py_CLEAR(self->emiter);
   Py_CLEAR(self->emoriginalquery);
+  PyMem_Free(self->bindplan);
+  self->bindplan=NULL;
+  self->nbindplan=0;
 
   self->status=C_DONE;
 
@@ -265,6 +747,10 @@ APSWCursor_close_internal(APSWCursor *self, int force)
       assert(!PyErr_Occurred());
     }
 
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+  Py_CLEAR(self->laststatement);
+#endif
+
   /* Remove from connection dependents list.  Has to be done before we decref self->connection
      otherwise connection could dealloc and we'd still be in list */
   if(self->connection)
@@ -306,8 +792,18 @@ APSWCursor_init(APSWCursor *self, Connection *connection)
   self->bindingsoffset=0;
   self->emiter=0;
   self->emoriginalquery=0;
+  self->bindplan=NULL;
+  self->nbindplan=0;
+  self->pins=NULL;
   self->exectrace=0;
   self->rowtrace=0;
+  self->namedrows=-1;
+  self->lazyrows=-1;
+  self->prefetcher=NULL;
+  self->deadline=0;
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+  self->laststatement=NULL;
+#endif
   self->inuse=0;
   self->weakreflist=NULL;
   self->description_cache[0]=0;
@@ -436,6 +932,191 @@ static PyObject* APSWCursor_getdescription(APSWCursor *self)
   return APSWCursor_internal_getdescription(self, 0);
 }
 
+/** .. method:: statement_status(reset=False) -> dict
+
+  Returns a dict of the `counters
+  <https://sqlite.org/c3ref/c_stmtstatus_counter.html>`__ SQLite keeps
+  for the statement currently executing.  Cached statements keep
+  counting over every execution since they were prepared, so the
+  *runs* count tells you how many executions the others cover.  Use
+  :meth:`Connection.statement_cache_stats` to get the counters of all
+  the cached statements.
+
+    fullscan_steps
+      Steps forward in a full table scan.  Large numbers suggest an
+      index would help.
+    sorts
+      Sort operations, which an index may avoid
+    autoindex
+      Rows inserted into automatic indices, which means an index is
+      missing
+    vm_steps
+      Virtual machine operations, roughly the total work done
+    reprepares
+      Times the statement was automatically reprepared, usually due to
+      schema changes
+    runs
+      Times the statement has been run
+    memused
+      Bytes of memory used by the statement
+
+  Some counters are not present when using older SQLite versions.
+
+  :param reset: Reset the counters (other than *memused*) to zero
+    after getting them
+
+  :raises ExecutionCompleteError: If no statement is executing
+
+  -* sqlite3_stmt_status
+*/
+static PyObject *
+APSWCursor_statement_status(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"reset", NULL};
+  PyObject *reset=NULL, *res;
+  int doreset=0;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|O:statement_status(reset=False)", kwlist, &reset))
+    return NULL;
+
+  if(reset)
+    {
+      doreset=PyObject_IsTrue(reset);
+      if(doreset<0)
+        return NULL;
+    }
+
+  if(!self->statement)
+    return PyErr_Format(ExcComplete, "Can't get status for statements that have completed execution");
+
+  res=PyDict_New();
+  if(!res)
+    return NULL;
+  PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+  if(statementcache_stmtstatus(self->statement, doreset, res))
+    Py_CLEAR(res);
+  PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+  return res;
+}
+
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+/** .. method:: scanstatus(reset=False) -> list
+
+  Returns how each loop of the query plan performed for the statement
+  currently executing, or the one that most recently completed.  This
+  shows where a query's time goes and how far off the query planner's
+  estimates were, using real data and without running it again under
+  `EXPLAIN QUERY PLAN <https://sqlite.org/eqp.html>`__.  The counts
+  accumulate over every execution of the statement, including from
+  the statement cache, until reset.
+
+  The list has a dict for each loop with these keys:
+
+    name
+      Name of the table or index, or None
+    explain
+      Text describing the loop as from ``EXPLAIN QUERY PLAN``
+    loops
+      Number of times the loop was run
+    rows_visited
+      Total rows visited over all the runs of the loop
+    estimated_rows
+      Rows per run the query planner estimated the loop would visit
+    selectid
+      The ``select-id`` for the loop as in ``EXPLAIN QUERY PLAN``
+      output
+
+  For a multiple statement query it is the last statement executed.
+  This method is only present if SQLite was compiled with
+  `SQLITE_ENABLE_STMT_SCANSTATUS
+  <https://sqlite.org/compile.html#enable_stmt_scanstatus>`__ which
+  the :ref:`--enable-scanstatus <setup_build_flags>` setup option does.
+
+  :param reset: Reset the counts to zero after getting them
+
+  :raises ExecutionCompleteError: If there is no statement to report on
+
+  -* sqlite3_stmt_scanstatus sqlite3_stmt_scanstatus_reset
+*/
+static PyObject *
+APSWCursor_scanstatus(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"reset", NULL};
+  PyObject *reset=NULL, *res=NULL, *item=NULL;
+  sqlite3_stmt *vdbe;
+  int doreset=0, idx;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|O:scanstatus(reset=False)", kwlist, &reset))
+    return NULL;
+
+  if(reset)
+    {
+      doreset=PyObject_IsTrue(reset);
+      if(doreset<0)
+        return NULL;
+    }
+
+  vdbe=self->statement?self->statement->vdbestatement:(self->laststatement?self->laststatement->vdbestatement:NULL);
+  if(!vdbe)
+    return PyErr_Format(ExcComplete, "There is no statement to get the scan status of");
+
+  res=PyList_New(0);
+  if(!res)
+    return NULL;
+
+  /* The GIL is kept and the cursor marked in use while the mutex is
+     held so no other thread can finalize vdbe, and name and explain
+     are copied before it is released */
+  PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+  self->inuse=1;
+  for(idx=0;;idx++)
+    {
+      sqlite3_int64 nloop=0, nvisit=0;
+      double est=0;
+      const char *name=NULL, *explain=NULL;
+      int selectid=0, rc;
+
+      PYSQLITE_LOCKED_CALL(rc=sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_NLOOP, &nloop));
+      if(rc)
+        break;
+      PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_NVISIT, &nvisit));
+      PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_EST, &est));
+      PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_NAME, &name));
+      PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_EXPLAIN, &explain));
+      PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus(vdbe, idx, SQLITE_SCANSTAT_SELECTID, &selectid));
+
+      item=Py_BuildValue("{s:O&,s:O&,s:L,s:L,s:d,s:i}",
+                         "name", convertutf8string, name,
+                         "explain", convertutf8string, explain,
+                         "loops", (long long)nloop,
+                         "rows_visited", (long long)nvisit,
+                         "estimated_rows", est,
+                         "selectid", selectid);
+      if(!item || PyList_Append(res, item))
+        break;
+      Py_CLEAR(item);
+    }
+
+  if(doreset && !PyErr_Occurred())
+    PYSQLITE_LOCKED_CALL(sqlite3_stmt_scanstatus_reset(vdbe));
+  self->inuse=0;
+  PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+
+  if(PyErr_Occurred())
+    {
+      Py_XDECREF(item);
+      Py_CLEAR(res);
+    }
+  return res;
+}
+#endif
+
 /** .. attribute:: description
 
     Based on the `DB-API cursor property
@@ -449,6 +1130,64 @@ static PyObject *APSWCursor_getdescription_dbapi(APSWCursor *self)
   return APSWCursor_internal_getdescription(self, 1);
 }
 
+/* Text and blobs at least this many bytes are bound without SQLite
+   making its own copy when they come from immutable objects.  Smaller
+   ones are cheaper to copy than to keep track of. */
+#define BIND_STATIC_MIN 256
+
+/* Returns how SQLite should treat the memory of immutable obj being
+   bound.  If self->bindings is a tuple then it keeps obj alive until
+   the statement is reset and rebound or finalized.  Otherwise (dicts
+   and lists can be changed while the statement runs) obj is added to
+   self->pins which are released at the same points.  Falls back to
+   SQLite copying the memory if obj can't be pinned. */
+static sqlite3_destructor_type
+APSWCursor_bindlifetime(APSWCursor *self, PyObject *obj)
+{
+  if(self->bindings && PyTuple_CheckExact(self->bindings))
+    return SQLITE_STATIC;
+
+  if(!self->pins)
+    self->pins=PyList_New(0);
+  if(!self->pins || PyList_Append(self->pins, obj))
+    {
+      PyErr_Clear();
+      return SQLITE_TRANSIENT;
+    }
+  return SQLITE_STATIC;
+}
+
+#if PY_VERSION_HEX >= 0x03030000 && !defined(PYPY_VERSION)
+#define BIND_UTF8_DIRECT
+/* Returns UTF-8 of a str that lives as long as the str.  For ascii
+   strings that is the str's own data.  Otherwise it is the UTF-8 that
+   Python caches in the str, made on first use, and only for strings
+   that could be long enough to bind without copying.  Returns NULL
+   with no exception if it isn't available. */
+static const char *
+bind_utf8_direct(PyObject *obj, Py_ssize_t *len)
+{
+  const char *utf8;
+
+  if(PyUnicode_READY(obj))
+    {
+      PyErr_Clear();
+      return NULL;
+    }
+  if(PyUnicode_IS_ASCII(obj))
+    {
+      *len=PyUnicode_GET_LENGTH(obj);
+      return (const char*)PyUnicode_DATA(obj);
+    }
+  if(PyUnicode_GET_LENGTH(obj)*4<BIND_STATIC_MIN)
+    return NULL;
+  utf8=PyUnicode_AsUTF8AndSize(obj, len);
+  if(!utf8)
+    PyErr_Clear();
+  return utf8;
+}
+#endif
+
 /* internal function - returns SQLite error code (ie SQLITE_OK if all is well) */
 static int
 APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
@@ -487,6 +1226,18 @@ APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
   else if (PyUnicode_Check(obj))
     {
       const void *badptr=NULL;
+#ifdef BIND_UTF8_DIRECT
+      Py_ssize_t directbytes=0;
+      const char *direct=bind_utf8_direct(obj, &directbytes);
+      if(direct && directbytes>=BIND_STATIC_MIN && directbytes<=APSW_INT32_MAX)
+        {
+          sqlite3_destructor_type lifetime=APSWCursor_bindlifetime(self, obj);
+          PYSQLITE_CUR_CALL(res=sqlite3_bind_text(self->statement->vdbestatement, arg, direct, (int)directbytes, lifetime));
+          badptr=direct;
+        }
+      else
+#endif
+        {
       UNIDATABEGIN(obj)
         APSW_FAULT_INJECT(DoBindingUnicodeConversionFails,,strdata=(char*)PyErr_NoMemory());
         badptr=strdata;
@@ -503,6 +1254,7 @@ APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
               PYSQLITE_CUR_CALL(res=USE16(sqlite3_bind_text)(self->statement->vdbestatement, arg, strdata, strbytes, SQLITE_TRANSIENT));
           }
       UNIDATAEND(obj);
+        }
       if(!badptr)
         {
           assert(PyErr_Occurred());
@@ -560,6 +1312,7 @@ APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
       const void *buffer;
       Py_ssize_t buflen;
       int asrb;
+      sqlite3_destructor_type lifetime=SQLITE_TRANSIENT;
 
       APSW_FAULT_INJECT(DoBindingAsReadBufferFails,asrb=PyObject_AsReadBuffer(obj, &buffer, &buflen), (PyErr_NoMemory(), asrb=-1));
       if(asrb!=0)
@@ -570,7 +1323,11 @@ APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
           SET_EXC(SQLITE_TOOBIG, NULL);
 	  return -1;
 	}
-      PYSQLITE_CUR_CALL(res=sqlite3_bind_blob(self->statement->vdbestatement, arg, buffer, buflen, SQLITE_TRANSIENT));
+      /* only bytes are immutable - the contents of other buffers could
+         change or move before the statement runs */
+      if(PyBytes_CheckExact(obj) && buflen>=BIND_STATIC_MIN)
+        lifetime=APSWCursor_bindlifetime(self, obj);
+      PYSQLITE_CUR_CALL(res=sqlite3_bind_blob(self->statement->vdbestatement, arg, buffer, buflen, lifetime));
     }
   else if(PyObject_TypeCheck(obj, &ZeroBlobBindType)==1)
     {
@@ -591,11 +1348,117 @@ APSWCursor_dobinding(APSWCursor *self, int arg, PyObject *obj)
   return 0;
 }
 
+/* Which binding plan kind (an SQLite type) obj has.  Only exact types
+   are planned so subclasses always go through APSWCursor_dobinding. */
+static int
+bindplan_kind(PyObject *obj)
+{
+  if(obj==Py_None)
+    return SQLITE_NULL;
+#if PY_MAJOR_VERSION < 3
+  if(PyInt_CheckExact(obj))
+    return SQLITE_INTEGER;
+#endif
+  if(PyLong_CheckExact(obj))
+    return SQLITE_INTEGER;
+  if(PyFloat_CheckExact(obj))
+    return SQLITE_FLOAT;
+#if PY_VERSION_HEX >= 0x03030000
+  if(PyUnicode_CheckExact(obj))
+    return SQLITE_TEXT;
+#endif
+  return 0;
+}
+
+/* Binds obj using the plan kind from the previous row.  Returns 0 if
+   bound, 1 if obj doesn't match the kind and APSWCursor_dobinding
+   should be used, or -1 with an exception on error. */
+static int
+APSWCursor_dobinding_planned(APSWCursor *self, int arg, PyObject *obj, int kind)
+{
+  int res=SQLITE_OK;
+
+  switch(kind)
+    {
+    case SQLITE_NULL:
+      if(obj!=Py_None)
+        return 1;
+      PYSQLITE_CUR_CALL(res=sqlite3_bind_null(self->statement->vdbestatement, arg));
+      break;
+
+    case SQLITE_INTEGER:
+      {
+        long long v;
+#if PY_MAJOR_VERSION < 3
+        if(PyInt_CheckExact(obj))
+          v=PyInt_AS_LONG(obj);
+        else
+#endif
+        if(PyLong_CheckExact(obj))
+          {
+            v=PyLong_AsLongLong(obj);
+            if(v==-1 && PyErr_Occurred())
+              return -1;
+          }
+        else
+          return 1;
+        PYSQLITE_CUR_CALL(res=sqlite3_bind_int64(self->statement->vdbestatement, arg, v));
+      }
+      break;
+
+    case SQLITE_FLOAT:
+      {
+        double v;
+        if(!PyFloat_CheckExact(obj))
+          return 1;
+        v=PyFloat_AS_DOUBLE(obj);
+        PYSQLITE_CUR_CALL(res=sqlite3_bind_double(self->statement->vdbestatement, arg, v));
+      }
+      break;
+
+#if PY_VERSION_HEX >= 0x03030000
+    case SQLITE_TEXT:
+      {
+        /* the UTF-8 is cached in the string object, and for ascii
+           strings is the string's own storage, so no new object is
+           made per value */
+        Py_ssize_t strbytes;
+        const char *strdata;
+        sqlite3_destructor_type lifetime=SQLITE_TRANSIENT;
+        if(!PyUnicode_CheckExact(obj))
+          return 1;
+        strdata=PyUnicode_AsUTF8AndSize(obj, &strbytes);
+        if(!strdata)
+          return -1;
+        if(strbytes>APSW_INT32_MAX)
+          {
+            SET_EXC(SQLITE_TOOBIG, NULL);
+            return -1;
+          }
+        if(strbytes>=BIND_STATIC_MIN)
+          lifetime=APSWCursor_bindlifetime(self, obj);
+        PYSQLITE_CUR_CALL(res=sqlite3_bind_text(self->statement->vdbestatement, arg, strdata, (int)strbytes, lifetime));
+      }
+      break;
+#endif
+
+    default:
+      return 1;
+    }
+
+  if(res!=SQLITE_OK)
+    {
+      SET_EXC(res, self->connection->db);
+      return -1;
+    }
+  return 0;
+}
+
 /* internal function */
 static int
 APSWCursor_dobindings(APSWCursor *self)
 {
-  int nargs, arg, res=-1, sz=0;
+  int nargs, arg, sz=0;
   PyObject *obj;
 
   assert(!PyErr_Occurred());
@@ -614,27 +1477,27 @@ APSWCursor_dobindings(APSWCursor *self)
   /* a dictionary? */
   if (self->bindings && PyDict_Check(self->bindings))
     {
-      for(arg=1;arg<=nargs;arg++)
+      /* the names are worked out once per statement */
+      PyObject *names=self->statement->paramnames;
+      if(!names)
         {
-	  PyObject *keyo=NULL;
-          const char *key;
-
-          PYSQLITE_CUR_CALL(key=sqlite3_bind_parameter_name(self->statement->vdbestatement, arg));
+          names=statementcache_paramnames(self->statement);
+          if(!names)
+            return -1;
+        }
+      assert(PyTuple_GET_SIZE(names)==nargs);
+
+      for(arg=1;arg<=nargs;arg++)
+        {
+	  PyObject *keyo=PyTuple_GET_ITEM(names, arg-1);
 
-          if(!key)
+          if(keyo==Py_None)
             {
               PyErr_Format(ExcBindings, "Binding %d has no name, but you supplied a dict (which only has names).", arg-1);
               return -1;
             }
 
-	  assert(*key==':' || *key=='$');
-          key++; /* first char is a colon or dollar which we skip */
-
-	  keyo=PyUnicode_DecodeUTF8(key, strlen(key), NULL);
-	  if(!keyo) return -1;
-
 	  obj=PyDict_GetItem(self->bindings, keyo);
-	  Py_DECREF(keyo);
 
           if(!obj)
             /* this is where we could error on missing keys */
@@ -668,12 +1531,34 @@ APSWCursor_dobindings(APSWCursor *self)
       return -1;
     }
 
-  res=SQLITE_OK;
+  /* executemany of a single statement remembers the types bound for
+     each parameter so following rows can skip the full type dispatch */
+  if(self->emiter && !self->statement->next && self->statement->utf8==self->emoriginalquery && nargs!=self->nbindplan)
+    {
+      unsigned char *newplan=PyMem_Realloc(self->bindplan, nargs?nargs:1);
+      if(!newplan)
+        {
+          PyErr_NoMemory();
+          return -1;
+        }
+      memset(newplan, 0, nargs?nargs:1);
+      self->bindplan=newplan;
+      self->nbindplan=nargs;
+    }
 
   /* nb sqlite starts bind args at one not zero */
   for(arg=1;arg<=nargs;arg++)
     {
       obj=PySequence_Fast_GET_ITEM(self->bindings, arg-1+self->bindingsoffset);
+      if(self->bindplan && self->nbindplan==nargs)
+        {
+          int planned=APSWCursor_dobinding_planned(self, arg, obj, self->bindplan[arg-1]);
+          if(planned<0)
+            return -1;
+          if(planned==0)
+            continue;
+          self->bindplan[arg-1]=(unsigned char)bindplan_kind(obj);
+        }
       if(APSWCursor_dobinding(self, arg, obj))
         {
           assert(PyErr_Occurred());
@@ -682,7 +1567,6 @@ APSWCursor_dobindings(APSWCursor *self)
     }
 
   self->bindingsoffset+=nargs;
-  assert(res==0);
   return 0;
 }
 
@@ -764,17 +1648,94 @@ APSWCursor_dorowtrace(APSWCursor *self, PyObject *retval)
   return PyObject_CallFunction(rowtrace, "OO", self, retval);
 }
 
+/* QUERY TIMEOUTS
+
+   Each execution gets a deadline which the connection's progress
+   handler compares against the clock while the statement is being
+   stepped, interrupting it once passed.  No Python code is run. */
+
+/* Sets the deadline for an execution starting now.  timeout is in
+   seconds with negative meaning the connection default. */
+static void
+querytimeout_start(APSWCursor *cursor, double timeout)
+{
+  Connection *connection=cursor->connection;
+
+  if(timeout<0)
+    timeout=connection->querytimeout;
+  if(!timeout)
+    {
+      cursor->deadline=0;
+      return;
+    }
+  if(!connection->deadlines)
+    {
+      connection->deadlines=1;
+      Connection_installprogress(connection);
+    }
+  cursor->deadline=apsw_monotonic_us()+(sqlite3_int64)(timeout*1000000);
+  if(!cursor->deadline)
+    cursor->deadline=1;
+}
+
+/* If res is from interrupting a statement that is past its deadline,
+   or that of an outer statement, then the InterruptError is replaced
+   with QueryTimeoutError */
+static void
+querytimeout_check(APSWCursor *cursor, int res)
+{
+  int i;
+  sqlite3_int64 deadline=cursor->deadline, outer=cursor->connection->deadline;
+
+  if(outer && (!deadline || outer<deadline))
+    deadline=outer;
+  if((res&0xff)!=SQLITE_INTERRUPT || !deadline || apsw_monotonic_us()<deadline)
+    return;
+
+  for(i=0;exc_descriptors[i].code!=SQLITE_INTERRUPT;i++);
+  if(PyErr_Occurred() && !PyErr_ExceptionMatches(exc_descriptors[i].cls))
+    return;
+
+  PyErr_Clear();
+  PyErr_Format(ExcQueryTimeout, "QueryTimeoutError: The query did not complete within its timeout");
+}
+
 /* Returns a borrowed reference to self if all is ok, else NULL on error */
 static PyObject *
 APSWCursor_step(APSWCursor *self)
 {
   int res;
   int savedbindingsoffset=0; /* initialised to stop stupid compiler from whining */
+  sqlite3_int64 saveddeadline;
 
   for(;;)
     {
+      int reused=0;
+
       assert(!PyErr_Occurred());
-      PYSQLITE_CUR_CALL(res=(self->statement->vdbestatement)?(sqlite3_step(self->statement->vdbestatement)):(SQLITE_DONE));
+      /* the prefetch worker takes over from the second row.  If it
+         can't be started then we carry on without it. */
+      if(self->prefetcher && !self->prefetcher->running && self->statement->vdbestatement
+         && self->prefetcher->primed==self->statement->vdbestatement
+         && prefetch_start(self->prefetcher, self->statement->vdbestatement))
+        {
+          prefetch_free(self->prefetcher);
+          self->prefetcher=NULL;
+        }
+      if(self->prefetcher && self->prefetcher->running)
+        {
+          res=prefetch_next(self->prefetcher);
+          if(res==SQLITE_NOMEM && self->prefetcher->nomem)
+            PyErr_NoMemory();
+        }
+      else
+        {
+          PYSQLITE_CUR_CALL(DEADLINE_ENTER(&self->connection->deadline, self->deadline);
+                            res=(self->statement->vdbestatement)?(sqlite3_step(self->statement->vdbestatement)):(SQLITE_DONE);
+                            DEADLINE_LEAVE(&self->connection->deadline));
+          if(self->prefetcher && res==SQLITE_ROW)
+            self->prefetcher->primed=self->statement->vdbestatement;
+        }
 
       switch(res&0xff)
         {
@@ -808,6 +1769,7 @@ APSWCursor_step(APSWCursor *self)
               self->status=C_BEGIN;
               continue;
             }
+          querytimeout_check(self, res);
           return NULL;
         }
       assert(res==SQLITE_DONE);
@@ -842,11 +1804,33 @@ APSWCursor_step(APSWCursor *self)
               return (PyObject*)self;
             }
 
-          /* we need to clear just completed and restart original executemany statement */
-          INUSE_CALL(statementcache_finalize(self->connection->stmtcache, self->statement, 0));
-          self->statement=NULL;
-          /* don't need bindings from last round if emiter.next() */
+          if(self->statement->vdbestatement && self->statement->utf8==self->emoriginalquery)
+            {
+              /* A single statement is reset and bound again rather than
+                 going back through the statement cache.  Bindings are
+                 cleared for dicts since missing keys must be null. */
+              PYSQLITE_CUR_CALL(res=sqlite3_reset(self->statement->vdbestatement));
+              if(res==SQLITE_OK && PyDict_Check(next))
+                PYSQLITE_CUR_CALL(res=sqlite3_clear_bindings(self->statement->vdbestatement));
+              if(res!=SQLITE_OK)
+                {
+                  Py_DECREF(next);
+                  SET_EXC(res, self->connection->db);
+                  return NULL;
+                }
+              reused=1;
+            }
+          else
+            {
+              /* we need to clear just completed and restart original executemany statement */
+              INUSE_CALL(statementcache_finalize(self->connection->stmtcache, self->statement, 0));
+              self->statement=NULL;
+            }
+          /* don't need bindings from last round if emiter.next().  All
+             parameters are bound again before the next step so the
+             statement won't use pinned memory. */
           Py_CLEAR(self->bindings);
+          Py_CLEAR(self->pins);
           self->bindingsoffset=0;
           /* verify type of next before putting in bindings */
           if(PyDict_Check(next))
@@ -863,7 +1847,9 @@ APSWCursor_step(APSWCursor *self)
         }
 
       /* finalise and go again */
-      if(!self->statement)
+      if(reused)
+        res=SQLITE_OK;
+      else if(!self->statement)
         {
           /* we are going again in executemany mode */
           assert(self->emiter);
@@ -916,7 +1902,7 @@ APSWCursor_step(APSWCursor *self)
   return NULL;
 }
 
-/** .. method:: execute(statements[, bindings]) -> iterator
+/** .. method:: execute(statements[, bindings, prefetch=0, timeout=None]) -> iterator
 
     Executes the statements using the supplied bindings.  Execution
     returns when the first row is available or all statements have
@@ -926,6 +1912,13 @@ APSWCursor_step(APSWCursor *self)
       from books`` or ``begin; insert into books ...; select
       last_insert_rowid(); end``.
     :param bindings: If supplied should either be a sequence or a dictionary.  Each item must be one of the :ref:`supported types <types>`
+    :param prefetch: If non-zero then a background thread steps through
+      the results of each statement, keeping up to this many rows ready
+      while you process earlier ones.  See below.
+    :param timeout: Seconds the statements may take before failing with
+      :exc:`QueryTimeoutError`.  None uses the connection's
+      :meth:`default <Connection.setquerytimeout>` and zero means no
+      limit.  See :ref:`querytimeouts`.
 
     If you use numbered bindings in the query then supply a sequence.
     Any sequence will work including lists and iterators.  For
@@ -958,9 +1951,30 @@ APSWCursor_step(APSWCursor *self)
        for row in cursor.execute("select * from books"):
           print row
 
+    Normally SQLite finding the next row and your code processing the
+    current row happen one after the other.  With *prefetch* a worker
+    thread that doesn't need the GIL is started once a statement
+    returns its first row.  It copies each following row's values
+    while your code is busy, which overlaps the work of SQLite with
+    creating Python objects on multiple core machines.  This is
+    worthwhile for queries returning many rows.  Some things to be
+    aware of:
+
+    * The worker is stopped when the cursor executes something else,
+      is closed, or the statement completes.  SQLite may have done
+      work for rows you never consume.
+    * :meth:`Functions <Connection.createscalarfunction>`, :meth:`busy
+      handlers <Connection.setbusyhandler>` and similar callbacks may be
+      run in the worker thread.  Exceptions they raise are raised by
+      the cursor as usual, but only once the worker stops, so if the
+      statement carries on returning rows you may get some of those
+      first.
+    * :meth:`~Cursor.fetchinto` can't be used while prefetching.
+
     :raises TypeError: The bindings supplied were neither a dict nor a sequence
     :raises BindingsError: You supplied too many or too few bindings for the statements
     :raises IncompleteExecutionError: There are remaining unexecuted queries from your last execute
+    :raises QueryTimeoutError: The *timeout* passed
 
     -* sqlite3_prepare_v2 sqlite3_step sqlite3_bind_int64 sqlite3_bind_null sqlite3_bind_text sqlite3_bind_double sqlite3_bind_blob sqlite3_bind_zeroblob
 
@@ -971,10 +1985,12 @@ APSWCursor_step(APSWCursor *self)
 
 */
 static PyObject *
-APSWCursor_execute(APSWCursor *self, PyObject *args)
+APSWCursor_execute(APSWCursor *self, PyObject *args, PyObject *kwds)
 {
   int res;
   int savedbindingsoffset=-1;
+  long prefetch=0;
+  double timeout=-1;
   PyObject *retval=NULL;
   PyObject *query;
 
@@ -992,7 +2008,37 @@ APSWCursor_execute(APSWCursor *self, PyObject *args)
   assert(PyTuple_Check(args));
 
   if(PyTuple_GET_SIZE(args)<1 || PyTuple_GET_SIZE(args)>2)
-    return PyErr_Format(PyExc_TypeError, "Incorrect number of arguments.  execute(statements [,bindings])");
+    return PyErr_Format(PyExc_TypeError, "Incorrect number of arguments.  execute(statements [,bindings, prefetch=0, timeout=None])");
+
+  if(kwds && PyDict_Size(kwds))
+    {
+      Py_ssize_t nkwds=0;
+      PyObject *item=PyDict_GetItemString(kwds, "prefetch");
+      if(item)
+        {
+          nkwds++;
+          prefetch=PyIntLong_AsLong(item);
+          if(PyErr_Occurred())
+            return NULL;
+          if(prefetch<0 || prefetch>65536)
+            return PyErr_Format(PyExc_ValueError, "prefetch must be between 0 and 65536");
+        }
+      item=PyDict_GetItemString(kwds, "timeout");
+      if(item)
+        {
+          nkwds++;
+          if(item!=Py_None)
+            {
+              timeout=PyFloat_AsDouble(item);
+              if(PyErr_Occurred())
+                return NULL;
+              if(timeout<0 || timeout>1e9)
+                return PyErr_Format(PyExc_ValueError, "timeout must be between zero and one billion");
+            }
+        }
+      if(nkwds!=PyDict_Size(kwds))
+        return PyErr_Format(PyExc_TypeError, "The only keyword arguments to execute are prefetch and timeout");
+    }
 
   query=PyTuple_GET_ITEM(args, 0);
   if (PyTuple_GET_SIZE(args)==2)
@@ -1011,6 +2057,17 @@ APSWCursor_execute(APSWCursor *self, PyObject *args)
         }
     }
 
+  querytimeout_start(self, timeout);
+
+  if(prefetch)
+    {
+      self->prefetcher=prefetch_new(self->connection->db, (int)prefetch);
+      if(!self->prefetcher)
+        return NULL;
+      self->prefetcher->deadline=self->deadline;
+      self->prefetcher->deadlinep=&self->connection->deadline;
+    }
+
   assert(!self->statement);
   assert(!PyErr_Occurred());
   INUSE_CALL(self->statement=statementcache_prepare(self->connection->stmtcache, query, !!self->bindings));
@@ -1073,6 +2130,12 @@ APSWCursor_execute(APSWCursor *self, PyObject *args)
   The return is the cursor itself which acts as an iterator.  Your
   statements can return data.  See :meth:`~Cursor.execute` for more
   information.
+
+  If *statements* is a single statement then it is reset and reused
+  for each item in *sequenceofbindings*, and the type of value bound
+  at each position is remembered so following items of the same types
+  are bound with less work.  This makes bulk inserts considerably
+  faster.
 */
 
 static PyObject *
@@ -1127,6 +2190,8 @@ APSWCursor_executemany(APSWCursor *self, PyObject *args)
           return NULL;
     }
 
+  querytimeout_start(self, -1);
+
   assert(!self->statement);
   assert(!PyErr_Occurred());
   assert(!self->statement);
@@ -1215,13 +2280,152 @@ APSWCursor_close(APSWCursor *self, PyObject *args)
   Py_RETURN_NONE;
 }
 
+/* Returns a new tuple (or named row) of the current row.  The tuple
+   is allocated before taking the database mutex, after which only
+   non-container objects are created so the garbage collector can't
+   run arbitrary code while we hold the mutex.  The whole row is then
+   converted with one release/reacquire of the GIL instead of one per
+   SQLite call.  Rows from the prefetch worker have already been
+   copied out so they don't need the mutex. */
 static PyObject *
-APSWCursor_next(APSWCursor *self)
+APSWCursor_getrow(APSWCursor *self)
 {
   PyObject *retval;
   PyObject *item;
-  int numcols=-1;
-  int i;
+  APSWStatement *statement=self->statement;
+  struct prefetchslot *slot=PREFETCHSLOT;
+  int numcols, i, namedrows=NAMEDROWS, reprepares=0;
+
+  numcols=slot?self->prefetcher->ncols:sqlite3_data_count(statement->vdbestatement);
+
+  if(namedrows)
+    {
+      if(statement->rowtype && statement->rowtypencols!=numcols)
+        Py_CLEAR(statement->rowtype);
+      if(!statement->rowtype)
+        {
+          INUSE_CALL(statement->rowtype=statementcache_rowtype(statement));
+          if(!statement->rowtype) return NULL;
+        }
+      retval=PyStructSequence_New((PyTypeObject*)statement->rowtype);
+    }
+  else
+    retval=PyTuple_New(numcols);
+  if(!retval) return NULL;
+
+  if(slot)
+    {
+      for(i=0;i<numcols;i++)
+        {
+          item=rowcopy_convert(&slot->columns[i], slot->data);
+          if(!item) break;
+          PyTuple_SET_ITEM(retval, i, item);
+        }
+      /* reprepares only happen before the first row which the cursor
+         stepped itself */
+      reprepares=statement->rowtypereprepares;
+    }
+  else
+    {
+      PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+      for(i=0;i<numcols;i++)
+        {
+          INUSE_CALL(item=convert_column_to_pyobject(statement->vdbestatement, i));
+          if(!item) break;
+          PyTuple_SET_ITEM(retval, i, item);
+        }
+      if(namedrows)
+        PYSQLITE_LOCKED_CALL(reprepares=sqlite3_stmt_status(statement->vdbestatement, SQLITE_STMTSTATUS_REPREPARE, 0));
+      PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+    }
+
+  if(i!=numcols)
+    {
+      Py_DECREF(retval);
+      return NULL;
+    }
+
+  if(namedrows && reprepares!=statement->rowtypereprepares)
+    {
+      /* SQLite reprepared the statement (eg after a schema change) so
+         the column names may be different.  Make a new type and move
+         the values over. */
+      PyObject *newrow;
+
+      Py_CLEAR(statement->rowtype);
+      INUSE_CALL(statement->rowtype=statementcache_rowtype(statement));
+      newrow=statement->rowtype?PyStructSequence_New((PyTypeObject*)statement->rowtype):NULL;
+      if(!newrow)
+        {
+          Py_DECREF(retval);
+          return NULL;
+        }
+      for(i=0;i<numcols;i++)
+        {
+          item=PyTuple_GET_ITEM(retval, i);
+          Py_INCREF(item);
+          PyTuple_SET_ITEM(newrow, i, item);
+        }
+      Py_DECREF(retval);
+      retval=newrow;
+    }
+  return retval;
+}
+
+/* Returns a new LazyRow of the current row.  Only the column types,
+   numbers and raw bytes are copied while holding the database mutex.
+   Python objects are made when a column is accessed.  Rows from the
+   prefetch worker take over the slot's copy of the bytes. */
+static PyObject *
+APSWCursor_getlazyrow(APSWCursor *self)
+{
+  APSWLazyRow *row;
+  sqlite3_stmt *stmt=self->statement->vdbestatement;
+  struct prefetchslot *slot=PREFETCHSLOT;
+  size_t datasize=0;
+  int numcols, res;
+
+  numcols=slot?self->prefetcher->ncols:sqlite3_data_count(stmt);
+
+  row=PyObject_New(APSWLazyRow, &APSWLazyRowType);
+  if(!row) return NULL;
+  row->ncols=numcols;
+  row->data=NULL;
+  row->columns=PyMem_Malloc(sizeof(struct lazycolumn)*numcols + sizeof(PyObject*)*numcols + 1);
+  if(!row->columns)
+    {
+      row->values=NULL;
+      Py_DECREF(row);
+      return PyErr_NoMemory();
+    }
+  row->values=(PyObject**)(row->columns+numcols);
+  memset(row->values, 0, sizeof(PyObject*)*numcols);
+
+  if(slot)
+    {
+      memcpy(row->columns, slot->columns, sizeof(struct lazycolumn)*numcols);
+      row->data=slot->data;
+      slot->data=NULL;
+      slot->datasize=0;
+      return (PyObject*)row;
+    }
+
+  PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+  res=rowcopy_capture(stmt, numcols, row->columns, &row->data, &datasize);
+  PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+
+  if(res!=SQLITE_OK)
+    {
+      Py_DECREF(row);
+      return PyErr_NoMemory();
+    }
+  return (PyObject*)row;
+}
+
+static PyObject *
+APSWCursor_next(APSWCursor *self)
+{
+  PyObject *retval;
 
   CHECK_USE(NULL);
   CHECK_CURSOR_CLOSED(NULL);
@@ -1241,16 +2445,12 @@ APSWCursor_next(APSWCursor *self)
   self->status=C_BEGIN;
 
   /* return the row of data */
-  numcols=sqlite3_data_count(self->statement->vdbestatement);
-  retval=PyTuple_New(numcols);
-  if(!retval) goto error;
+  if(LAZYROWS)
+    retval=APSWCursor_getlazyrow(self);
+  else
+    retval=APSWCursor_getrow(self);
+  if(!retval) return NULL;
 
-  for(i=0;i<numcols;i++)
-    {
-      INUSE_CALL(item=convert_column_to_pyobject(self->statement->vdbestatement, i));
-      if(!item) goto error;
-      PyTuple_SET_ITEM(retval, i, item);
-    }
   if(ROWTRACE)
     {
       PyObject *r2=APSWCursor_dorowtrace(self, retval);
@@ -1265,9 +2465,6 @@ APSWCursor_next(APSWCursor *self)
       return r2;
     }
   return retval;
- error:
-  Py_XDECREF(retval);
-  return NULL;
 }
 
 static PyObject *
@@ -1350,6 +2547,140 @@ APSWCursor_setrowtrace(APSWCursor *self, PyObject *func)
   Py_RETURN_NONE;
 }
 
+/** .. method:: setnamedrows(enable)
+
+  When *enable* is True, rows are returned as struct sequences (like
+  :func:`collections.namedtuple`) so that columns can be accessed by
+  name as attributes as well as by index::
+
+    cursor.setnamedrows(True)
+    for row in cursor.execute("select id, title from books"):
+       print row.id, row.title, row[0]
+
+  The row type is made from the column names once per prepared
+  statement and reused, so this is almost as fast as plain tuples and
+  doesn't need a :ref:`row tracer <rowtracer>`.  The names are also
+  available as the ``_fields`` attribute of the row.  Rows are still
+  tuples and compare equal to tuples with the same values.  Columns
+  whose names aren't valid Python identifiers can be accessed with
+  :func:`getattr`.  Use the ``as`` keyword in your SQL to give
+  expressions convenient names.  Duplicate column names, and names
+  already used by the row type such as ``n_fields`` or ``_fields``,
+  have ``_1``, ``_2`` etc appended so every column has a name.
+
+  If *enable* is :const:`None` then the setting of the
+  :meth:`connection <Connection.setnamedrows>` is used, which is the
+  default.
+
+  Named rows require Python 3.3 or later.
+
+  .. seealso::
+
+    * :meth:`Connection.setnamedrows`
+*/
+
+static PyObject *
+APSWCursor_setnamedrows(APSWCursor *self, PyObject *enable)
+{
+  int res=-1;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(enable!=Py_None)
+    {
+      res=PyObject_IsTrue(enable);
+      if(res==-1)
+        return NULL;
+#if PY_VERSION_HEX < 0x03030000
+      if(res)
+        return PyErr_Format(PyExc_NotImplementedError, "Named rows need Python 3.3 or later");
+#endif
+    }
+
+  self->namedrows=res;
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: getnamedrows() -> bool or None
+
+  Returns the setting from :meth:`~Cursor.setnamedrows`, with
+  :const:`None` meaning the :meth:`connection's <Connection.getnamedrows>`
+  setting is used.
+*/
+static PyObject *
+APSWCursor_getnamedrows(APSWCursor *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(self->namedrows<0)
+    Py_RETURN_NONE;
+  if(self->namedrows)
+    Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
+/** .. method:: setlazyrows(enable)
+
+  When *enable* is True, rows are returned as :class:`LazyRow`
+  objects.  Only the raw values are copied out of SQLite for each row,
+  and the Python object for a column is only created when that column
+  is accessed.  This saves considerable time when a query returns
+  many text or blob columns but you only look at a few of them.  Rows
+  where you use every column will be a little slower than the default
+  tuples.
+
+  If *enable* is :const:`None` then the setting of the
+  :meth:`connection <Connection.setlazyrows>` is used, which is the
+  default.  Lazy rows take precedence over :meth:`named rows
+  <Cursor.setnamedrows>`.
+
+  .. seealso::
+
+    * :meth:`Connection.setlazyrows`
+*/
+
+static PyObject *
+APSWCursor_setlazyrows(APSWCursor *self, PyObject *enable)
+{
+  int res=-1;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(enable!=Py_None)
+    {
+      res=PyObject_IsTrue(enable);
+      if(res==-1)
+        return NULL;
+    }
+
+  self->lazyrows=res;
+
+  Py_RETURN_NONE;
+}
+
+/** .. method:: getlazyrows() -> bool or None
+
+  Returns the setting from :meth:`~Cursor.setlazyrows`, with
+  :const:`None` meaning the :meth:`connection's <Connection.getlazyrows>`
+  setting is used.
+*/
+static PyObject *
+APSWCursor_getlazyrows(APSWCursor *self)
+{
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(self->lazyrows<0)
+    Py_RETURN_NONE;
+  if(self->lazyrows)
+    Py_RETURN_TRUE;
+  Py_RETURN_FALSE;
+}
+
 /** .. method:: getexectrace() -> callable or None
 
   Returns the currently installed (via :meth:`~Cursor.setexectrace`)
@@ -1427,67 +2758,1335 @@ APSWCursor_fetchall(APSWCursor *self)
   return PySequence_List((PyObject*)self);
 }
 
-/** .. method:: fetchone() -> row or None
+/** .. method:: fetchmany(size) -> list
 
-  Returns the next row of data or None if there are no more rows.
-*/
+  Returns up to *size* of the remaining result rows as a list.  An
+  empty list is returned when there are no more rows.  The rows are
+  fetched in a single call so this is quicker than calling
+  :meth:`~Cursor.next` *size* times from Python, which is useful for
+  processing a large result set in chunks::
+
+    cursor.execute("select * from bigtable")
+    while True:
+       rows=cursor.fetchmany(10000)
+       if not rows:
+          break
+       process(rows)
 
+  A :ref:`row tracer <rowtracer>` is called for each row as usual, and
+  rows it skips do not count towards *size*.
+
+  :param size: Maximum number of rows to return.  It must be at least one.
+*/
 static PyObject *
-APSWCursor_fetchone(APSWCursor *self)
+APSWCursor_fetchmany(APSWCursor *self, PyObject *args, PyObject *kwds)
 {
-    PyObject *res;
+  static char *kwlist[]={"size", NULL};
+  Py_ssize_t size, i;
+  PyObject *result=NULL, *row=NULL;
 
-    CHECK_USE(NULL);
-    CHECK_CURSOR_CLOSED(NULL);
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
 
-    res=APSWCursor_next(self);
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "n:fetchmany(size)", kwlist, &size))
+    return NULL;
 
-    if(res==NULL && !PyErr_Occurred())
-        Py_RETURN_NONE;
+  if(size<1)
+    return PyErr_Format(PyExc_ValueError, "size must be at least one");
 
-    return res;
-}
+  result=PyList_New(0);
+  if(!result)
+    return NULL;
 
+  for(i=0;i<size;i++)
+    {
+      row=APSWCursor_next(self);
+      if(!row)
+        break;
+      if(PyList_Append(result, row))
+        goto error;
+      Py_DECREF(row);
+    }
 
+  if(PyErr_Occurred())
+    goto error;
 
-static PyMethodDef APSWCursor_methods[] = {
-  {"execute", (PyCFunction)APSWCursor_execute, METH_VARARGS,
-   "Executes one or more statements" },
-  {"executemany", (PyCFunction)APSWCursor_executemany, METH_VARARGS,
-   "Repeatedly executes statements on sequence" },
-  {"setexectrace", (PyCFunction)APSWCursor_setexectrace, METH_O,
-   "Installs a function called for every statement executed"},
-  {"setrowtrace", (PyCFunction)APSWCursor_setrowtrace, METH_O,
-   "Installs a function called for every row returned"},
-  {"getexectrace", (PyCFunction)APSWCursor_getexectrace, METH_NOARGS,
-   "Returns the current exec tracer function"},
-  {"getrowtrace", (PyCFunction)APSWCursor_getrowtrace, METH_NOARGS,
-   "Returns the current row tracer function"},
-  {"getconnection", (PyCFunction)APSWCursor_getconnection, METH_NOARGS,
-   "Returns the connection object for this cursor"},
-  {"getdescription", (PyCFunction)APSWCursor_getdescription, METH_NOARGS,
-   "Returns the description for the current row"},
-  {"close", (PyCFunction)APSWCursor_close, METH_VARARGS,
-   "Closes the cursor" },
-  {"fetchall", (PyCFunction)APSWCursor_fetchall, METH_NOARGS,
-   "Fetches all result rows" },
-  {"fetchone", (PyCFunction)APSWCursor_fetchone, METH_NOARGS,
-   "Fetches next result row" },
+  return result;
 
-  {0, 0, 0, 0}  /* Sentinel */
-};
+ error:
+  Py_XDECREF(row);
+  Py_DECREF(result);
+  return NULL;
+}
 
+/* what is written to a fetchinto buffer */
+enum { FI_SKIP, FI_INT64, FI_DOUBLE };
 
-static PyGetSetDef APSWCursor_getset[] = {
-  {"description", (getter)APSWCursor_getdescription_dbapi, NULL,  "Subset of DB-API description attribute", NULL},
-  {NULL, NULL, NULL, NULL, NULL}
-};
+typedef struct
+{
+  int kind;                        /* FI_ value */
+  Py_buffer values;                /* only valid if kind is not FI_SKIP */
+  int hasnulls;
+  Py_buffer nulls;                 /* only valid if hasnulls */
+} fetchinto_column;
+
+/* Works out what kind of values a buffer can hold from its struct
+   module format.  Only native sizes are accepted. */
+static int
+fetchinto_buffer_kind(Py_buffer *view)
+{
+  const char *format=view->format?view->format:"B";
 
-static PyTypeObject APSWCursorType = {
-    APSW_PYTYPE_INIT
-    "apsw.Cursor",             /*tp_name*/
-    sizeof(APSWCursor),            /*tp_basicsize*/
-    0,                         /*tp_itemsize*/
+  if(*format=='@' || *format=='=')
+    format++;
+  if(format[0] && !format[1] && view->itemsize==8)
+    switch(format[0])
+      {
+      case 'q':
+      case 'l':
+        return FI_INT64;
+      case 'd':
+        return FI_DOUBLE;
+      }
+  return FI_SKIP;
+}
+
+/** .. method:: fetchinto(buffers[, nulls]) -> int
+
+  Writes the remaining result rows directly into typed buffers, one
+  buffer per result column, without creating a Python object for each
+  value.  This is useful for reading large numbers of numeric values
+  into :mod:`array` objects, or anything else supporting the buffer
+  protocol such as numpy arrays::
+
+    import array
+    ids=array.array('q', [0]*10000)
+    prices=array.array('d', [0]*10000)
+    nulls=bytearray(10000)
+
+    cursor.execute("select id, price from items")
+    while True:
+       n=cursor.fetchinto((ids, prices), (None, nulls))
+       if not n:
+          break
+       process(ids[:n], prices[:n], nulls[:n])
+
+  :param buffers: A sequence with one member per result column.  Each
+    member must be a writable contiguous buffer of 64 bit integers
+    (format ``q``) or doubles (format ``d``), or :const:`None` to
+    ignore that column.  A :class:`bytearray` can be used via
+    ``memoryview(ba).cast('q')``.
+  :param nulls: If supplied, a sequence with one member per result
+    column.  Each member is a writable buffer of bytes that is set to
+    1 when the value is null and 0 otherwise, or :const:`None`.  The
+    value buffer gets zero for null values.
+
+  :returns: The number of rows written which is at most the length of
+    the shortest buffer.  Zero is returned when there are no more rows.
+
+  Integer values can be written into a double buffer, but float
+  values can't be written to an integer buffer.  Text and blob values
+  can't be written to either.  Those and null values in a column
+  without a *nulls* buffer cause :exc:`TypeError`.  That row and any
+  rows already written by the same call are consumed.  :ref:`Row
+  tracers <rowtracer>` are not called.
+*/
+static PyObject *
+APSWCursor_fetchinto(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"buffers", "nulls", NULL};
+  PyObject *buffers=NULL, *nulls=NULL, *fastbuffers=NULL, *fastnulls=NULL;
+  fetchinto_column *cols=NULL;
+  Py_ssize_t ncols=0, i, capacity=PY_SSIZE_T_MAX, nrows=0;
+  int badcol=-1, badtype=SQLITE_NULL;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|O:fetchinto(buffers, nulls=None)", kwlist, &buffers, &nulls))
+    return NULL;
+
+  if(self->prefetcher)
+    return PyErr_Format(PyExc_ValueError, "fetchinto can't be used while the cursor is prefetching");
+
+  fastbuffers=PySequence_Fast(buffers, "buffers must be a sequence");
+  if(!fastbuffers)
+    goto finally;
+  ncols=PySequence_Fast_GET_SIZE(fastbuffers);
+
+  if(nulls && nulls!=Py_None)
+    {
+      fastnulls=PySequence_Fast(nulls, "nulls must be a sequence");
+      if(!fastnulls)
+        goto finally;
+      if(PySequence_Fast_GET_SIZE(fastnulls)!=ncols)
+        {
+          PyErr_Format(PyExc_ValueError, "There are %d buffers but %d nulls", (int)ncols, (int)PySequence_Fast_GET_SIZE(fastnulls));
+          goto finally;
+        }
+    }
+
+  cols=PyMem_Malloc(sizeof(fetchinto_column)*(ncols?ncols:1));
+  if(!cols)
+    {
+      PyErr_NoMemory();
+      goto finally;
+    }
+  memset(cols, 0, sizeof(fetchinto_column)*(ncols?ncols:1));
+
+  for(i=0;i<ncols;i++)
+    {
+      PyObject *item=PySequence_Fast_GET_ITEM(fastbuffers, i);
+
+      if(item!=Py_None)
+        {
+          if(PyObject_GetBuffer(item, &cols[i].values, PyBUF_CONTIG|PyBUF_FORMAT))
+            goto finally;
+          cols[i].kind=fetchinto_buffer_kind(&cols[i].values);
+          if(cols[i].kind==FI_SKIP)
+            {
+              PyBuffer_Release(&cols[i].values);
+              PyErr_Format(PyExc_TypeError, "Buffer for column %d must have format 'q' (64 bit integer) or 'd' (double)", (int)i);
+              goto finally;
+            }
+          if(cols[i].values.len/8<capacity)
+            capacity=cols[i].values.len/8;
+        }
+
+      item=fastnulls?PySequence_Fast_GET_ITEM(fastnulls, i):Py_None;
+      if(item!=Py_None)
+        {
+          if(PyObject_GetBuffer(item, &cols[i].nulls, PyBUF_CONTIG))
+            goto finally;
+          cols[i].hasnulls=1;
+          if(cols[i].nulls.itemsize!=1)
+            {
+              PyErr_Format(PyExc_TypeError, "Nulls for column %d must be a buffer of bytes", (int)i);
+              goto finally;
+            }
+          if(cols[i].nulls.len<capacity)
+            capacity=cols[i].nulls.len;
+        }
+    }
+
+  if(capacity==PY_SSIZE_T_MAX)
+    {
+      PyErr_Format(PyExc_ValueError, "You must supply at least one buffer");
+      goto finally;
+    }
+
+  while(nrows<capacity)
+    {
+      sqlite3_stmt *stmt;
+
+      if(self->status==C_BEGIN)
+        if(!APSWCursor_step(self))
+          goto finally;
+      if(self->status==C_DONE)
+        break;
+
+      assert(self->status==C_ROW);
+      self->status=C_BEGIN;
+
+      stmt=self->statement->vdbestatement;
+      if(sqlite3_data_count(stmt)!=ncols)
+        {
+          PyErr_Format(PyExc_ValueError, "There are %d buffers but the statement returns %d columns", (int)ncols, sqlite3_data_count(stmt));
+          goto finally;
+        }
+
+      PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+      for(i=0;i<ncols;i++)
+        {
+          int coltype;
+
+          if(cols[i].kind==FI_SKIP && !cols[i].hasnulls)
+            continue;
+
+          PYSQLITE_LOCKED_CALL(coltype=sqlite3_column_type(stmt, (int)i));
+          if(cols[i].hasnulls)
+            ((unsigned char*)cols[i].nulls.buf)[nrows]=(coltype==SQLITE_NULL);
+
+          if(cols[i].kind==FI_SKIP)
+            continue;
+
+          if(coltype==SQLITE_NULL && cols[i].hasnulls)
+            {
+              if(cols[i].kind==FI_INT64)
+                ((sqlite3_int64*)cols[i].values.buf)[nrows]=0;
+              else
+                ((double*)cols[i].values.buf)[nrows]=0.0;
+            }
+          else if(cols[i].kind==FI_INT64 && coltype==SQLITE_INTEGER)
+            PYSQLITE_LOCKED_CALL(((sqlite3_int64*)cols[i].values.buf)[nrows]=sqlite3_column_int64(stmt, (int)i));
+          else if(cols[i].kind==FI_DOUBLE && (coltype==SQLITE_INTEGER || coltype==SQLITE_FLOAT))
+            PYSQLITE_LOCKED_CALL(((double*)cols[i].values.buf)[nrows]=sqlite3_column_double(stmt, (int)i));
+          else
+            {
+              badcol=(int)i;
+              badtype=coltype;
+              break;
+            }
+        }
+      PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+
+      if(badcol>=0)
+        {
+          static const char *typenames[]={"", "integer", "float", "text", "blob", "null"};
+          PyErr_Format(PyExc_TypeError, "Can't write %s value from column %d into %s buffer",
+                       (badtype>=SQLITE_INTEGER && badtype<=SQLITE_NULL)?typenames[badtype]:"unknown", badcol,
+                       (cols[badcol].kind==FI_INT64)?"an integer":"a double");
+          goto finally;
+        }
+      nrows++;
+    }
+
+ finally:
+  if(cols)
+    {
+      for(i=0;i<ncols;i++)
+        {
+          if(cols[i].kind!=FI_SKIP)
+            PyBuffer_Release(&cols[i].values);
+          if(cols[i].hasnulls)
+            PyBuffer_Release(&cols[i].nulls);
+        }
+      PyMem_Free(cols);
+    }
+  Py_XDECREF(fastbuffers);
+  Py_XDECREF(fastnulls);
+
+  if(PyErr_Occurred())
+    return NULL;
+  return PyLong_FromSsize_t(nrows);
+}
+
+/* A column for executemany_columns - either a buffer of numbers or a
+   sequence of objects */
+typedef struct
+{
+  int kind;                        /* FI_INT64 or FI_DOUBLE for buffers, FI_SKIP for sequences */
+  Py_buffer values;                /* only valid for buffers */
+  PyObject *sequence;              /* PySequence_Fast, only valid for sequences */
+  int hasnulls;
+  Py_buffer nulls;                 /* only valid if hasnulls */
+} executemany_column;
+
+/** .. method:: executemany_columns(statement, columns[, nulls]) -> int
+
+  Executes *statement* once per row, where the rows are made by
+  zipping together *columns*.  This is like :meth:`executemany` but
+  without needing a tuple for each row, and numeric columns are bound
+  directly from buffers such as :mod:`array` objects without creating
+  a Python object for each value::
+
+    import array
+    ids=array.array('q', range(1000000))
+    prices=array.array('d', (i*0.25 for i in range(1000000)))
+    names=["item %d" % i for i in range(1000000)]
+
+    cursor.executemany_columns("insert into items values(?,?,?)", (ids, prices, names))
+
+  :param statement: A single SQL statement with one positional
+    parameter per column.  Any rows the statement returns are
+    discarded.
+  :param columns: A sequence with one member per parameter, each with
+    the same number of rows.  A member is either a contiguous buffer
+    of 64 bit integers (format ``q``) or doubles (format ``d``), or a
+    sequence such as a :class:`list` whose members can be any of the
+    :ref:`supported types <types>`.
+  :param nulls: If supplied, a sequence with one member per column.
+    Each member is :const:`None` or a buffer of bytes, with a
+    non-zero byte meaning that row's value is null.
+
+  :returns: The number of rows executed.
+
+  If there is an error then the rows before it have been executed,
+  so you may want to use a transaction.  The :meth:`exec tracer
+  <setexectrace>` is called for each row with the bindings as a
+  tuple, which does create a tuple per row.
+
+  .. seealso::
+
+     :meth:`fetchinto` which is the reverse.
+*/
+static PyObject *
+APSWCursor_executemany_columns(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"statement", "columns", "nulls", NULL};
+  PyObject *query=NULL, *columns=NULL, *nulls=NULL, *fastcolumns=NULL, *fastnulls=NULL;
+  executemany_column *cols=NULL;
+  unsigned char *plan=NULL;
+  Py_ssize_t ncols=0, i, nrows=-1, row=0;
+  int res, nargs;
+  sqlite3_int64 saveddeadline;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  res=resetcursor(self, /* force= */ 0);
+  if(res!=SQLITE_OK)
+    {
+      assert(PyErr_Occurred());
+      return NULL;
+    }
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "OO|O:executemany_columns(statement, columns, nulls=None)", kwlist, &query, &columns, &nulls))
+    return NULL;
+
+  querytimeout_start(self, -1);
+
+  fastcolumns=PySequence_Fast(columns, "columns must be a sequence");
+  if(!fastcolumns)
+    goto finally;
+  ncols=PySequence_Fast_GET_SIZE(fastcolumns);
+
+  if(nulls && nulls!=Py_None)
+    {
+      fastnulls=PySequence_Fast(nulls, "nulls must be a sequence");
+      if(!fastnulls)
+        goto finally;
+      if(PySequence_Fast_GET_SIZE(fastnulls)!=ncols)
+        {
+          PyErr_Format(PyExc_ValueError, "There are %d columns but %d nulls", (int)ncols, (int)PySequence_Fast_GET_SIZE(fastnulls));
+          goto finally;
+        }
+    }
+
+  cols=PyMem_Malloc(sizeof(executemany_column)*(ncols?ncols:1));
+  plan=PyMem_Malloc(ncols?ncols:1);
+  if(!cols || !plan)
+    {
+      PyErr_NoMemory();
+      goto finally;
+    }
+  memset(cols, 0, sizeof(executemany_column)*(ncols?ncols:1));
+  memset(plan, 0, ncols?ncols:1);
+
+  for(i=0;i<ncols;i++)
+    {
+      PyObject *item=PySequence_Fast_GET_ITEM(fastcolumns, i);
+      Py_ssize_t len;
+
+      cols[i].kind=FI_SKIP;
+      if(PyObject_CheckBuffer(item) && !PyUnicode_Check(item))
+        {
+          if(PyObject_GetBuffer(item, &cols[i].values, PyBUF_CONTIG_RO|PyBUF_FORMAT))
+            goto finally;
+          cols[i].kind=fetchinto_buffer_kind(&cols[i].values);
+          if(cols[i].kind==FI_SKIP)
+            {
+              PyBuffer_Release(&cols[i].values);
+              PyErr_Format(PyExc_TypeError, "Buffer for column %d must have format 'q' (64 bit integer) or 'd' (double)", (int)i);
+              goto finally;
+            }
+          len=cols[i].values.len/8;
+        }
+      else
+        {
+          cols[i].sequence=PySequence_Fast(item, "Each column must be a buffer or a sequence");
+          if(!cols[i].sequence)
+            goto finally;
+          len=PySequence_Fast_GET_SIZE(cols[i].sequence);
+        }
+      if(nrows<0)
+        nrows=len;
+      else if(len!=nrows)
+        {
+          PyErr_Format(PyExc_ValueError, "Column %d has %d rows but column 0 has %d", (int)i, (int)len, (int)nrows);
+          goto finally;
+        }
+
+      item=fastnulls?PySequence_Fast_GET_ITEM(fastnulls, i):Py_None;
+      if(item!=Py_None)
+        {
+          if(PyObject_GetBuffer(item, &cols[i].nulls, PyBUF_CONTIG_RO))
+            goto finally;
+          cols[i].hasnulls=1;
+          if(cols[i].nulls.itemsize!=1 || cols[i].nulls.len<nrows)
+            {
+              PyErr_Format(PyExc_ValueError, "Nulls for column %d must be a buffer of at least %d bytes", (int)i, (int)nrows);
+              goto finally;
+            }
+        }
+    }
+
+  INUSE_CALL(self->statement=statementcache_prepare(self->connection->stmtcache, query, 1));
+  if(!self->statement)
+    {
+      AddTraceBackHere(__FILE__, __LINE__, "APSWCursor_executemany_columns.sqlite3_prepare", "{s: O, s: O}",
+                       "Connection", self->connection,
+                       "statement", query);
+      goto finally;
+    }
+  if(self->statement->next)
+    {
+      PyErr_Format(PyExc_ValueError, "executemany_columns only supports a single statement");
+      goto finally;
+    }
+  nargs=sqlite3_bind_parameter_count(self->statement->vdbestatement);
+  if(nargs!=ncols)
+    {
+      PyErr_Format(ExcBindings, "Incorrect number of bindings supplied.  The current statement uses %d and there are %d columns",
+                   nargs, (int)ncols);
+      goto finally;
+    }
+
+  self->bindingsoffset=0;
+
+  for(row=0;row<nrows;row++)
+    {
+      sqlite3_stmt *stmt=self->statement->vdbestatement;
+
+      /* numeric columns are bound in one go */
+      res=SQLITE_OK;
+      PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+      if(row)
+        PYSQLITE_LOCKED_CALL(res=sqlite3_reset(stmt));
+      for(i=0; res==SQLITE_OK && i<ncols; i++)
+        {
+          if(cols[i].kind==FI_SKIP)
+            continue;
+          if(cols[i].hasnulls && ((const unsigned char*)cols[i].nulls.buf)[row])
+            PYSQLITE_LOCKED_CALL(res=sqlite3_bind_null(stmt, (int)i+1));
+          else if(cols[i].kind==FI_INT64)
+            PYSQLITE_LOCKED_CALL(res=sqlite3_bind_int64(stmt, (int)i+1, ((const sqlite3_int64*)cols[i].values.buf)[row]));
+          else
+            PYSQLITE_LOCKED_CALL(res=sqlite3_bind_double(stmt, (int)i+1, ((const double*)cols[i].values.buf)[row]));
+        }
+      PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+      if(res!=SQLITE_OK)
+        {
+          SET_EXC(res, self->connection->db);
+          goto finally;
+        }
+      /* every parameter is bound again below */
+      Py_CLEAR(self->pins);
+
+      for(i=0;i<ncols;i++)
+        {
+          PyObject *obj;
+          int planned;
+
+          if(cols[i].kind!=FI_SKIP)
+            continue;
+          obj=(cols[i].hasnulls && ((const unsigned char*)cols[i].nulls.buf)[row])?Py_None:PySequence_Fast_GET_ITEM(cols[i].sequence, row);
+          planned=APSWCursor_dobinding_planned(self, (int)i+1, obj, plan[i]);
+          if(planned<0)
+            goto finally;
+          if(planned==0)
+            continue;
+          plan[i]=(unsigned char)bindplan_kind(obj);
+          if(APSWCursor_dobinding(self, (int)i+1, obj))
+            goto finally;
+        }
+
+      if(EXECTRACE)
+        {
+          PyObject *bindings=PyTuple_New(ncols);
+          int traced;
+          if(!bindings)
+            goto finally;
+          for(i=0;i<ncols;i++)
+            {
+              PyObject *obj;
+              if(cols[i].hasnulls && ((const unsigned char*)cols[i].nulls.buf)[row])
+                {
+                  obj=Py_None;
+                  Py_INCREF(obj);
+                }
+              else if(cols[i].kind==FI_INT64)
+                obj=PyLong_FromLongLong(((const sqlite3_int64*)cols[i].values.buf)[row]);
+              else if(cols[i].kind==FI_DOUBLE)
+                obj=PyFloat_FromDouble(((const double*)cols[i].values.buf)[row]);
+              else
+                {
+                  obj=PySequence_Fast_GET_ITEM(cols[i].sequence, row);
+                  Py_INCREF(obj);
+                }
+              if(!obj)
+                {
+                  Py_DECREF(bindings);
+                  goto finally;
+                }
+              PyTuple_SET_ITEM(bindings, i, obj);
+            }
+          self->bindings=bindings;
+          self->bindingsoffset=ncols;
+          traced=APSWCursor_doexectrace(self, 0);
+          Py_CLEAR(self->bindings);
+          self->bindingsoffset=0;
+          if(traced)
+            goto finally;
+        }
+
+      do
+        {
+          PYSQLITE_CUR_CALL(DEADLINE_ENTER(&self->connection->deadline, self->deadline);
+                            res=sqlite3_step(stmt);
+                            DEADLINE_LEAVE(&self->connection->deadline));
+        } while(res==SQLITE_ROW && !PyErr_Occurred());
+
+      if(res!=SQLITE_DONE || PyErr_Occurred())
+        {
+          /* get the error code from finalizing as APSWCursor_step does */
+          if(PyErr_Occurred())
+            resetcursor(self, 1);
+          else if(resetcursor(self, 0)!=SQLITE_OK && !PyErr_Occurred())
+            SET_EXC(res, self->connection->db);
+          querytimeout_check(self, res);
+          goto finally;
+        }
+    }
+
+  resetcursor(self, 0);
+
+ finally:
+  if(cols)
+    {
+      for(i=0;i<ncols;i++)
+        {
+          if(cols[i].kind!=FI_SKIP)
+            PyBuffer_Release(&cols[i].values);
+          Py_XDECREF(cols[i].sequence);
+          if(cols[i].hasnulls)
+            PyBuffer_Release(&cols[i].nulls);
+        }
+      PyMem_Free(cols);
+    }
+  PyMem_Free(plan);
+  Py_XDECREF(fastcolumns);
+  Py_XDECREF(fastnulls);
+
+  if(PyErr_Occurred())
+    return NULL;
+  return PyLong_FromSsize_t(row);
+}
+
+/* EXPORT */
+
+/* Output formats for export */
+enum { EXPORT_CSV, EXPORT_TSV, EXPORT_JSONL };
+
+/* Output is written when the buffer gets to this size */
+#define EXPORT_FLUSH_SIZE (256*1024)
+
+/* Growable output buffer.  The functions adding to it don't run any
+   Python code so they can be used while holding the database mutex.
+   They return -1 on failure, usually without an exception set in
+   which case the caller should raise MemoryError. */
+typedef struct
+{
+  char *buf;
+  size_t len;
+  size_t alloc;
+} exportbuf;
+
+static int
+exportbuf_need(exportbuf *eb, size_t n)
+{
+  if(eb->len+n>eb->alloc)
+    {
+      size_t newalloc=eb->alloc?eb->alloc:EXPORT_FLUSH_SIZE+8192;
+      char *newbuf;
+
+      while(newalloc<eb->len+n)
+        newalloc*=2;
+      newbuf=PyMem_Realloc(eb->buf, newalloc);
+      if(!newbuf)
+        return -1;
+      eb->buf=newbuf;
+      eb->alloc=newalloc;
+    }
+  return 0;
+}
+
+static int
+exportbuf_add(exportbuf *eb, const char *s, size_t n)
+{
+  if(exportbuf_need(eb, n))
+    return -1;
+  memcpy(eb->buf+eb->len, s, n);
+  eb->len+=n;
+  return 0;
+}
+
+#define exportbuf_addstr(eb, s) exportbuf_add((eb), (s), strlen(s))
+
+/* The same rules as the Python csv module's excel and excel-tab
+   dialects used by the shell: the field is double quoted if it
+   contains the delimiter, a double quote or a line ending, with
+   double quotes doubled */
+static int
+export_csv_field(exportbuf *eb, char delimiter, const char *s, size_t n)
+{
+  size_t i, quotes=0;
+  int needquote=0;
+  char *p;
+
+  for(i=0;i<n;i++)
+    {
+      if(s[i]=='"')
+        {
+          quotes++;
+          needquote=1;
+        }
+      else if(s[i]==delimiter || s[i]=='\r' || s[i]=='\n')
+        needquote=1;
+    }
+  if(!needquote)
+    return exportbuf_add(eb, s, n);
+
+  if(exportbuf_need(eb, n+quotes+2))
+    return -1;
+  p=eb->buf+eb->len;
+  *p++='"';
+  for(i=0;i<n;i++)
+    {
+      if(s[i]=='"')
+        *p++='"';
+      *p++=s[i];
+    }
+  *p++='"';
+  eb->len=p-eb->buf;
+  return 0;
+}
+
+/* The same escapes as the shell's JSON output, plus \uXXXX for the
+   remaining control characters so the result is always valid JSON.
+   Other characters are output as is (UTF-8). */
+static int
+export_json_string(exportbuf *eb, const char *s, size_t n)
+{
+  static const char hex[]="0123456789abcdef";
+  size_t i;
+  char *p;
+
+  if(exportbuf_need(eb, n*6+2))
+    return -1;
+  p=eb->buf+eb->len;
+  *p++='"';
+  for(i=0;i<n;i++)
+    {
+      unsigned char c=(unsigned char)s[i];
+      switch(c)
+        {
+        case '\\': *p++='\\'; *p++='\\'; break;
+        case '"':  *p++='\\'; *p++='"'; break;
+        case '/':  *p++='\\'; *p++='/'; break;
+        case '\r': *p++='\\'; *p++='r'; break;
+        case '\n': *p++='\\'; *p++='n'; break;
+        case '\t': *p++='\\'; *p++='t'; break;
+        case '\b': *p++='\\'; *p++='b'; break;
+        case '\f': *p++='\\'; *p++='f'; break;
+        default:
+          if(c<0x20)
+            {
+              *p++='\\'; *p++='u'; *p++='0'; *p++='0';
+              *p++=hex[c>>4];
+              *p++=hex[c&15];
+            }
+          else
+            *p++=(char)c;
+        }
+    }
+  *p++='"';
+  eb->len=p-eb->buf;
+  return 0;
+}
+
+/* Blobs in JSON are base64 encoded strings like the shell, but
+   without line breaks */
+static int
+export_base64(exportbuf *eb, const unsigned char *s, size_t n)
+{
+  static const char b64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i;
+  char *p;
+
+  if(exportbuf_need(eb, (n+2)/3*4+2))
+    return -1;
+  p=eb->buf+eb->len;
+  *p++='"';
+  for(i=0;i+2<n;i+=3)
+    {
+      *p++=b64[s[i]>>2];
+      *p++=b64[((s[i]&3)<<4)|(s[i+1]>>4)];
+      *p++=b64[((s[i+1]&15)<<2)|(s[i+2]>>6)];
+      *p++=b64[s[i+2]&63];
+    }
+  if(i<n)
+    {
+      *p++=b64[s[i]>>2];
+      if(i+1<n)
+        {
+          *p++=b64[((s[i]&3)<<4)|(s[i+1]>>4)];
+          *p++=b64[(s[i+1]&15)<<2];
+        }
+      else
+        {
+          *p++=b64[(s[i]&3)<<4];
+          *p++='=';
+        }
+      *p++='=';
+    }
+  *p++='"';
+  eb->len=p-eb->buf;
+  return 0;
+}
+
+static int
+export_int64(exportbuf *eb, sqlite3_int64 v)
+{
+  char tmp[24];
+  char *p=tmp+sizeof(tmp);
+  sqlite3_uint64 u=(v<0)?(0-(sqlite3_uint64)v):(sqlite3_uint64)v;
+
+  do
+    {
+      *--p=(char)('0'+u%10);
+      u/=10;
+    } while(u);
+  if(v<0)
+    *--p='-';
+  return exportbuf_add(eb, p, tmp+sizeof(tmp)-p);
+}
+
+/* Floats are formatted the same as Python's repr.  JSON uses the
+   spelling of infinity and NaN from Python's json module. */
+static int
+export_double(exportbuf *eb, double d, int json)
+{
+  int res;
+  char *s=PyOS_double_to_string(d, 'r', 0, Py_DTSF_ADD_DOT_0, NULL);
+
+  if(!s)
+    return -1;
+  if(json && !strcmp(s, "inf"))
+    res=exportbuf_addstr(eb, "Infinity");
+  else if(json && !strcmp(s, "-inf"))
+    res=exportbuf_addstr(eb, "-Infinity");
+  else if(json && !strcmp(s, "nan"))
+    res=exportbuf_addstr(eb, "NaN");
+  else
+    res=exportbuf_addstr(eb, s);
+  PyMem_Free(s);
+  return res;
+}
+
+static int
+export_value(exportbuf *eb, int format, const char *nullvalue, int type, sqlite3_int64 i, double d, const char *s, int len)
+{
+  char delimiter=(format==EXPORT_TSV)?'\t':',';
+
+  switch(type)
+    {
+    case SQLITE_INTEGER:
+      return export_int64(eb, i);
+    case SQLITE_FLOAT:
+      return export_double(eb, d, format==EXPORT_JSONL);
+    case SQLITE_TEXT:
+      if(format==EXPORT_JSONL)
+        return export_json_string(eb, s, len);
+      return export_csv_field(eb, delimiter, s, len);
+    case SQLITE_BLOB:
+      if(format==EXPORT_JSONL)
+        return export_base64(eb, (const unsigned char*)s, len);
+      return exportbuf_addstr(eb, "<Binary data>");
+    default:
+      if(format==EXPORT_JSONL)
+        return exportbuf_addstr(eb, "null");
+      return export_csv_field(eb, delimiter, nullvalue, strlen(nullvalue));
+    }
+}
+
+/* Writes out and empties the buffer.  Returns -1 with an exception on
+   failure.  Callers mark the cursor in use so a write method can't
+   execute other queries with it or close it part way through. */
+static int
+export_flush(exportbuf *eb, int fd, PyObject *writemethod)
+{
+  if(!eb->len)
+    return 0;
+
+  if(writemethod)
+    {
+      PyObject *res, *data=converttobytes(eb->buf, eb->len);
+      if(!data)
+        return -1;
+      res=PyObject_CallFunctionObjArgs(writemethod, data, NULL);
+      Py_DECREF(data);
+      if(!res)
+        return -1;
+      Py_DECREF(res);
+    }
+  else
+    {
+      size_t done=0;
+      while(done<eb->len)
+        {
+          Py_ssize_t n;
+          int err;
+
+          Py_BEGIN_ALLOW_THREADS
+            {
+              errno=0;
+              n=apsw_write(fd, eb->buf+done, eb->len-done);
+              err=errno;
+            }
+          Py_END_ALLOW_THREADS;
+
+          if(n<0)
+            {
+              if(err==EINTR)
+                {
+                  if(PyErr_CheckSignals())
+                    return -1;
+                  continue;
+                }
+              errno=err;
+              PyErr_SetFromErrno(PyExc_OSError);
+              return -1;
+            }
+          done+=n;
+        }
+    }
+  eb->len=0;
+  return 0;
+}
+
+/** .. method:: export(destination, format="csv", header=True, nullvalue="") -> int
+
+  Writes the remaining result rows to *destination*, formatting the
+  values directly from SQLite without creating Python objects for
+  them.  This is considerably faster than formatting the rows in
+  Python::
+
+    with open("books.csv", "wb") as f:
+        cursor.execute("select * from books").export(f)
+
+  :param destination: A file descriptor number, or an object with a
+    :meth:`write` method taking :class:`bytes` such as a file opened in
+    binary mode.  Output is written in large chunks and is UTF-8
+    encoded.
+  :param format: One of ``csv`` (comma separated), ``tsv`` (tab
+    separated) or ``jsonl`` (one JSON object per line with the column
+    names as keys).
+  :param header: For ``csv`` and ``tsv``, whether the first line
+    contains the column names.
+  :param nullvalue: For ``csv`` and ``tsv``, the text for null values.
+
+  :returns: The number of rows written (not including the header).
+
+  Values are formatted following the same rules as the corresponding
+  :ref:`shell <shell>` output modes.  Text in ``csv`` and ``tsv`` is
+  double quoted when it contains the separator, a double quote or a
+  line ending, and blobs are written as ``<Binary data>``.  In
+  ``jsonl`` blobs are base64 encoded strings.  Floating point values
+  are formatted like :func:`repr`.
+
+  If the cursor executes multiple statements then the rows of all of
+  them are written, with the ``jsonl`` keys updated for each
+  statement.  :ref:`Row tracers <rowtracer>` are not called.  The
+  :meth:`write` method can't use this cursor, and gets
+  :exc:`ThreadingViolationError` if it tries.
+*/
+static PyObject *
+APSWCursor_export(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"destination", "format", "header", "nullvalue", NULL};
+  PyObject *destination=NULL, *headerobj=NULL, *writemethod=NULL;
+  const char *formatname="csv", *nullvalue="";
+  int format, header=1, fd=-1, failed=0;
+  exportbuf eb={NULL, 0, 0}, keys={NULL, 0, 0};
+  size_t *keyoffsets=NULL;
+  APSWStatement *keystatement=NULL;
+  sqlite3_stmt *keyvdbe=NULL;
+  Py_ssize_t nrows=0;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|sOs:export(destination, format=\"csv\", header=True, nullvalue=\"\")", kwlist,
+                                  &destination, &formatname, &headerobj, &nullvalue))
+    return NULL;
+
+  if(!strcmp(formatname, "csv"))
+    format=EXPORT_CSV;
+  else if(!strcmp(formatname, "tsv"))
+    format=EXPORT_TSV;
+  else if(!strcmp(formatname, "jsonl"))
+    format=EXPORT_JSONL;
+  else
+    return PyErr_Format(PyExc_ValueError, "Unknown export format \"%s\".  Use csv, tsv or jsonl", formatname);
+
+  if(headerobj)
+    {
+      header=PyObject_IsTrue(headerobj);
+      if(header==-1)
+        return NULL;
+    }
+  if(format==EXPORT_JSONL)
+    header=0;
+
+  if(PyIntLong_Check(destination))
+    {
+      long l=PyIntLong_AsLong(destination);
+      if(PyErr_Occurred())
+        return NULL;
+      if(l<0 || l>INT_MAX)
+        return PyErr_Format(PyExc_ValueError, "File descriptor %ld is not valid", l);
+      fd=(int)l;
+    }
+  else
+    {
+      writemethod=PyObject_GetAttrString(destination, "write");
+      if(!writemethod)
+        return NULL;
+    }
+
+  for(;;)
+    {
+      struct prefetchslot *slot;
+      sqlite3_stmt *stmt;
+      int ncols, i, needmutex, rebuildkeys;
+      size_t rowstart;
+
+      if(self->status==C_BEGIN)
+        if(!APSWCursor_step(self))
+          goto finally;
+      if(self->status==C_DONE)
+        break;
+
+      assert(self->status==C_ROW);
+      self->status=C_BEGIN;
+
+      slot=PREFETCHSLOT;
+      stmt=self->statement->vdbestatement;
+      ncols=slot?self->prefetcher->ncols:sqlite3_data_count(stmt);
+
+      rebuildkeys=(format==EXPORT_JSONL && (keystatement!=self->statement || keyvdbe!=stmt));
+      if(rebuildkeys)
+        {
+          PyMem_Free(keyoffsets);
+          keyoffsets=PyMem_Malloc(sizeof(size_t)*(ncols+1));
+          if(!keyoffsets)
+            {
+              PyErr_NoMemory();
+              goto finally;
+            }
+          keys.len=0;
+          keystatement=self->statement;
+          keyvdbe=stmt;
+        }
+
+      /* rows from the prefetch worker have already been copied out */
+      needmutex=!slot || rebuildkeys || (header && !nrows);
+      if(needmutex)
+        PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+
+      for(i=0; rebuildkeys && !failed && i<ncols; i++)
+        {
+          const char *name;
+          PYSQLITE_LOCKED_CALL(name=sqlite3_column_name(stmt, i));
+          keyoffsets[i]=keys.len;
+          failed=export_json_string(&keys, name?name:"", name?strlen(name):0) || exportbuf_addstr(&keys, ": ");
+        }
+      if(rebuildkeys)
+        keyoffsets[ncols]=keys.len;
+
+      if(header && !nrows)
+        {
+          for(i=0; !failed && i<ncols; i++)
+            {
+              const char *name;
+              PYSQLITE_LOCKED_CALL(name=sqlite3_column_name(stmt, i));
+              if(i)
+                failed=exportbuf_addstr(&eb, (format==EXPORT_TSV)?"\t":",");
+              if(!failed)
+                failed=export_csv_field(&eb, (format==EXPORT_TSV)?'\t':',', name?name:"", name?strlen(name):0);
+            }
+          if(!failed)
+            failed=exportbuf_addstr(&eb, "\n");
+        }
+
+      if(format==EXPORT_JSONL && !failed)
+        failed=exportbuf_addstr(&eb, "{");
+      rowstart=eb.len;
+      for(i=0; !failed && i<ncols; i++)
+        {
+          if(i)
+            failed=exportbuf_addstr(&eb, (format==EXPORT_JSONL)?", ":((format==EXPORT_TSV)?"\t":","));
+          if(format==EXPORT_JSONL && !failed)
+            failed=exportbuf_add(&eb, keys.buf+keyoffsets[i], keyoffsets[i+1]-keyoffsets[i]);
+          if(failed)
+            break;
+          if(slot)
+            {
+              struct lazycolumn *col=&slot->columns[i];
+              failed=export_value(&eb, format, nullvalue, col->type, col->u.i, col->u.d,
+                                  (col->type==SQLITE_TEXT || col->type==SQLITE_BLOB)?slot->data+col->u.offset:NULL, col->len);
+            }
+          else
+            {
+              int coltype, len=0;
+              sqlite3_int64 iv=0;
+              double dv=0;
+              const char *s=NULL;
+
+              PYSQLITE_LOCKED_CALL(coltype=sqlite3_column_type(stmt, i));
+              switch(coltype)
+                {
+                case SQLITE_INTEGER:
+                  PYSQLITE_LOCKED_CALL(iv=sqlite3_column_int64(stmt, i));
+                  break;
+                case SQLITE_FLOAT:
+                  PYSQLITE_LOCKED_CALL(dv=sqlite3_column_double(stmt, i));
+                  break;
+                case SQLITE_TEXT:
+                  PYSQLITE_LOCKED_CALL( (s=(const char*)sqlite3_column_text(stmt, i), len=sqlite3_column_bytes(stmt, i)) );
+                  break;
+                case SQLITE_BLOB:
+                  PYSQLITE_LOCKED_CALL( (s=sqlite3_column_blob(stmt, i), len=sqlite3_column_bytes(stmt, i)) );
+                  break;
+                }
+              failed=export_value(&eb, format, nullvalue, coltype, iv, dv, s, len);
+            }
+        }
+      /* the csv module quotes a row that is a single empty field so
+         it doesn't look like a blank line */
+      if(!failed && format!=EXPORT_JSONL && ncols==1 && eb.len==rowstart)
+        failed=exportbuf_addstr(&eb, "\"\"");
+      if(!failed)
+        failed=exportbuf_addstr(&eb, (format==EXPORT_JSONL)?"}\n":"\n");
+
+      if(needmutex)
+        PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+
+      if(failed)
+        {
+          if(!PyErr_Occurred())
+            PyErr_NoMemory();
+          goto finally;
+        }
+      nrows++;
+
+      if(eb.len>=EXPORT_FLUSH_SIZE)
+        {
+          INUSE_CALL(failed=export_flush(&eb, fd, writemethod));
+          if(failed)
+            goto finally;
+        }
+    }
+
+  INUSE_CALL(export_flush(&eb, fd, writemethod));
+
+ finally:
+  PyMem_Free(eb.buf);
+  PyMem_Free(keys.buf);
+  PyMem_Free(keyoffsets);
+  Py_XDECREF(writemethod);
+
+  if(PyErr_Occurred())
+    return NULL;
+  return PyLong_FromSsize_t(nrows);
+}
+
+/** .. method:: fetcharrow(maxrows=-1) -> tuple(schema, array) or None
+
+  Returns the remaining result rows of the current statement in the
+  `Arrow C Data Interface
+  <https://arrow.apache.org/docs/format/CDataInterface.html>`__
+  format.  The values are copied straight from SQLite into columnar
+  buffers, without creating a Python object for each value, and
+  can be used by Arrow based libraries without any further copying::
+
+    import pyarrow
+
+    cursor.execute("select id, name, price from items")
+    batch=pyarrow.RecordBatch._import_from_c_capsule(*cursor.fetcharrow())
+
+  :param maxrows: Stop after this many rows.  Use this with repeated
+    calls to get the results as several smaller batches.  A negative
+    number means all rows.  Zero is not allowed because it would give
+    the same result as there being no more rows.
+
+  :returns: A tuple of two :class:`PyCapsule` named ``arrow_schema``
+    and ``arrow_array`` following the `Arrow PyCapsule interface
+    <https://arrow.apache.org/docs/format/CDataInterface/PyCapsuleInterface.html>`__.
+    The schema is a struct with a child per result column, and the
+    array the corresponding struct array (ie a record batch).
+    :const:`None` is returned when there are no more rows.
+
+  The Arrow type of each column comes from its declared type using
+  SQLite's `affinity rules
+  <https://sqlite.org/datatype3.html#determination_of_column_affinity>`__:
+  integer columns become ``int64``, text ``large_utf8``, blob
+  ``large_binary`` and real ``float64``.  Other columns, such as
+  expressions, get the type of their first non-null value, except that
+  integers are promoted to ``float64`` if a floating point value turns
+  up.  Other values that don't match the column type are converted
+  using SQLite's own rules (for example text in an integer column is
+  converted like :code:`CAST(value AS INTEGER)`).  A column with only
+  null values gets the Arrow ``null`` type.
+
+  If the cursor is executing several statements then only rows from
+  the current one are returned, with the next call starting on the
+  next statement.  :ref:`Row tracers <rowtracer>` are not called, and
+  this can't be used while the cursor is prefetching.
+*/
+static PyObject *
+APSWCursor_fetcharrow(APSWCursor *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"maxrows", NULL};
+  Py_ssize_t maxrows=-1;
+  arrowbuilder ab;
+  APSWStatement *statement=NULL;
+  sqlite3_stmt *vdbe=NULL;
+  int res=SQLITE_OK;
+
+  CHECK_USE(NULL);
+  CHECK_CURSOR_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "|n:fetcharrow(maxrows=-1)", kwlist, &maxrows))
+    return NULL;
+  if(maxrows==0)
+    return PyErr_Format(PyExc_ValueError, "maxrows must be positive, or negative for all rows");
+
+  if(self->prefetcher)
+    return PyErr_Format(PyExc_ValueError, "fetcharrow can't be used while the cursor is prefetching");
+
+  memset(&ab, 0, sizeof(ab));
+
+  while(maxrows<0 || ab.nrows<maxrows)
+    {
+      sqlite3_stmt *stmt;
+
+      if(self->status==C_BEGIN)
+        if(!APSWCursor_step(self))
+          goto finally;
+      if(self->status==C_DONE)
+        break;
+
+      assert(self->status==C_ROW);
+      stmt=self->statement->vdbestatement;
+
+      /* a row from the next statement is left for the next call */
+      if(statement && (statement!=self->statement || vdbe!=stmt))
+        break;
+      self->status=C_BEGIN;
+
+      PYSQLITE_DB_MUTEX_ENTER(self->connection->db);
+      if(!statement)
+        res=arrowbuilder_init(&ab, stmt, sqlite3_data_count(stmt));
+      if(res==SQLITE_OK)
+        res=arrowbuilder_addrow(&ab, stmt);
+      PYSQLITE_DB_MUTEX_LEAVE(self->connection->db);
+
+      if(res!=SQLITE_OK)
+        {
+          PyErr_NoMemory();
+          goto finally;
+        }
+      statement=self->statement;
+      vdbe=stmt;
+    }
+
+  if(statement)
+    return arrowbuilder_capsules(&ab);
+
+ finally:
+  arrowbuilder_free(&ab);
+  if(PyErr_Occurred())
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+/** .. method:: fetchone() -> row or None
+
+  Returns the next row of data or None if there are no more rows.
+*/
+
+static PyObject *
+APSWCursor_fetchone(APSWCursor *self)
+{
+    PyObject *res;
+
+    CHECK_USE(NULL);
+    CHECK_CURSOR_CLOSED(NULL);
+
+    res=APSWCursor_next(self);
+
+    if(res==NULL && !PyErr_Occurred())
+        Py_RETURN_NONE;
+
+    return res;
+}
+
+
+
+static PyMethodDef APSWCursor_methods[] = {
+  {"execute", (PyCFunction)APSWCursor_execute, METH_VARARGS|METH_KEYWORDS,
+   "Executes one or more statements" },
+  {"executemany", (PyCFunction)APSWCursor_executemany, METH_VARARGS,
+   "Repeatedly executes statements on sequence" },
+  {"executemany_columns", (PyCFunction)APSWCursor_executemany_columns, METH_VARARGS|METH_KEYWORDS,
+   "Executes a statement with bindings from columns" },
+  {"setexectrace", (PyCFunction)APSWCursor_setexectrace, METH_O,
+   "Installs a function called for every statement executed"},
+  {"setrowtrace", (PyCFunction)APSWCursor_setrowtrace, METH_O,
+   "Installs a function called for every row returned"},
+  {"getexectrace", (PyCFunction)APSWCursor_getexectrace, METH_NOARGS,
+   "Returns the current exec tracer function"},
+  {"getrowtrace", (PyCFunction)APSWCursor_getrowtrace, METH_NOARGS,
+   "Returns the current row tracer function"},
+  {"setnamedrows", (PyCFunction)APSWCursor_setnamedrows, METH_O,
+   "Sets if rows have named fields"},
+  {"getnamedrows", (PyCFunction)APSWCursor_getnamedrows, METH_NOARGS,
+   "Returns if rows have named fields"},
+  {"setlazyrows", (PyCFunction)APSWCursor_setlazyrows, METH_O,
+   "Sets if rows decode columns on access"},
+  {"getlazyrows", (PyCFunction)APSWCursor_getlazyrows, METH_NOARGS,
+   "Returns if rows decode columns on access"},
+  {"getconnection", (PyCFunction)APSWCursor_getconnection, METH_NOARGS,
+   "Returns the connection object for this cursor"},
+  {"getdescription", (PyCFunction)APSWCursor_getdescription, METH_NOARGS,
+   "Returns the description for the current row"},
+  {"statement_status", (PyCFunction)APSWCursor_statement_status, METH_VARARGS|METH_KEYWORDS,
+   "Returns the counters of the current statement"},
+#ifdef SQLITE_ENABLE_STMT_SCANSTATUS
+  {"scanstatus", (PyCFunction)APSWCursor_scanstatus, METH_VARARGS|METH_KEYWORDS,
+   "Returns how each loop of the query plan performed"},
+#endif
+  {"close", (PyCFunction)APSWCursor_close, METH_VARARGS,
+   "Closes the cursor" },
+  {"fetchall", (PyCFunction)APSWCursor_fetchall, METH_NOARGS,
+   "Fetches all result rows" },
+  {"fetchone", (PyCFunction)APSWCursor_fetchone, METH_NOARGS,
+   "Fetches next result row" },
+  {"fetchmany", (PyCFunction)APSWCursor_fetchmany, METH_VARARGS|METH_KEYWORDS,
+   "Fetches up to size result rows" },
+  {"fetchinto", (PyCFunction)APSWCursor_fetchinto, METH_VARARGS|METH_KEYWORDS,
+   "Fetches numeric result columns into buffers" },
+  {"export", (PyCFunction)APSWCursor_export, METH_VARARGS|METH_KEYWORDS,
+   "Writes remaining rows as csv, tsv or jsonl" },
+  {"fetcharrow", (PyCFunction)APSWCursor_fetcharrow, METH_VARARGS|METH_KEYWORDS,
+   "Fetches result rows in Arrow format" },
+
+  {0, 0, 0, 0}  /* Sentinel */
+};
+
+
+static PyGetSetDef APSWCursor_getset[] = {
+  {"description", (getter)APSWCursor_getdescription_dbapi, NULL,  "Subset of DB-API description attribute", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject APSWCursorType = {
+    APSW_PYTYPE_INIT
+    "apsw.Cursor",             /*tp_name*/
+    sizeof(APSWCursor),            /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
     (destructor)APSWCursor_dealloc, /*tp_dealloc*/
     0,                         /*tp_print*/
     0,                         /*tp_getattr*/
@@ -1536,3 +4135,263 @@ static PyTypeObject APSWCursorType = {
     0                          /* tp_del */
     APSW_PYTYPE_VERSION
 };
+
+
+/* LAZY ROW CODE */
+
+/** .. class:: LazyRow
+
+  Returned by cursors instead of tuples when :meth:`Cursor.setlazyrows`
+  is enabled.  It behaves like a read only sequence - you can use
+  :func:`len`, index (including negative indices and slices which
+  return tuples), iterate, unpack and compare with tuples.  Each
+  column is converted to a Python object the first time it is
+  accessed, and the same object is returned on later accesses.
+
+  The row holds a private copy of the values so it remains valid after
+  the cursor moves on to later rows or is closed.  Use :func:`tuple`
+  if you need a real tuple.
+*/
+
+static void
+APSWLazyRow_dealloc(APSWLazyRow *self)
+{
+  int i;
+
+  if(self->values)
+    for(i=0;i<self->ncols;i++)
+      Py_XDECREF(self->values[i]);
+  /* values shares the columns allocation */
+  PyMem_Free(self->columns);
+  sqlite3_free(self->data);
+  PyObject_Del(self);
+}
+
+static Py_ssize_t
+APSWLazyRow_len(APSWLazyRow *self)
+{
+  return self->ncols;
+}
+
+/* Returns a new reference to column i which must be in range */
+static PyObject *
+APSWLazyRow_column(APSWLazyRow *self, int i)
+{
+  PyObject *item=self->values[i];
+
+  if(item)
+    {
+      Py_INCREF(item);
+      return item;
+    }
+
+  item=rowcopy_convert(&self->columns[i], self->data);
+  if(!item)
+    return NULL;
+
+  Py_INCREF(item);
+  self->values[i]=item;
+  return item;
+}
+
+static PyObject *
+APSWLazyRow_item(APSWLazyRow *self, Py_ssize_t i)
+{
+  if(i<0 || i>=self->ncols)
+    {
+      PyErr_SetString(PyExc_IndexError, "row index out of range");
+      return NULL;
+    }
+  return APSWLazyRow_column(self, (int)i);
+}
+
+/* Returns a new tuple of columns start to stop in steps of step */
+static PyObject *
+APSWLazyRow_tuple(APSWLazyRow *self, Py_ssize_t start, Py_ssize_t step, Py_ssize_t count)
+{
+  PyObject *res, *item;
+  Py_ssize_t i;
+
+  res=PyTuple_New(count);
+  if(!res)
+    return NULL;
+
+  for(i=0;i<count;i++, start+=step)
+    {
+      item=APSWLazyRow_column(self, (int)start);
+      if(!item)
+        {
+          Py_DECREF(res);
+          return NULL;
+        }
+      PyTuple_SET_ITEM(res, i, item);
+    }
+  return res;
+}
+
+static PyObject *
+APSWLazyRow_subscript(APSWLazyRow *self, PyObject *key)
+{
+  if(PyIndex_Check(key))
+    {
+      Py_ssize_t i=PyNumber_AsSsize_t(key, PyExc_IndexError);
+      if(i==-1 && PyErr_Occurred())
+        return NULL;
+      if(i<0)
+        i+=self->ncols;
+      return APSWLazyRow_item(self, i);
+    }
+  if(PySlice_Check(key))
+    {
+      Py_ssize_t start, stop, step, count;
+#if PY_VERSION_HEX < 0x03020000
+      if(PySlice_GetIndicesEx((PySliceObject*)key, self->ncols, &start, &stop, &step, &count))
+#else
+      if(PySlice_GetIndicesEx(key, self->ncols, &start, &stop, &step, &count))
+#endif
+        return NULL;
+      return APSWLazyRow_tuple(self, start, step, count);
+    }
+  return PyErr_Format(PyExc_TypeError, "row indices must be integers or slices");
+}
+
+static PyObject *
+APSWLazyRow_richcompare(APSWLazyRow *self, PyObject *other, int op)
+{
+  PyObject *mine, *theirs, *res;
+
+  mine=APSWLazyRow_tuple(self, 0, 1, self->ncols);
+  if(!mine)
+    return NULL;
+
+  if(PyObject_TypeCheck(other, &APSWLazyRowType))
+    theirs=APSWLazyRow_tuple((APSWLazyRow*)other, 0, 1, ((APSWLazyRow*)other)->ncols);
+  else if(PyTuple_Check(other))
+    {
+      theirs=other;
+      Py_INCREF(theirs);
+    }
+  else
+    {
+      Py_DECREF(mine);
+      Py_INCREF(Py_NotImplemented);
+      return Py_NotImplemented;
+    }
+  if(!theirs)
+    {
+      Py_DECREF(mine);
+      return NULL;
+    }
+
+  res=PyObject_RichCompare(mine, theirs, op);
+  Py_DECREF(mine);
+  Py_DECREF(theirs);
+  return res;
+}
+
+static Py_hash_t
+APSWLazyRow_hash(APSWLazyRow *self)
+{
+  Py_hash_t res;
+  PyObject *t=APSWLazyRow_tuple(self, 0, 1, self->ncols);
+
+  if(!t)
+    return -1;
+  res=PyObject_Hash(t);
+  Py_DECREF(t);
+  return res;
+}
+
+static PyObject *
+APSWLazyRow_repr(APSWLazyRow *self)
+{
+  PyObject *t, *r, *res=NULL;
+
+  t=APSWLazyRow_tuple(self, 0, 1, self->ncols);
+  if(!t)
+    return NULL;
+  r=PyObject_Repr(t);
+  Py_DECREF(t);
+  if(!r)
+    return NULL;
+#if PY_MAJOR_VERSION < 3
+  res=PyString_FromFormat("LazyRow%s", PyString_AsString(r));
+#else
+  res=PyUnicode_FromFormat("LazyRow%U", r);
+#endif
+  Py_DECREF(r);
+  return res;
+}
+
+static PySequenceMethods APSWLazyRow_as_sequence = {
+  (lenfunc)APSWLazyRow_len,          /* sq_length */
+  0,                                 /* sq_concat */
+  0,                                 /* sq_repeat */
+  (ssizeargfunc)APSWLazyRow_item,    /* sq_item */
+  0,                                 /* sq_slice */
+  0,                                 /* sq_ass_item */
+  0,                                 /* sq_ass_slice */
+  0,                                 /* sq_contains */
+  0,                                 /* sq_inplace_concat */
+  0,                                 /* sq_inplace_repeat */
+};
+
+static PyMappingMethods APSWLazyRow_as_mapping = {
+  (lenfunc)APSWLazyRow_len,          /* mp_length */
+  (binaryfunc)APSWLazyRow_subscript, /* mp_subscript */
+  0,                                 /* mp_ass_subscript */
+};
+
+static PyTypeObject APSWLazyRowType = {
+    APSW_PYTYPE_INIT
+    "apsw.LazyRow",            /*tp_name*/
+    sizeof(APSWLazyRow),       /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)APSWLazyRow_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    (reprfunc)APSWLazyRow_repr, /*tp_repr*/
+    0,                         /*tp_as_number*/
+    &APSWLazyRow_as_sequence,  /*tp_as_sequence*/
+    &APSWLazyRow_as_mapping,   /*tp_as_mapping*/
+    (hashfunc)APSWLazyRow_hash, /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_VERSION_TAG
+#if PY_MAJOR_VERSION < 3
+ | Py_TPFLAGS_HAVE_RICHCOMPARE
+#endif
+ , /*tp_flags*/
+    "LazyRow object",          /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    (richcmpfunc)APSWLazyRow_richcompare, /* tp_richcompare */
+    0,		               /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    0,                         /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,                         /* tp_init */
+    0,                         /* tp_alloc */
+    0,                         /* tp_new */
+    0,                         /* tp_free */
+    0,                         /* tp_is_gc */
+    0,                         /* tp_bases */
+    0,                         /* tp_mro */
+    0,                         /* tp_cache */
+    0,                         /* tp_subclasses */
+    0,                         /* tp_weaklist */
+    0                          /* tp_del */
+    APSW_PYTYPE_VERSION
+};
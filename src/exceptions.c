@@ -20,6 +20,7 @@ static PyObject *ExcConnectionClosed; /* connection was closed when function cal
 static PyObject *ExcVFSNotImplemented; /* base vfs doesn't implment function */
 static PyObject *ExcVFSFileClosed;     /* attempted operation on closed file */
 static PyObject *ExcForkingViolation; /* used object across a fork */
+static PyObject *ExcQueryTimeout; /* query ran past its deadline */
 
 static void make_exception(int res, sqlite3 *db);
 
@@ -157,7 +158,8 @@ static int init_exceptions(PyObject *m)
     {&ExcCursorClosed, "CursorClosedError"},
     {&ExcVFSNotImplemented, "VFSNotImplementedError"},
     {&ExcVFSFileClosed, "VFSFileClosedError"},
-    {&ExcForkingViolation, "ForkingViolationError"}
+    {&ExcForkingViolation, "ForkingViolationError"},
+    {&ExcQueryTimeout, "QueryTimeoutError"}
   };
 
 
@@ -0,0 +1,679 @@
+/*
+  Connection pool code
+
+  See the accompanying LICENSE file.
+*/
+
+/**
+.. _connectionpool:
+
+Connection Pool
+***************
+
+A :class:`ConnectionPool` holds one writer :class:`Connection` and
+several reader connections to the same database, which is the way
+`WAL mode <https://sqlite.org/wal.html>`__ is designed to be used.
+Readers don't block the writer or each other, so threads can query at
+the same time while one of them makes changes.  Each connection has
+its own :ref:`statement cache <statementcache>`.
+
+Threads check out a connection with :meth:`ConnectionPool.reader` or
+:meth:`ConnectionPool.writer` in a *with* statement, and the
+connection is returned to the pool at the end of the block::
+
+  pool=apsw.ConnectionPool("app.db", readers=8)
+
+  with pool.writer() as db:
+      db.cursor().execute("insert into log values(?)", (message,))
+
+  with pool.reader() as db:
+      for row in db.cursor().execute("select * from log"):
+          ...
+
+Checking out and returning connections is done entirely in C while
+holding the GIL so there is no Python level locking.  Threads only
+wait (with the GIL released) when all connections of the kind they
+want are in use.
+
+*/
+
+/* slot 0 is the writer, and the readers follow */
+#define POOL_WRITER 0
+#define POOL_READER 1
+#define POOL_KIND(slot) ( ((slot)==0) ? POOL_WRITER : POOL_READER )
+
+/* Waits are done in pieces this long (microseconds) so that signals
+   such as keyboard interrupts are noticed */
+#define POOL_WAIT_US 100000
+
+/* CONNECTIONPOOL TYPE */
+typedef struct APSWConnectionPool {
+  PyObject_HEAD
+  PyObject *filename;              /* given to each Connection */
+  PyObject *kwargs;                /* flags, vfs and statementcachesize for each Connection */
+  int wal;                         /* put the database in WAL mode */
+  int nslots;                      /* writer plus readers */
+  Connection **connections;        /* nslots entries, NULL after close */
+  unsigned char *checkedout;       /* nslots entries, non-zero when checked out */
+  int closed;
+
+  /* Waiting for a free connection.  Each kind has a lock that is held
+     while there is nothing to wait for, and released to wake a
+     waiter.  The members are only touched while holding the GIL. */
+  PyThread_type_lock available[2];
+  int waiting[2];
+  int signalled[2];
+
+  PyObject *weakreflist;           /* weak reference tracking */
+} APSWConnectionPool;
+
+/* Returned by reader() and writer() */
+typedef struct APSWPoolCheckout {
+  PyObject_HEAD
+  APSWConnectionPool *pool;
+  int kind;
+  double timeout;
+  int slot;                        /* checked out slot or -1 */
+} APSWPoolCheckout;
+
+static PyTypeObject APSWPoolCheckoutType;
+
+/** .. class:: ConnectionPool(filename, readers=4, flags=SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, vfs=None, statementcachesize=100, wal=True)
+
+  Opens one writer and *readers* reader connections to *filename*.
+  The *flags*, *vfs* and *statementcachesize* are used for every
+  connection and mean the same as for :class:`Connection`.  Reader
+  connections have `query_only
+  <https://sqlite.org/pragma.html#pragma_query_only>`__ turned on so
+  that accidental changes through them fail.  If *wal* is True then
+  the database is switched to WAL mode when the pool is created.
+
+  Each connection is made by calling :class:`Connection`, so
+  :attr:`connection_hooks` are run for each of them.
+
+  .. note::
+
+    Every connection to ``:memory:`` is a separate database, so pools
+    need a real file or a shared cache URI.
+*/
+
+static void
+ConnectionPool_signal(APSWConnectionPool *self, int kind)
+{
+  if(self->waiting[kind] && !self->signalled[kind])
+    {
+      self->signalled[kind]=1;
+      PyThread_release_lock(self->available[kind]);
+    }
+}
+
+/* Closes a connection ignoring any errors */
+static void
+ConnectionPool_closeconnection(Connection *connection)
+{
+  PyObject *res;
+
+  res=Call_PythonMethodV((PyObject*)connection, "close", 1, "(i)", 1);
+  if(!res)
+    apsw_write_unraiseable(NULL);
+  Py_XDECREF(res);
+}
+
+/* Runs sql on connection which must not return rows.  Returns 0 on
+   success or -1 with an exception set. */
+static int
+ConnectionPool_exec(Connection *connection, const char *sql)
+{
+  int res;
+
+  _PYSQLITE_CALL_E(connection->db, res=sqlite3_exec(connection->db, sql, NULL, NULL, NULL));
+  SET_EXC(res, connection->db);
+  return (res==SQLITE_OK)?0:-1;
+}
+
+/* Makes the connection for slot.  Returns a new reference or NULL
+   with an exception set. */
+static Connection *
+ConnectionPool_open(APSWConnectionPool *self, int slot)
+{
+  Connection *connection;
+  PyObject *args;
+  const char *sql;
+
+  args=PyTuple_Pack(1, self->filename);
+  if(!args)
+    return NULL;
+  connection=(Connection*)PyObject_Call((PyObject*)&ConnectionType, args, self->kwargs);
+  Py_DECREF(args);
+  if(!connection)
+    return NULL;
+
+  if(POOL_KIND(slot)==POOL_WRITER)
+    sql=self->wal?"pragma journal_mode=wal":NULL;
+  else
+    sql="pragma query_only=1";
+
+  if(sql && ConnectionPool_exec(connection, sql))
+    {
+      ConnectionPool_closeconnection(connection);
+      Py_DECREF(connection);
+      return NULL;
+    }
+  return connection;
+}
+
+static void
+ConnectionPool_close_internal(APSWConnectionPool *self)
+{
+  int i;
+
+  self->closed=1;
+  for(i=0;self->connections && i<self->nslots;i++)
+    if(self->connections[i] && !self->checkedout[i])
+      {
+        ConnectionPool_closeconnection(self->connections[i]);
+        Py_CLEAR(self->connections[i]);
+      }
+
+  /* let waiters find out */
+  ConnectionPool_signal(self, POOL_WRITER);
+  ConnectionPool_signal(self, POOL_READER);
+}
+
+static void
+ConnectionPool_dealloc(APSWConnectionPool *self)
+{
+  int i;
+
+  APSW_CLEAR_WEAKREFS;
+
+  if(self->connections)
+    {
+      /* checkouts hold a reference to the pool so none can be out */
+      ConnectionPool_close_internal(self);
+      for(i=0;i<self->nslots;i++)
+        assert(!self->connections[i]);
+      PyMem_Free(self->connections);
+    }
+  PyMem_Free(self->checkedout);
+  for(i=0;i<2;i++)
+    if(self->available[i])
+      {
+        if(self->signalled[i])
+          PyThread_acquire_lock(self->available[i], WAIT_LOCK);
+        PyThread_release_lock(self->available[i]);
+        PyThread_free_lock(self->available[i]);
+      }
+  Py_XDECREF(self->filename);
+  Py_XDECREF(self->kwargs);
+
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static int
+ConnectionPool_init(APSWConnectionPool *self, PyObject *args, PyObject *kwds)
+{
+  static char *kwlist[]={"filename", "readers", "flags", "vfs", "statementcachesize", "wal", NULL};
+  PyObject *filename=NULL, *vfs=Py_None, *wal=Py_True;
+  int readers=4, flags=SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, statementcachesize=100, i;
+
+  if(self->connections)
+    {
+      PyErr_Format(PyExc_RuntimeError, "ConnectionPool has already been initialized");
+      return -1;
+    }
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|iiOiO:ConnectionPool(filename, readers=4, flags=SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE, vfs=None, statementcachesize=100, wal=True)",
+                                  kwlist, &filename, &readers, &flags, &vfs, &statementcachesize, &wal))
+    return -1;
+
+  if(readers<1)
+    {
+      PyErr_Format(PyExc_ValueError, "There must be at least one reader");
+      return -1;
+    }
+
+  self->wal=PyObject_IsTrue(wal);
+  if(self->wal<0)
+    return -1;
+
+  self->kwargs=Py_BuildValue("{s:i,s:O,s:i}", "flags", flags, "vfs", vfs, "statementcachesize", statementcachesize);
+  if(!self->kwargs)
+    return -1;
+  Py_INCREF(filename);
+  self->filename=filename;
+
+  for(i=0;i<2;i++)
+    {
+      self->available[i]=PyThread_allocate_lock();
+      if(!self->available[i])
+        {
+          PyErr_NoMemory();
+          return -1;
+        }
+      /* held while there is nothing to wait for */
+      PyThread_acquire_lock(self->available[i], WAIT_LOCK);
+    }
+
+  self->nslots=readers+1;
+  self->connections=PyMem_Malloc(sizeof(Connection*)*self->nslots);
+  self->checkedout=PyMem_Malloc(self->nslots);
+  if(!self->connections || !self->checkedout)
+    {
+      PyErr_NoMemory();
+      return -1;
+    }
+  memset(self->connections, 0, sizeof(Connection*)*self->nslots);
+  memset(self->checkedout, 0, self->nslots);
+
+  /* the writer goes first so it can create the database and set WAL
+     mode before the readers open it */
+  for(i=0;i<self->nslots;i++)
+    {
+      self->connections[i]=ConnectionPool_open(self, i);
+      if(!self->connections[i])
+        {
+          ConnectionPool_close_internal(self);
+          return -1;
+        }
+    }
+
+  return 0;
+}
+
+#define CHECK_POOL_CLOSED(e)                                            \
+  do                                                                    \
+    {                                                                   \
+      if(!self->connections || self->closed)                            \
+        { PyErr_Format(PyExc_ValueError, "The connection pool has been closed"); return e; } \
+    } while(0)
+
+/* Returns a free slot of kind or -1 if there isn't one */
+static int
+ConnectionPool_findfree(APSWConnectionPool *self, int kind)
+{
+  int i;
+
+  if(kind==POOL_WRITER)
+    return self->checkedout[0]?-1:0;
+
+  for(i=1;i<self->nslots;i++)
+    if(!self->checkedout[i])
+      return i;
+  return -1;
+}
+
+/* Checks out a connection of kind waiting up to timeout seconds, or
+   forever if it is negative.  Returns the slot or -1 with an
+   exception set. */
+static int
+ConnectionPool_checkout(APSWConnectionPool *self, int kind, double timeout)
+{
+  sqlite3_int64 deadline=0, wait;
+  int slot, got, i;
+
+  if(timeout>=0)
+    deadline=apsw_monotonic_us()+(sqlite3_int64)(timeout*1000000);
+
+  for(;;)
+    {
+      CHECK_POOL_CLOSED(-1);
+
+      slot=ConnectionPool_findfree(self, kind);
+      if(slot>=0)
+        break;
+
+      wait=POOL_WAIT_US;
+      if(timeout>=0)
+        {
+          sqlite3_int64 remaining=deadline-apsw_monotonic_us();
+          if(remaining<=0)
+            {
+              for(i=0;exc_descriptors[i].code!=SQLITE_BUSY;i++);
+              PyErr_Format(exc_descriptors[i].cls, "BusyError: Timed out waiting for a %s connection from the pool",
+                           (kind==POOL_WRITER)?"writer":"reader");
+              return -1;
+            }
+          if(remaining<wait)
+            wait=remaining;
+        }
+
+      self->waiting[kind]++;
+#if PY_VERSION_HEX >= 0x03020000
+      Py_BEGIN_ALLOW_THREADS
+        got=(PyThread_acquire_lock_timed(self->available[kind], (PY_TIMEOUT_T)wait, 0)==PY_LOCK_ACQUIRED);
+      Py_END_ALLOW_THREADS;
+#else
+      /* no timed waits so poll */
+      got=PyThread_acquire_lock(self->available[kind], NOWAIT_LOCK);
+      if(!got)
+        _PYSQLITE_CALL_V(sqlite3_sleep(10));
+#endif
+      self->waiting[kind]--;
+      if(got)
+        self->signalled[kind]=0;
+
+      if(PyErr_CheckSignals())
+        return -1;
+    }
+
+  self->checkedout[slot]=1;
+  /* let the next waiter have a go if there is still one free */
+  if(ConnectionPool_findfree(self, kind)>=0)
+    ConnectionPool_signal(self, kind);
+  return slot;
+}
+
+/* Returns slot to the pool.  A transaction left open is rolled back,
+   and if that fails the connection is closed and replaced on next
+   checkout. */
+static void
+ConnectionPool_return(APSWConnectionPool *self, int slot)
+{
+  Connection *connection=self->connections[slot];
+  PyObject *etype, *evalue, *etb;
+
+  assert(self->checkedout[slot]);
+  PyErr_Fetch(&etype, &evalue, &etb);
+
+  if(connection->db && !sqlite3_get_autocommit(connection->db) && ConnectionPool_exec(connection, "rollback"))
+    {
+      apsw_write_unraiseable(NULL);
+      ConnectionPool_closeconnection(connection);
+    }
+
+  if(self->closed)
+    {
+      ConnectionPool_closeconnection(connection);
+      Py_CLEAR(self->connections[slot]);
+    }
+
+  self->checkedout[slot]=0;
+  ConnectionPool_signal(self, POOL_KIND(slot));
+
+  PyErr_Restore(etype, evalue, etb);
+}
+
+static PyObject *
+ConnectionPool_makecheckout(APSWConnectionPool *self, PyObject *args, PyObject *kwds, int kind)
+{
+  static char *kwlist[]={"timeout", NULL};
+  double timeout=-1;
+  APSWPoolCheckout *checkout;
+
+  CHECK_POOL_CLOSED(NULL);
+
+  if(!PyArg_ParseTupleAndKeywords(args, kwds, (kind==POOL_WRITER)?"|d:writer(timeout=-1)":"|d:reader(timeout=-1)", kwlist, &timeout))
+    return NULL;
+
+  checkout=PyObject_New(APSWPoolCheckout, &APSWPoolCheckoutType);
+  if(!checkout)
+    return NULL;
+  Py_INCREF(self);
+  checkout->pool=self;
+  checkout->kind=kind;
+  checkout->timeout=timeout;
+  checkout->slot=-1;
+  return (PyObject*)checkout;
+}
+
+/** .. method:: reader(timeout=-1)
+
+  Returns a context manager which checks out a reader
+  :class:`Connection` on entry, waiting for one to be free if
+  necessary, and returns it to the pool on exit::
+
+    with pool.reader() as db:
+        rows=db.cursor().execute("select ...").fetchall()
+
+  Do not keep using the connection or its cursors after the block.
+  Any transaction still open at the end of the block is rolled back.
+
+  :param timeout: Maximum seconds to wait for a free connection.
+    Negative means wait forever.
+
+  :raises BusyError: If *timeout* expires
+*/
+static PyObject *
+ConnectionPool_reader(APSWConnectionPool *self, PyObject *args, PyObject *kwds)
+{
+  return ConnectionPool_makecheckout(self, args, kwds, POOL_READER);
+}
+
+/** .. method:: writer(timeout=-1)
+
+  Like :meth:`~ConnectionPool.reader` but for the one writer
+  connection, so only one thread at a time can be making changes.
+*/
+static PyObject *
+ConnectionPool_writer(APSWConnectionPool *self, PyObject *args, PyObject *kwds)
+{
+  return ConnectionPool_makecheckout(self, args, kwds, POOL_WRITER);
+}
+
+/** .. method:: close()
+
+  Closes all the connections.  Connections currently checked out are
+  closed when they are returned.  It is okay to call this multiple
+  times.
+*/
+static PyObject *
+ConnectionPool_close(APSWConnectionPool *self)
+{
+  if(self->connections)
+    ConnectionPool_close_internal(self);
+  Py_RETURN_NONE;
+}
+
+/** .. attribute:: readers
+
+  The number of reader connections.
+*/
+static PyObject *
+ConnectionPool_getreaders(APSWConnectionPool *self)
+{
+  return PyInt_FromLong(self->nslots?self->nslots-1:0);
+}
+
+/** .. attribute:: available
+
+  A tuple of whether the writer is available and how many readers are
+  available to check out.
+*/
+static PyObject *
+ConnectionPool_getavailable(APSWConnectionPool *self)
+{
+  int i, readers=0;
+
+  CHECK_POOL_CLOSED(NULL);
+
+  for(i=1;i<self->nslots;i++)
+    if(!self->checkedout[i])
+      readers++;
+
+  return Py_BuildValue("(Oi)", self->checkedout[0]?Py_False:Py_True, readers);
+}
+
+static PyMethodDef ConnectionPool_methods[]={
+  {"reader", (PyCFunction)ConnectionPool_reader, METH_VARARGS|METH_KEYWORDS,
+   "Checks out a reader connection"},
+  {"writer", (PyCFunction)ConnectionPool_writer, METH_VARARGS|METH_KEYWORDS,
+   "Checks out the writer connection"},
+  {"close", (PyCFunction)ConnectionPool_close, METH_NOARGS,
+   "Closes the connections"},
+  {0,0,0,0} /* Sentinel */
+};
+
+static PyGetSetDef ConnectionPool_getset[]={
+  {"readers", (getter)ConnectionPool_getreaders, NULL, "Number of readers", NULL},
+  {"available", (getter)ConnectionPool_getavailable, NULL, "Connections available", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject APSWConnectionPoolType = {
+    APSW_PYTYPE_INIT
+    "apsw.ConnectionPool",     /*tp_name*/
+    sizeof(APSWConnectionPool), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)ConnectionPool_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_BASETYPE|Py_TPFLAGS_HAVE_VERSION_TAG, /*tp_flags*/
+    "Connection pool",         /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    offsetof(APSWConnectionPool, weakreflist), /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    ConnectionPool_methods,    /* tp_methods */
+    0,                         /* tp_members */
+    ConnectionPool_getset,     /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    (initproc)ConnectionPool_init, /* tp_init */
+    0,                         /* tp_alloc */
+    PyType_GenericNew,         /* tp_new */
+    0,                         /* tp_free */
+    0,                         /* tp_is_gc */
+    0,                         /* tp_bases */
+    0,                         /* tp_mro */
+    0,                         /* tp_cache */
+    0,                         /* tp_subclasses */
+    0,                         /* tp_weaklist */
+    0                          /* tp_del */
+    APSW_PYTYPE_VERSION
+};
+
+/* POOLCHECKOUT TYPE */
+
+static void
+PoolCheckout_dealloc(APSWPoolCheckout *self)
+{
+  /* only happens if __exit__ wasn't called */
+  if(self->slot>=0)
+    ConnectionPool_return(self->pool, self->slot);
+  Py_XDECREF(self->pool);
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+static PyObject *
+PoolCheckout_enter(APSWPoolCheckout *self)
+{
+  APSWConnectionPool *pool=self->pool;
+  int slot;
+
+  if(self->slot>=0)
+    return PyErr_Format(PyExc_ValueError, "The connection has already been checked out");
+
+  slot=ConnectionPool_checkout(pool, self->kind, self->timeout);
+  if(slot<0)
+    return NULL;
+
+  /* replace connections closed while checked out */
+  if(!pool->connections[slot]->db)
+    {
+      Connection *connection=ConnectionPool_open(pool, slot);
+      if(!connection)
+        {
+          ConnectionPool_return(pool, slot);
+          return NULL;
+        }
+      Py_DECREF(pool->connections[slot]);
+      pool->connections[slot]=connection;
+    }
+
+  self->slot=slot;
+  Py_INCREF(pool->connections[slot]);
+  return (PyObject*)pool->connections[slot];
+}
+
+static PyObject *
+PoolCheckout_exit(APSWPoolCheckout *self, PyObject *args)
+{
+  PyObject *etype, *evalue, *etb;
+
+  if(!PyArg_ParseTuple(args, "OOO", &etype, &evalue, &etb))
+    return NULL;
+
+  if(self->slot<0)
+    return PyErr_Format(PyExc_ValueError, "The connection is not checked out");
+
+  ConnectionPool_return(self->pool, self->slot);
+  self->slot=-1;
+
+  Py_RETURN_FALSE;
+}
+
+static PyMethodDef PoolCheckout_methods[]={
+  {"__enter__", (PyCFunction)PoolCheckout_enter, METH_NOARGS,
+   "Checks out the connection"},
+  {"__exit__", (PyCFunction)PoolCheckout_exit, METH_VARARGS,
+   "Returns the connection to the pool"},
+  {0,0,0,0} /* Sentinel */
+};
+
+static PyTypeObject APSWPoolCheckoutType = {
+    APSW_PYTYPE_INIT
+    "apsw.PoolCheckout",       /*tp_name*/
+    sizeof(APSWPoolCheckout),  /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)PoolCheckout_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_VERSION_TAG, /*tp_flags*/
+    "Connection pool checkout", /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    0,                         /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    PoolCheckout_methods,      /* tp_methods */
+    0,                         /* tp_members */
+    0,                         /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,                         /* tp_init */
+    0,                         /* tp_alloc */
+    0,                         /* tp_new */
+    0,                         /* tp_free */
+    0,                         /* tp_is_gc */
+    0,                         /* tp_bases */
+    0,                         /* tp_mro */
+    0,                         /* tp_cache */
+    0,                         /* tp_subclasses */
+    0,                         /* tp_weaklist */
+    0                          /* tp_del */
+    APSW_PYTYPE_VERSION
+};
@@ -0,0 +1,348 @@
+/*
+  Prepared statement code
+
+  See the accompanying LICENSE file.
+*/
+
+/**
+.. _preparedstatements:
+
+Prepared Statements
+*******************
+
+:meth:`Cursor.execute` looks up the query text in the
+:ref:`statement cache <statementcache>` every time, preparing it if
+not found.  When you run the same statement a very large number of
+times, such as point lookups in a loop, you can instead prepare it
+once with :meth:`Connection.prepare` and execute the resulting
+:class:`PreparedStatement` directly.  That skips the cache lookup and
+text handling, and the statement can't be evicted from the cache by
+other queries.
+
+*/
+
+/* PREPAREDSTATEMENT TYPE */
+struct APSWPreparedStatement {
+  PyObject_HEAD
+  Connection *connection;
+  APSWStatement *statement;       /* owned statement - NULL when closed */
+  APSWCursor *cursor;             /* used by execute and executemany - made on first use */
+  PyObject *bindings;             /* from bind() */
+  unsigned inuse;                 /* track if we are in use preventing concurrent thread mangling */
+  PyObject *weakreflist;          /* weak reference tracking */
+};
+
+typedef struct APSWPreparedStatement APSWPreparedStatement;
+
+/** .. class:: PreparedStatement
+
+  This object is created by :meth:`Connection.prepare` and holds a
+  single prepared statement.  You can execute it with its own
+  :meth:`~PreparedStatement.execute` and
+  :meth:`~PreparedStatement.executemany` methods, or by passing it
+  instead of query text to :meth:`Cursor.execute` and
+  :meth:`Cursor.executemany`.
+
+  The statement can only be executing once at a time.  Trying to
+  execute it again while a previous execution still has rows to
+  return from a different cursor raises
+  :exc:`ThreadingViolationError`.
+*/
+
+static void
+APSWPreparedStatement_init(APSWPreparedStatement *self, Connection *connection, APSWStatement *statement)
+{
+  Py_INCREF(connection);
+  self->connection=connection;
+  self->statement=statement;
+  self->cursor=NULL;
+  self->bindings=NULL;
+  self->inuse=0;
+  self->weakreflist=NULL;
+}
+
+static int
+APSWPreparedStatement_close_internal(APSWPreparedStatement *self, int force)
+{
+  if(self->cursor)
+    {
+      /* the cursor can be stepping in another thread with the GIL
+         released, or be the caller of a callback closing us.  When
+         being deallocated the cursor is just let go as whoever is
+         using it still has a reference. */
+      if(self->cursor->inuse && force!=2)
+        {
+          PyErr_Format(ExcThreadingViolation, "You are trying to use the same object concurrently in two threads or re-entrantly within the same thread which is not allowed.");
+          return 1;
+        }
+      if(!self->cursor->inuse && APSWCursor_close_internal(self->cursor, force))
+        return 1;
+      Py_CLEAR(self->cursor);
+    }
+
+  /* if a cursor is executing the statement then it holds a reference
+     until it is done */
+  Py_CLEAR(self->statement);
+  Py_CLEAR(self->bindings);
+
+  /* Remove from connection dependents list.  Has to be done before we
+     decref self->connection otherwise connection could dealloc and
+     we'd still be in list */
+  if(self->connection)
+    Connection_remove_dependent(self->connection, (PyObject*)self);
+
+  Py_CLEAR(self->connection);
+
+  return 0;
+}
+
+static void
+APSWPreparedStatement_dealloc(APSWPreparedStatement *self)
+{
+  APSW_CLEAR_WEAKREFS;
+
+  APSWPreparedStatement_close_internal(self, 2);
+
+  Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+/* Called by statementcache_prepare when a PreparedStatement is given
+   instead of query text.  Returns a new reference to the statement
+   marked as inuse. */
+static APSWStatement *
+APSWPreparedStatement_acquire(StatementCache *sc, PyObject *prepared)
+{
+  APSWPreparedStatement *self=(APSWPreparedStatement*)prepared;
+  APSWStatement *statement=self->statement;
+
+  if(!statement)
+    {
+      PyErr_Format(PyExc_ValueError, "The prepared statement has been closed");
+      return NULL;
+    }
+  if(self->connection->stmtcache!=sc)
+    {
+      PyErr_Format(PyExc_ValueError, "The prepared statement belongs to a different connection");
+      return NULL;
+    }
+  if(statement->inuse)
+    {
+      PyErr_Format(ExcThreadingViolation, "The prepared statement is already executing");
+      return NULL;
+    }
+
+  statement->inuse=1;
+  if(statement->vdbestatement)
+    _PYSQLITE_CALL_V(sqlite3_clear_bindings(statement->vdbestatement));
+  Py_INCREF(statement);
+  return statement;
+}
+
+#define CHECK_PREPARED_CLOSED(e)                                        \
+  do                                                                    \
+    {                                                                   \
+      if(!self->statement)                                              \
+        { PyErr_Format(PyExc_ValueError, "The prepared statement has been closed"); return e; } \
+      CHECK_CLOSED(self->connection, e);                                \
+    } while(0)
+
+/* returns the cursor used by execute and executemany - borrowed reference */
+static APSWCursor *
+APSWPreparedStatement_getcursor(APSWPreparedStatement *self)
+{
+  if(!self->cursor)
+    self->cursor=(APSWCursor*)Connection_cursor(self->connection);
+  return self->cursor;
+}
+
+/** .. method:: bind(bindings)
+
+  Remembers *bindings* which are then used by
+  :meth:`~PreparedStatement.execute` when it is not given any.  Use
+  None to forget them.
+*/
+static PyObject *
+APSWPreparedStatement_bind(APSWPreparedStatement *self, PyObject *bindings)
+{
+  CHECK_USE(NULL);
+  CHECK_PREPARED_CLOSED(NULL);
+
+  Py_CLEAR(self->bindings);
+  if(bindings!=Py_None)
+    {
+      Py_INCREF(bindings);
+      self->bindings=bindings;
+    }
+  Py_RETURN_NONE;
+}
+
+/** .. method:: execute(bindings=None) -> Cursor
+
+  Executes the statement with *bindings*, or those from
+  :meth:`~PreparedStatement.bind` if not supplied, the same way as
+  :meth:`Cursor.execute`.  The returned cursor belongs to this object
+  and is used by every call, so iterating over its results must be
+  finished before calling :meth:`~PreparedStatement.execute` or
+  :meth:`~PreparedStatement.executemany` again, which start over.
+*/
+static PyObject *
+APSWPreparedStatement_execute(APSWPreparedStatement *self, PyObject *args)
+{
+  PyObject *bindings=NULL, *cargs;
+  APSWCursor *cursor;
+  PyObject *res;
+
+  CHECK_USE(NULL);
+  CHECK_PREPARED_CLOSED(NULL);
+
+  if(!PyArg_ParseTuple(args, "|O:execute(bindings=None)", &bindings))
+    return NULL;
+
+  if(!bindings || bindings==Py_None)
+    bindings=self->bindings;
+
+  cursor=APSWPreparedStatement_getcursor(self);
+  if(!cursor)
+    return NULL;
+
+  cargs=bindings?PyTuple_Pack(2, (PyObject*)self, bindings):PyTuple_Pack(1, (PyObject*)self);
+  if(!cargs)
+    return NULL;
+  INUSE_CALL(res=APSWCursor_execute(cursor, cargs, NULL));
+  Py_DECREF(cargs);
+  return res;
+}
+
+/** .. method:: executemany(sequenceofbindings) -> Cursor
+
+  Executes the statement once for each item in *sequenceofbindings*
+  the same way as :meth:`Cursor.executemany`.  The returned cursor is
+  the same one used by :meth:`~PreparedStatement.execute`.
+*/
+static PyObject *
+APSWPreparedStatement_executemany(APSWPreparedStatement *self, PyObject *sequenceofbindings)
+{
+  PyObject *cargs;
+  APSWCursor *cursor;
+  PyObject *res;
+
+  CHECK_USE(NULL);
+  CHECK_PREPARED_CLOSED(NULL);
+
+  cursor=APSWPreparedStatement_getcursor(self);
+  if(!cursor)
+    return NULL;
+
+  cargs=PyTuple_Pack(2, (PyObject*)self, sequenceofbindings);
+  if(!cargs)
+    return NULL;
+  INUSE_CALL(res=APSWCursor_executemany(cursor, cargs));
+  Py_DECREF(cargs);
+  return res;
+}
+
+/** .. method:: close(force=False)
+
+  Releases the prepared statement.  It is okay to call this multiple
+  times.  If the cursor returned by :meth:`~PreparedStatement.execute`
+  has not finished the statement then the same exception as
+  :meth:`Cursor.close` is raised unless *force* is True.  While that
+  cursor is in use, such as being stepped in another thread,
+  :exc:`ThreadingViolationError` is raised even with *force*.
+
+  :param force: If False then pending work is an error.
+*/
+static PyObject *
+APSWPreparedStatement_close(APSWPreparedStatement *self, PyObject *args)
+{
+  int force=0;
+
+  CHECK_USE(NULL);
+
+  if(args && !PyArg_ParseTuple(args, "|i:close(force=False)", &force))
+    return NULL;
+
+  if(APSWPreparedStatement_close_internal(self, !!force))
+    return NULL;
+
+  Py_RETURN_NONE;
+}
+
+/** .. attribute:: sql
+
+  The text of the statement.
+*/
+static PyObject *
+APSWPreparedStatement_getsql(APSWPreparedStatement *self)
+{
+  CHECK_USE(NULL);
+  CHECK_PREPARED_CLOSED(NULL);
+  return convertutf8buffertounicode(self->statement->utf8);
+}
+
+static PyMethodDef APSWPreparedStatement_methods[]={
+  {"bind", (PyCFunction)APSWPreparedStatement_bind, METH_O,
+   "Sets bindings for execute"},
+  {"execute", (PyCFunction)APSWPreparedStatement_execute, METH_VARARGS,
+   "Executes the statement"},
+  {"executemany", (PyCFunction)APSWPreparedStatement_executemany, METH_O,
+   "Executes the statement repeatedly"},
+  {"close", (PyCFunction)APSWPreparedStatement_close, METH_VARARGS,
+   "Closes the prepared statement"},
+  {0,0,0,0} /* Sentinel */
+};
+
+static PyGetSetDef APSWPreparedStatement_getset[]={
+  {"sql", (getter)APSWPreparedStatement_getsql, NULL, "Statement text", NULL},
+  {NULL, NULL, NULL, NULL, NULL}
+};
+
+static PyTypeObject APSWPreparedStatementType = {
+    APSW_PYTYPE_INIT
+    "apsw.PreparedStatement",  /*tp_name*/
+    sizeof(APSWPreparedStatement), /*tp_basicsize*/
+    0,                         /*tp_itemsize*/
+    (destructor)APSWPreparedStatement_dealloc, /*tp_dealloc*/
+    0,                         /*tp_print*/
+    0,                         /*tp_getattr*/
+    0,                         /*tp_setattr*/
+    0,                         /*tp_compare*/
+    0,                         /*tp_repr*/
+    0,                         /*tp_as_number*/
+    0,                         /*tp_as_sequence*/
+    0,                         /*tp_as_mapping*/
+    0,                         /*tp_hash */
+    0,                         /*tp_call*/
+    0,                         /*tp_str*/
+    0,                         /*tp_getattro*/
+    0,                         /*tp_setattro*/
+    0,                         /*tp_as_buffer*/
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_VERSION_TAG, /*tp_flags*/
+    "APSW prepared statement object", /* tp_doc */
+    0,		               /* tp_traverse */
+    0,		               /* tp_clear */
+    0,		               /* tp_richcompare */
+    offsetof(APSWPreparedStatement, weakreflist), /* tp_weaklistoffset */
+    0,		               /* tp_iter */
+    0,		               /* tp_iternext */
+    APSWPreparedStatement_methods, /* tp_methods */
+    0,                         /* tp_members */
+    APSWPreparedStatement_getset, /* tp_getset */
+    0,                         /* tp_base */
+    0,                         /* tp_dict */
+    0,                         /* tp_descr_get */
+    0,                         /* tp_descr_set */
+    0,                         /* tp_dictoffset */
+    0,                         /* tp_init */
+    0,                         /* tp_alloc */
+    0,                         /* tp_new */
+    0,                         /* tp_free */
+    0,                         /* tp_is_gc */
+    0,                         /* tp_bases */
+    0,                         /* tp_mro */
+    0,                         /* tp_cache */
+    0,                         /* tp_subclasses */
+    0,                         /* tp_weaklist */
+    0                          /* tp_del */
+    APSW_PYTYPE_VERSION
+};
@@ -10,14 +10,21 @@
    was full. A doubly linked list is used to keep track of a
    least/most recent use. */
 
-/* The following keys are considered for a cache entry:
-
-   - The original text passed in (PyString/PyUnicode)
-   - The utf8 of the original text (APSWBuffer)
-   - The utf8 of the first statement (APSWBuffer)
-
-   Currently only the first two are implemented.
-
+/* The cache is an open addressing hash table (linear probing) keyed
+   on a hash of the utf8 bytes of the query.  The hash is stored in
+   the table alongside each entry so probing only compares the query
+   bytes when the hashes match.  Lookups do not allocate memory - str
+   queries use the utf8 representation Python keeps with the object.
+
+   The cache size is limited by both the number of entries and the
+   bytes used, which is the length of the query text plus the memory
+   SQLite reports the prepared statement using.  Both limits can be
+   changed at runtime.
+
+   There can be several instances of the same query in the cache, so
+   that nested or concurrent cursors running the same query can each
+   get a cached one.  They are treated like any other entry for lru
+   purposes.
  */
 
 /* Some defines */
@@ -27,41 +34,66 @@
    the interpreter gc intervals. */
 #define SC_NRECYCLE 32
 
-/* The maximum length of something in bytes that we would consider putting in the statement cache */
-#define SC_MAXSIZE 16384
+/* Default for the maximum bytes used by statements in the cache */
+#define SC_DEFAULT_MAXBYTES (16*1024*1024)
 
-/* Define to do statement cache statistics */
-/* #define SC_STATS */
+/* Default for the maximum number of cached instances of the same query */
+#define SC_DEFAULT_MAXINSTANCES 4
+
+/* The smallest hash table size.  Table sizes are always a power of two */
+#define SC_MINTABLESIZE 16
 
 typedef struct APSWStatement {
   PyObject_HEAD
   sqlite3_stmt *vdbestatement;      /* the sqlite level vdbe code */
   unsigned inuse;                   /* indicates an element is inuse when in cache preventing simultaneous use */
   unsigned incache;                 /* indicates APSWStatement resides in cache */
+  unsigned owned;                   /* belongs to a PreparedStatement so is never cached or recycled */
   PyObject *utf8;                   /* The text of the statement, also the key in the cache */
   PyObject *next;                   /* If not null, the utf8 text of the remaining statements in multi statement queries. */
   Py_ssize_t querylen;              /* How many bytes of utf8 made up the query (used for exectrace) */
-  PyObject *origquery;              /* The original query object, also a key in the cache pointing to this same statement - could be NULL */
+  size_t hash;                      /* hash of utf8 - only valid when incache */
+  Py_ssize_t cachebytes;            /* bytes counted against the cache limit - only valid when incache */
+  unsigned hits;                    /* how many times this was reused from the cache */
+  PyObject *rowtype;                /* Struct sequence type used for named rows - built on first use so usually NULL */
+  int rowtypencols;                 /* number of columns when rowtype was built */
+  int rowtypereprepares;            /* value of SQLITE_STMTSTATUS_REPREPARE when rowtype was built */
+  PyObject *paramnames;             /* Tuple of interned parameter names (None if unnamed) for dict bindings - built on first use so usually NULL */
+  struct APSWStatement *chainnext;  /* cached statement for the text in next - only set when both are in cache */
+  struct APSWStatement *chainprev;  /* cached statement whose chainnext is this one */
   struct APSWStatement *lru_prev;   /* previous item in lru list (ie more recently used than this one) */
   struct APSWStatement *lru_next;   /* next item in lru list (ie less recently used than this one) */
 } APSWStatement;
 
 static PyTypeObject APSWStatementType;
 
+/* PreparedStatement objects can be executed in place of query text */
+static PyTypeObject APSWPreparedStatementType;
+struct StatementCache;
+static APSWStatement *APSWPreparedStatement_acquire(struct StatementCache *sc, PyObject *prepared);
+
+typedef struct StatementCacheEntry {
+  size_t hash;                      /* hash of stmt->utf8 */
+  APSWStatement *stmt;              /* the cached statement or NULL if the slot is empty */
+} StatementCacheEntry;
 
 typedef struct StatementCache {
   sqlite3 *db;                      /* database connection */
-  PyObject *cache;                  /* the actual cache itself */
+  StatementCacheEntry *table;       /* the hash table - NULL when there is no cache */
+  size_t tablemask;                 /* table size minus one */
   unsigned numentries;              /* how many APSWStatement entries
                                        we have in cache */
   unsigned maxentries;              /* maximum number of entries */
+  Py_ssize_t numbytes;              /* bytes used by the entries */
+  Py_ssize_t maxbytes;              /* maximum bytes used by the entries */
+  unsigned maxinstances;            /* maximum entries with the same query */
   APSWStatement *mru;               /* most recently used entry (head of the list) */
   APSWStatement *lru;               /* least recently used entry (tail of the list) */
-#ifdef SC_STATS
-  unsigned st_cachemiss;            /* entry was not in cache */
-  unsigned st_cachehit;             /* entry was in cache */
-  unsigned st_hitinuse;             /* was a hit but was inuse */
-#endif
+  sqlite3_uint64 st_hits;           /* entry was in cache and reused */
+  sqlite3_uint64 st_misses;         /* entry was not in cache */
+  sqlite3_uint64 st_hitsinuse;      /* entry was in cache but inuse so another was prepared */
+  sqlite3_uint64 st_evictions;      /* entries evicted to meet the limits */
+  sqlite3_uint64 st_toobig;         /* statements not cached because they exceed maxbytes */
 #if SC_NRECYCLE > 0
   APSWStatement* recyclelist[SC_NRECYCLE];   /* recycle these rather than go through repeated malloc/free */
   unsigned nrecycle;                /* index of last entry in recycle list */
@@ -72,7 +104,8 @@ typedef struct StatementCache {
 static void
 statementcache_sanity_check(StatementCache *sc)
 {
-  unsigned itemcountfwd, itemcountbackwd, i;
+  unsigned itemcountfwd, itemcountbackwd, i, tablecount;
+  Py_ssize_t tablebytes;
   APSWStatement *last, *item;
 
 #if SC_NRECYCLE > 0
@@ -82,6 +115,30 @@ statementcache_sanity_check(StatementCache *sc)
   assert(sc->nrecycle<=SC_NRECYCLE);
 #endif
 
+  /* check the table agrees with the counts, and the load factor
+     leaves empty slots to terminate probing */
+  tablecount=0;
+  tablebytes=0;
+  if(sc->table)
+    {
+      size_t slot;
+      for(slot=0;slot<=sc->tablemask;slot++)
+        {
+          item=sc->table[slot].stmt;
+          if(!item)
+            continue;
+          assert(item->incache);
+          assert(item->hash==sc->table[slot].hash);
+          assert(!item->chainnext || (item->chainnext->incache && item->chainnext->chainprev==item));
+          assert(!item->chainprev || (item->chainprev->incache && item->chainprev->chainnext==item));
+          tablecount++;
+          tablebytes+=item->cachebytes;
+        }
+      assert(tablecount<=sc->tablemask);
+    }
+  assert(tablecount==sc->numentries);
+  assert(tablebytes==sc->numbytes);
+
   /* make sure everything is fine */
   if(!sc->mru || !sc->lru)
     {
@@ -128,6 +185,7 @@ statementcache_sanity_check(StatementCache *sc)
       item=item->lru_next;
     }
   assert(sc->lru==last);
+  assert(itemcountfwd<=tablecount);
 
   /* check items going backwards */
   last=NULL;
@@ -153,20 +211,275 @@ statementcache_sanity_check(StatementCache *sc)
   /* count should be same going forwards as going back */
   assert(itemcountbackwd==itemcountfwd);
 }
+#else
+#define statementcache_sanity_check(x)
+#endif
 
-/* verifies a particular value is not in the dictionary */
-static void assert_not_in_dict(PyObject *dict, PyObject *check)
+/* Hash of query text.  It is computed on every lookup so eight bytes
+   are mixed in at a time. */
+static size_t
+statementcache_hash(const char *data, Py_ssize_t len)
 {
-  PyObject *key, *value;
-  Py_ssize_t pos=0;
+  sqlite3_uint64 h=0x9e3779b97f4a7c15ULL^(sqlite3_uint64)len, v;
 
-  while(PyDict_Next(dict, &pos, &key, &value))
-    assert(check!=value);
+  while(len>=8)
+    {
+      memcpy(&v, data, 8);
+      h=(h^v)*0xff51afd7ed558ccdULL;
+      h^=h>>32;
+      data+=8;
+      len-=8;
+    }
+  if(len)
+    {
+      v=0;
+      memcpy(&v, data, len);
+      h=(h^v)*0xff51afd7ed558ccdULL;
+    }
+  h^=h>>33;
+  h*=0xc4ceb9fe1a85ec53ULL;
+  h^=h>>33;
+  return (size_t)h;
 }
-#else
-#define statementcache_sanity_check(x)
-#define assert_not_in_dict(x,y)
+
+/* Returns a cached statement with this utf8 text that is not in use
+   (borrowed reference) or NULL, and sets ninstances to how many are
+   cached including those in use.  There is always at least one empty
+   slot so probing terminates. */
+static APSWStatement *
+statementcache_lookup(StatementCache *sc, const char *utf8, Py_ssize_t len, size_t hash, unsigned *ninstances)
+{
+  size_t slot;
+  APSWStatement *found=NULL;
+
+  *ninstances=0;
+  for(slot=hash&sc->tablemask; sc->table[slot].stmt; slot=(slot+1)&sc->tablemask)
+    {
+      APSWStatement *stmt=sc->table[slot].stmt;
+      if(sc->table[slot].hash==hash && APSWBuffer_GET_SIZE(stmt->utf8)==len
+         && !memcmp(APSWBuffer_AS_STRING(stmt->utf8), utf8, len))
+        {
+          (*ninstances)++;
+          if(!found && !stmt->inuse)
+            found=stmt;
+        }
+    }
+  return found;
+}
+
+/* Puts stmt in the first free slot for its hash */
+static void
+statementcache_table_add(StatementCache *sc, APSWStatement *stmt)
+{
+  size_t slot;
+
+  for(slot=stmt->hash&sc->tablemask; sc->table[slot].stmt; slot=(slot+1)&sc->tablemask);
+  sc->table[slot].hash=stmt->hash;
+  sc->table[slot].stmt=stmt;
+}
+
+/* Takes stmt out of the table.  Following entries are shifted back
+   so there is no need for deleted markers. */
+static void
+statementcache_table_remove(StatementCache *sc, APSWStatement *stmt)
+{
+  size_t slot, next, home;
+
+  for(slot=stmt->hash&sc->tablemask; sc->table[slot].stmt!=stmt; slot=(slot+1)&sc->tablemask)
+    assert(sc->table[slot].stmt);
+
+  for(next=(slot+1)&sc->tablemask; sc->table[next].stmt; next=(next+1)&sc->tablemask)
+    {
+      home=sc->table[next].hash&sc->tablemask;
+      /* the entry can't move if its home slot is cyclically in (slot, next] */
+      if( (slot<next) ? (slot<home && home<=next) : (slot<home || home<=next) )
+        continue;
+      sc->table[slot]=sc->table[next];
+      slot=next;
+    }
+  sc->table[slot].stmt=NULL;
+}
+
+/* Makes the table big enough for nentries at a load factor of at most
+   one half.  Returns 0 on success or -1 with an exception set. */
+static int
+statementcache_resize(StatementCache *sc, unsigned nentries)
+{
+  size_t size=SC_MINTABLESIZE, oldsize, slot;
+  StatementCacheEntry *old=sc->table;
+
+  assert(nentries>=sc->numentries);
+
+  while(size<2*(size_t)nentries)
+    size*=2;
+  if(old && size==sc->tablemask+1)
+    return 0;
+
+  sc->table=PyMem_Malloc(sizeof(StatementCacheEntry)*size);
+  if(!sc->table)
+    {
+      sc->table=old;
+      PyErr_NoMemory();
+      return -1;
+    }
+  memset(sc->table, 0, sizeof(StatementCacheEntry)*size);
+  oldsize=old?sc->tablemask+1:0;
+  sc->tablemask=size-1;
+  for(slot=0;slot<oldsize;slot++)
+    if(old[slot].stmt)
+      statementcache_table_add(sc, old[slot].stmt);
+  PyMem_Free(old);
+  return 0;
+}
+
+/* Consumes the reference to a statement that is not in the cache,
+   keeping it for reuse if there is space and nothing else (such as a
+   cursor for scanstatus) has a reference */
+static void
+statementcache_recycle(StatementCache *sc, APSWStatement *stmt)
+{
+  assert(!stmt->incache);
+  assert(!stmt->inuse);
+#if SC_NRECYCLE > 0
+  if(sc->nrecycle<SC_NRECYCLE && Py_REFCNT(stmt)==1)
+    {
+      sc->recyclelist[sc->nrecycle++]=stmt;
+      return;
+    }
+#endif
+  Py_DECREF(stmt);
+}
+
+/* Takes stmt out of the cache (but not the lru list).  The reference
+   the cache held now belongs to the caller. */
+static void
+statementcache_remove(StatementCache *sc, APSWStatement *stmt)
+{
+  assert(stmt->incache);
+  statementcache_table_remove(sc, stmt);
+  if(stmt->chainnext)
+    stmt->chainnext->chainprev=NULL;
+  if(stmt->chainprev)
+    stmt->chainprev->chainnext=NULL;
+  stmt->chainnext=stmt->chainprev=NULL;
+  stmt->incache=0;
+  sc->numentries -= 1;
+  sc->numbytes -= stmt->cachebytes;
+}
+
+/* Adds stmt to the cache unless it is too big, or there are already
+   the maximum instances of the query */
+static void
+statementcache_add(StatementCache *sc, APSWStatement *stmt)
+{
+  const char *buffer=APSWBuffer_AS_STRING(stmt->utf8);
+  Py_ssize_t buflen=APSWBuffer_GET_SIZE(stmt->utf8), cost=buflen;
+  size_t hash;
+  unsigned ninstances;
+
+  assert(!stmt->incache);
+  assert(sc->maxentries && sc->table);
+
+#ifdef SQLITE_STMTSTATUS_MEMUSED
+  {
+    int memused;
+    _PYSQLITE_CALL_V(memused=sqlite3_stmt_status(stmt->vdbestatement, SQLITE_STMTSTATUS_MEMUSED, 0));
+    cost+=memused;
+  }
 #endif
+  if(cost>sc->maxbytes)
+    {
+      sc->st_toobig++;
+      return;
+    }
+
+  hash=statementcache_hash(buffer, buflen);
+  statementcache_lookup(sc, buffer, buflen, hash, &ninstances);
+  if(ninstances>=sc->maxinstances)
+    return;
+
+  /* in use entries can take us over maxentries so grow if the table
+     gets more than three quarters full */
+  if(4*((size_t)sc->numentries+1)>3*(sc->tablemask+1) && statementcache_resize(sc, sc->numentries+1))
+    {
+      PyErr_Clear();
+      return;
+    }
+
+  stmt->hash=hash;
+  stmt->cachebytes=cost;
+  statementcache_table_add(sc, stmt);
+  Py_INCREF(stmt);
+  stmt->incache=1;
+  sc->numentries += 1;
+  sc->numbytes += cost;
+}
+
+/* Evicts least recently used entries until the cache is within its
+   limits.  In use entries are not on the lru list so are never
+   evicted. */
+static void
+statementcache_evict(StatementCache *sc)
+{
+  while((sc->numentries>sc->maxentries || sc->numbytes>sc->maxbytes) && sc->lru)
+    {
+      APSWStatement *evictee=sc->lru;
+
+      assert(!evictee->inuse);
+      assert(!evictee->lru_next);
+      sc->lru=evictee->lru_prev;
+      if(sc->lru)
+        sc->lru->lru_next=NULL;
+      else
+        sc->mru=NULL;
+      evictee->lru_prev=NULL;
+
+      statementcache_remove(sc, evictee);
+      sc->st_evictions++;
+      /* only reference should have been the cache */
+      statementcache_recycle(sc, evictee);
+      statementcache_sanity_check(sc);
+    }
+}
+
+/* Changes the limits, evicting entries to fit.  Zero entries turns
+   off caching.  Extra instances beyond a reduced maxinstances are left
+   for lru eviction.  Returns 0 on success or -1 with an exception
+   set. */
+static int
+statementcache_setlimits(StatementCache *sc, unsigned maxentries, Py_ssize_t maxbytes, unsigned maxinstances)
+{
+  unsigned needed;
+
+  assert(maxinstances>0);
+  sc->maxentries=maxentries;
+  sc->maxbytes=maxbytes;
+  sc->maxinstances=maxinstances;
+  statementcache_evict(sc);
+
+  needed=(maxentries>sc->numentries)?maxentries:sc->numentries;
+  if(!needed)
+    {
+      PyMem_Free(sc->table);
+      sc->table=NULL;
+      sc->tablemask=0;
+      return 0;
+    }
+  if(statementcache_resize(sc, needed))
+    {
+      /* an existing table is still usable as statementcache_add
+         grows it when needed */
+      if(sc->table)
+        {
+          PyErr_Clear();
+          return 0;
+        }
+      sc->maxentries=0;
+      return -1;
+    }
+  statementcache_sanity_check(sc);
+  return 0;
+}
 
 
 /* re-prepare for SQLITE_SCHEMA */
@@ -202,6 +515,8 @@ statementcache_reprepare(StatementCache *sc, APSWStatement *statement)
 
   PYSQLITE_SC_CALL(sqlite3_finalize(statement->vdbestatement));
   statement->vdbestatement=newvdbe;
+  /* the columns may be different now */
+  Py_CLEAR(statement->rowtype);
   return SQLITE_OK;
 
  error:
@@ -217,6 +532,52 @@ statementcache_reprepare(StatementCache *sc, APSWStatement *statement)
 }
 
 /* Internal prepare routine after doing utf8 conversion.  Returns a new reference. Must be reentrant */
+/* Marks a cached statement that isn't in use as in use, returning a
+   new reference to it */
+static APSWStatement *
+statementcache_claim(StatementCache *sc, APSWStatement *val)
+{
+  assert(val->incache);
+  assert(!val->inuse);
+  assert(val->vdbestatement);
+  val->inuse=1;
+  val->hits++;
+  sc->st_hits++;
+
+  /* unlink from lru tracking */
+  if(sc->mru==val)
+    sc->mru=val->lru_next;
+  if(sc->lru==val)
+    sc->lru=val->lru_prev;
+  if(val->lru_prev)
+    {
+      assert(val->lru_prev->lru_next==val);
+      val->lru_prev->lru_next=val->lru_next;
+    }
+  if(val->lru_next)
+    {
+      assert(val->lru_next->lru_prev==val);
+      val->lru_next->lru_prev=val->lru_prev;
+    }
+  val->lru_prev=val->lru_next=0;
+  statementcache_sanity_check(sc);
+
+  _PYSQLITE_CALL_V(sqlite3_clear_bindings(val->vdbestatement));
+  Py_INCREF( (PyObject*)val);
+  return val;
+}
+
+/* Makes a statement with every field after the object header zeroed */
+static APSWStatement *
+statementcache_newstatement(void)
+{
+  APSWStatement *val=PyObject_New(APSWStatement, &APSWStatementType);
+
+  if(val)
+    memset((char*)val+sizeof(PyObject), 0, sizeof(APSWStatement)-sizeof(PyObject));
+  return val;
+}
+
 static APSWStatement*
 statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
 {
@@ -225,107 +586,70 @@ statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
   const char *tail;
   Py_ssize_t buflen;
   int res;
+  unsigned ninstances=0;
   PyObject *utf8=NULL;
+  PyObject *owner=NULL;
 
-  if(!APSWBuffer_Check(query))
-    {
-      /* Check to see if query is already in cache.  The size checks are to
-         avoid calculating hashes on long strings */
-      if( sc->cache && sc->numentries && ((PyUnicode_CheckExact(query) && PyUnicode_GET_DATA_SIZE(query) < SC_MAXSIZE)
-#if PY_MAJOR_VERSION < 3
-          || (PyString_CheckExact(query) && PyString_GET_SIZE(query) < SC_MAXSIZE)
-#endif
-                        ))
-        {
-          val=(APSWStatement*)PyDict_GetItem(sc->cache, query);
-          if(val)
-            {
-              utf8=val->utf8;
-              Py_INCREF(utf8);
-              goto cachehit;
-            }
-        }
-
-      utf8=getutf8string(query);
+  if(Py_TYPE(query)==&APSWPreparedStatementType)
+    return APSWPreparedStatement_acquire(sc, query);
 
-      if(!utf8)
+  /* get at the utf8 bytes without copying where possible */
+  if(APSWBuffer_Check(query))
+    {
+      buffer=APSWBuffer_AS_STRING(query);
+      buflen=APSWBuffer_GET_SIZE(query);
+    }
+#if PY_VERSION_HEX >= 0x03030000
+  else if(PyUnicode_CheckExact(query))
+    {
+      buffer=PyUnicode_AsUTF8AndSize(query, &buflen);
+      if(!buffer)
         return NULL;
-
-      {
-        /* Make a buffer of utf8 which then owns underlying bytes */
-        PyObject *tmp=APSWBuffer_FromObject(utf8, 0, PyBytes_GET_SIZE(utf8));
-        Py_DECREF(utf8);
-        if(!tmp) return NULL;
-        utf8=tmp;
-      }
     }
+#endif
   else
     {
-      utf8=query;
-      query=NULL;
-      Py_INCREF(utf8);
+      owner=getutf8string(query);
+      if(!owner)
+        return NULL;
+      buffer=PyBytes_AS_STRING(owner);
+      buflen=PyBytes_GET_SIZE(owner);
     }
 
-  assert(APSWBuffer_Check(utf8));
+  if(sc->maxentries && buflen<=sc->maxbytes)
+    val=statementcache_lookup(sc, buffer, buflen, statementcache_hash(buffer, buflen), &ninstances);
 
-  /* if we have cache and utf8 is reasonable size? */
-  if(sc->cache && sc->numentries && APSWBuffer_GET_SIZE(utf8) < SC_MAXSIZE)
+  if(val)
     {
-      /* then is it in the cache? */
-      val=(APSWStatement*)PyDict_GetItem(sc->cache, utf8);
+      /* yay, one we can use */
+      Py_XDECREF(owner);
+      return statementcache_claim(sc, val);
     }
 
-  /* by this point we have created utf8 or added a reference to it */
- cachehit:
-  assert(APSWBuffer_Check(utf8));
+  /* are all the cached instances in use by someone else? */
+  if(ninstances)
+    sc->st_hitsinuse++;
+  else
+    sc->st_misses++;
 
-#ifdef SC_STATS
-  if(val)
+  /* we need an APSWBuffer which owns the underlying bytes */
+  if(APSWBuffer_Check(query))
     {
-      sc->st_cachehit++;
-      if(val->inuse)
-        sc->st_hitinuse++;
+      utf8=query;
+      Py_INCREF(utf8);
     }
   else
-    sc->st_cachemiss++;
-#endif
-
-
-  if(val)
     {
-      if(!val->inuse)
+      if(!owner)
         {
-          /* yay, one we can use */
-          assert(val->incache);
-          assert(val->vdbestatement);
-          val->inuse=1;
-
-          /* unlink from lru tracking */
-          if(sc->mru==val)
-            sc->mru=val->lru_next;
-          if(sc->lru==val)
-            sc->lru=val->lru_prev;
-          if(val->lru_prev)
-            {
-              assert(val->lru_prev->lru_next==val);
-              val->lru_prev->lru_next=val->lru_next;
-            }
-          if(val->lru_next)
-            {
-              assert(val->lru_next->lru_prev==val);
-              val->lru_next->lru_prev=val->lru_prev;
-            }
-          val->lru_prev=val->lru_next=0;
-          statementcache_sanity_check(sc);
-
-          _PYSQLITE_CALL_V(sqlite3_clear_bindings(val->vdbestatement));
-          Py_INCREF( (PyObject*)val);
-          assert(PyObject_RichCompareBool(utf8, val->utf8, Py_EQ)==1);
-          APSWBuffer_XDECREF_unlikely(utf8);
-          return val;
+          owner=PyBytes_FromStringAndSize(buffer, buflen);
+          if(!owner)
+            return NULL;
         }
-      /* someone else is using it so we can't */
-      val=NULL;
+      utf8=APSWBuffer_FromObject(owner, 0, buflen);
+      Py_DECREF(owner);
+      if(!utf8)
+        return NULL;
     }
 
 #if SC_NRECYCLE > 0
@@ -339,7 +663,9 @@ statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
         _PYSQLITE_CALL_V(sqlite3_finalize(val->vdbestatement));
       APSWBuffer_XDECREF_likely(val->utf8);
       APSWBuffer_XDECREF_unlikely(val->next);
-      Py_XDECREF(val->origquery);
+      Py_CLEAR(val->rowtype);
+      Py_CLEAR(val->paramnames);
+      assert(!val->chainnext && !val->chainprev);
       val->lru_prev=val->lru_next=0;
       statementcache_sanity_check(sc);
     }
@@ -349,13 +675,13 @@ statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
 
   if(!val)
     {
-      /* have to make one */
-      val=PyObject_New(APSWStatement, &APSWStatementType);
-      if(!val) goto error;
-      /* zero it - other fields are set below */
-      val->incache=0;
-      val->lru_prev=0;
-      val->lru_next=0;
+      /* have to make one - other fields are set below */
+      val=statementcache_newstatement();
+      if(!val)
+        {
+          APSWBuffer_XDECREF_likely(utf8);
+          return NULL;
+        }
     }
 
   statementcache_sanity_check(sc);
@@ -364,8 +690,7 @@ statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
   val->next=NULL;
   val->vdbestatement=NULL;
   val->inuse=1;
-  Py_XINCREF(query);
-  val->origquery=query;
+  val->hits=0;
 
   buffer=APSWBuffer_AS_STRING(utf8);
   buflen=APSWBuffer_GET_SIZE(utf8);
@@ -400,23 +725,13 @@ statementcache_prepare(StatementCache *sc, PyObject *query, int usepreparev2)
   return val;
 
  error:
-  if(val)
-    {
-      val->inuse=0;
-#if SC_NRECYCLE > 0
-      if(sc->nrecycle<SC_NRECYCLE)
-        {
-          sc->recyclelist[sc->nrecycle++]=val;
-        }
-      else
-#endif
-        /* Getting this line to execute is hard as the statement would
-           have come from the recyclelist in the first place so there
-           will be a spot to return it to.  The only way to do it
-           would be some violent threading to refill the recyclelist
-           between this statement being taken out and returned */
-        Py_DECREF(val);
-    }
+  val->inuse=0;
+  /* Getting this to not recycle is hard as the statement would have
+     come from the recyclelist in the first place so there will be a
+     spot to return it to.  The only way to do it would be some
+     violent threading to refill the recyclelist between this
+     statement being taken out and returned */
+  statementcache_recycle(sc, val);
   return NULL;
 }
 
@@ -430,8 +745,6 @@ statementcache_finalize(StatementCache *sc, APSWStatement *stmt, int reprepare_o
 {
   int res;
 
-  /* PyDict_Contains will end up whining in comparison function if
-     there is an existing exception hanging over our head */
   assert(!PyErr_Occurred());
 
   statementcache_sanity_check(sc);
@@ -443,6 +756,15 @@ statementcache_finalize(StatementCache *sc, APSWStatement *stmt, int reprepare_o
      middle of disposing of */
 
   PYSQLITE_SC_CALL(res=sqlite3_reset(stmt->vdbestatement));
+
+  if(stmt->owned)
+    {
+      /* the PreparedStatement keeps it */
+      stmt->inuse=0;
+      Py_DECREF(stmt);
+      return res;
+    }
+
   if(res==SQLITE_SCHEMA && reprepare_on_schema)
     {
       res=statementcache_reprepare(sc, stmt);
@@ -451,152 +773,164 @@ statementcache_finalize(StatementCache *sc, APSWStatement *stmt, int reprepare_o
     }
 
   /* is it going to be put in cache? */
-  if(stmt->incache || (sc->cache && stmt->vdbestatement && APSWBuffer_GET_SIZE(stmt->utf8) < SC_MAXSIZE && !PyDict_Contains(sc->cache, stmt->utf8)))
+  if(!stmt->incache && sc->maxentries && stmt->vdbestatement)
+    statementcache_add(sc, stmt);
+
+  if(stmt->incache)
     {
-      /* add ourselves to cache */
-      if(!stmt->incache)
+      /* do we need to do an evict? */
+      statementcache_evict(sc);
+
+      if(sc->numentries > sc->maxentries || sc->numbytes > sc->maxbytes)
         {
-          assert(!PyDict_Contains(sc->cache, stmt->utf8));
-          assert_not_in_dict(sc->cache, (PyObject*)stmt);
-          PyDict_SetItem(sc->cache, stmt->utf8, (PyObject*)stmt);
-          if(stmt->origquery)
-            /* something equal to this query may already be in cache
-               which would cause an eviction of an unrelated item and
-               all sorts of grief */
-            if (!PyDict_Contains(sc->cache, stmt->origquery))
-                PyDict_SetItem(sc->cache, stmt->origquery, (PyObject*)stmt);
-          stmt->incache=1;
-          sc->numentries += 1;
+          /* only happens when the limits were reduced while we were
+             in use, so we have to go too */
+          statementcache_remove(sc, stmt);
+          sc->st_evictions++;
+          Py_DECREF(stmt);
         }
-
-      assert(PyDict_Contains(sc->cache, stmt->utf8));
-
-      /* do we need to do an evict? */
-      while(sc->numentries > sc->maxentries)
+      else
         {
-          APSWStatement *evictee=sc->lru;
-          statementcache_sanity_check(sc);
-          assert(evictee!=stmt);      /* we were inuse and so should not be on evict list */
-
-          /* no possibles to evict? */
+          /* plumb ourselves into head of lru list */
+          stmt->lru_next=sc->mru;
+          stmt->lru_prev=NULL;
+          if(sc->mru)
+            sc->mru->lru_prev=stmt;
+          sc->mru=stmt;
           if(!sc->lru)
-            break;
-
-          /* only entry? */
-          if(!evictee->lru_prev)
-            {
-              assert(sc->mru==evictee);   /* points to sole entry */
-              assert(sc->lru==evictee);   /* points to sole entry */
-              assert(!evictee->lru_prev); /* should be anyone before */
-              assert(!evictee->lru_next); /* or after */
-              sc->mru=NULL;
-              sc->lru=NULL;
-              goto delevictee;
-            }
-          /* take out lru member */
-          sc->lru=evictee->lru_prev;
-          assert(sc->lru->lru_next==evictee);
-          sc->lru->lru_next=NULL;
-
-        delevictee:
-          assert(!evictee->inuse);
-          assert(evictee->incache);
-          statementcache_sanity_check(sc);
+            sc->lru=stmt;
+        }
+    }
 
-          /* only references should be the dict */
-          assert(Py_REFCNT(evictee)==1+!!evictee->origquery);
+  stmt->inuse=0;
+  statementcache_sanity_check(sc);
+  if(stmt->incache)
+    Py_DECREF(stmt);
+  else
+    statementcache_recycle(sc, stmt);
+  return res;
+}
 
-#if SC_NRECYCLE > 0
-          /* we don't gc to run on object */
-          Py_INCREF(evictee);
-#endif
-          if(evictee->origquery)
-            {
-              assert(evictee==(APSWStatement*)PyDict_GetItem(sc->cache, evictee->origquery));
-              PyDict_DelItem(sc->cache, evictee->origquery);
-              Py_DECREF(evictee->origquery);
-              evictee->origquery=NULL;
-            }
-          assert(evictee==(APSWStatement*)PyDict_GetItem(sc->cache, evictee->utf8));
-          PyDict_DelItem(sc->cache, evictee->utf8);
-          assert_not_in_dict(sc->cache, (PyObject*)evictee);
-          assert(!PyErr_Occurred());
 
-#if SC_NRECYCLE > 0
-          if(sc->nrecycle<SC_NRECYCLE)
-            {
-              assert(Py_REFCNT(evictee)==1);
-              sc->recyclelist[sc->nrecycle++]=evictee;
-              evictee->incache=0;
-            }
-          else
-            {
-              Py_DECREF(evictee);
-            }
-#endif
-          sc->numentries -= 1;
-          statementcache_sanity_check(sc);
-        }
+/* Prepares a single statement for a PreparedStatement.  It isn't
+   cached or recycled, and inuse is clear.  persistent means
+   SQLITE_PREPARE_PERSISTENT which tells SQLite the statement will be
+   kept and reused a lot.  Returns a new reference. */
+static APSWStatement *
+statementcache_prepare_owned(StatementCache *sc, PyObject *query, int persistent)
+{
+  APSWStatement *val;
+  PyObject *utf8, *tmp;
+  const char *buffer, *tail;
+  Py_ssize_t buflen;
+  int res;
 
-      statementcache_sanity_check(sc);
+  tmp=getutf8string(query);
+  if(!tmp)
+    return NULL;
+  utf8=APSWBuffer_FromObject(tmp, 0, PyBytes_GET_SIZE(tmp));
+  Py_DECREF(tmp);
+  if(!utf8)
+    return NULL;
 
-      /* plumb ourselves into head of lru list */
-      assert(stmt->inuse);
-      stmt->inuse=0;
-      stmt->lru_next=sc->mru;
-      stmt->lru_prev=NULL;
-      if(sc->mru)
-        sc->mru->lru_prev=stmt;
-      sc->mru=stmt;
-      if(!sc->lru)
-        sc->lru=stmt;
-      statementcache_sanity_check(sc);
+  val=statementcache_newstatement();
+  if(!val)
+    {
+      APSWBuffer_XDECREF_likely(utf8);
+      return NULL;
     }
+  val->owned=1;
+  val->utf8=utf8;
 
-  stmt->inuse=0;
-#if SC_NRECYCLE > 0
-  if(!stmt->incache && sc->nrecycle<SC_NRECYCLE)
+  buffer=APSWBuffer_AS_STRING(utf8);
+  buflen=APSWBuffer_GET_SIZE(utf8);
+  /* see statementcache_prepare */
+  assert(buffer[buflen+1-1]==0);
+#if SQLITE_VERSION_NUMBER >= 3020000
+  PYSQLITE_SC_CALL(res=sqlite3_prepare_v3(sc->db, buffer, buflen+1, persistent?SQLITE_PREPARE_PERSISTENT:0, &val->vdbestatement, &tail));
+#else
+  (void)persistent;
+  PYSQLITE_SC_CALL(res=sqlite3_prepare_v2(sc->db, buffer, buflen+1, &val->vdbestatement, &tail));
+#endif
+
+  if(res!=SQLITE_OK || PyErr_Occurred())
     {
-      assert(Py_REFCNT(stmt)==1);
-      sc->recyclelist[sc->nrecycle++]=stmt;
+      SET_EXC(res, sc->db);
+      AddTraceBackHere(__FILE__, __LINE__, "sqlite3_prepare", "{s: N}", "sql", convertutf8stringsize(buffer, buflen));
+      Py_DECREF(val);
+      return NULL;
     }
-  else
-#endif
+
+  val->querylen=tail-buffer;
+  while( (tail-buffer<buflen) && (*tail==' ' || *tail=='\t' || *tail==';' || *tail=='\r' || *tail=='\n') )
+    tail++;
+  if(tail-buffer<buflen)
     {
-      Py_DECREF(stmt);
+      PyErr_Format(PyExc_ValueError, "Only one statement can be prepared - there is more text after it");
+      Py_DECREF(val);
+      return NULL;
     }
-  return res;
+  return val;
 }
 
 
 /* returns SQLITE_OK on success.  ppstmt will be next statement on
    success else null on error.  reference will be consumed on ppstmt
-   passed in and new reference on one returned */
+   passed in and new reference on one returned.
+
+   Scripts with multiple statements are cached as a chain.  When the
+   statement and the one for its remaining text are both in the cache
+   they are linked, so running the script again goes straight to each
+   following statement without hashing and looking up the remaining
+   text. */
 static int
 statementcache_next(StatementCache *sc, APSWStatement **ppstmt, int usepreparev2)
 {
-  PyObject *next=(*ppstmt)->next;
+  APSWStatement *stmt=*ppstmt, *nextstmt=stmt->chainnext;
+  PyObject *etype, *evalue, *etraceback;
   int res;
 
-  assert(next);
-  Py_INCREF(next);
+  assert(stmt->next);
+
+  /* The next statement is obtained before the current one is
+     finalized so that we still have it to link to */
+  if(nextstmt && !nextstmt->inuse)
+    nextstmt=statementcache_claim(sc, nextstmt);
+  else
+    {
+      /* statementcache_prepare already sets exception */
+      nextstmt=statementcache_prepare(sc, stmt->next, usepreparev2);  /* INUSE_CALL not needed here */
+      if(nextstmt && stmt->incache && nextstmt->incache && stmt->chainnext!=nextstmt)
+        {
+          if(stmt->chainnext)
+            stmt->chainnext->chainprev=NULL;
+          if(nextstmt->chainprev)
+            nextstmt->chainprev->chainnext=NULL;
+          stmt->chainnext=nextstmt;
+          nextstmt->chainprev=stmt;
+          statementcache_sanity_check(sc);
+        }
+    }
 
-  res=statementcache_finalize(sc, *ppstmt, 0); /* INUSE_CALL not needed here */
+  PyErr_Fetch(&etype, &evalue, &etraceback);
+  res=statementcache_finalize(sc, stmt, 0); /* INUSE_CALL not needed here */
+  PyErr_Restore(etype, evalue, etraceback);
 
   /* defensive coding.  res will never be an error as errors would
      have been returned from earlier step call */
 
   assert(res==SQLITE_OK);
 
-  if(res!=SQLITE_OK) goto error;
+  if(res==SQLITE_OK && !nextstmt)
+    res=SQLITE_ERROR;
 
-  /* statementcache_prepare already sets exception */
-  *ppstmt=statementcache_prepare(sc, next, usepreparev2);  /* INUSE_CALL not needed here */
-  res=(*ppstmt)?SQLITE_OK:SQLITE_ERROR;
-
- error:
-  APSWBuffer_XDECREF_unlikely(next);
+  if(res!=SQLITE_OK && nextstmt)
+    {
+      statementcache_finalize(sc, nextstmt, 0); /* INUSE_CALL not needed here */
+      nextstmt=NULL;
+    }
 
+  *ppstmt=nextstmt;
   return res;
 }
 
@@ -606,23 +940,26 @@ static StatementCache*
 statementcache_init(sqlite3 *db, unsigned nentries)
 {
   StatementCache *sc=(StatementCache*)PyMem_Malloc(sizeof(StatementCache));
+  int res=0;
   if(!sc) return NULL;
 
   memset(sc, 0, sizeof(StatementCache));
   sc->db=db;
-  /* sc->cache is left as null if we aren't caching */
+  /* sc->table is left as null if we aren't caching */
   if (nentries)
     {
       APSW_FAULT_INJECT(StatementCacheAllocFails,
-                        sc->cache=PyDict_New(),
-                        sc->cache=PyErr_NoMemory());
-      if(!sc->cache)
+                        res=statementcache_resize(sc, nentries),
+                        (PyErr_NoMemory(), res=-1));
+      if(res)
         {
           PyMem_Free(sc);
           return NULL;
         }
     }
   sc->maxentries=nentries;
+  sc->maxbytes=SC_DEFAULT_MAXBYTES;
+  sc->maxinstances=SC_DEFAULT_MAXINSTANCES;
   sc->mru=NULL;
   sc->lru=NULL;
 #if SC_NRECYCLE > 0
@@ -641,12 +978,19 @@ statementcache_free(StatementCache *sc)
       Py_DECREF(o);
     }
 #endif
-  Py_XDECREF(sc->cache);
+  if(sc->table)
+    {
+      size_t slot;
+      for(slot=0;slot<=sc->tablemask;slot++)
+        if(sc->table[slot].stmt)
+          {
+            sc->table[slot].stmt->incache=0;
+            sc->table[slot].stmt->chainnext=sc->table[slot].stmt->chainprev=NULL;
+            Py_DECREF(sc->table[slot].stmt);
+          }
+      PyMem_Free(sc->table);
+    }
   PyMem_Free(sc);
-
-#ifdef SC_STATS
-  fprintf(stderr, "SC Miss: %u Hit: %u HitButInuse: %u\n", sc->st_cachemiss, sc->st_cachehit, sc->st_hitinuse);
-#endif
 }
 
 static void
@@ -657,10 +1001,207 @@ APSWStatement_dealloc(APSWStatement *stmt)
   assert(stmt->inuse==0);
   APSWBuffer_XDECREF_likely(stmt->utf8);
   APSWBuffer_XDECREF_likely(stmt->next);
-  Py_XDECREF(stmt->origquery);
+  Py_XDECREF(stmt->rowtype);
+  Py_XDECREF(stmt->paramnames);
   Py_TYPE(stmt)->tp_free((PyObject*)stmt);
 }
 
+/* Builds stmt->paramnames which has an entry for each parameter with
+   the name without its leading : $ or @ as used for dict bindings.
+   The names are interned so dictionary lookups are quick.  They come
+   from the SQL text so don't change if the statement is reprepared.
+   Returns a borrowed reference. */
+static PyObject *
+statementcache_paramnames(APSWStatement *stmt)
+{
+  int nargs, arg;
+  PyObject *names;
+
+  assert(!stmt->paramnames);
+
+  nargs=sqlite3_bind_parameter_count(stmt->vdbestatement);
+  names=PyTuple_New(nargs);
+  if(!names)
+    return NULL;
+
+  for(arg=1;arg<=nargs;arg++)
+    {
+      const char *param;
+      PyObject *name;
+
+      _PYSQLITE_CALL_V(param=sqlite3_bind_parameter_name(stmt->vdbestatement, arg));
+      if(!param)
+        {
+          name=Py_None;
+          Py_INCREF(name);
+        }
+      else
+        {
+          assert(*param==':' || *param=='$' || *param=='@');
+#if PY_MAJOR_VERSION >= 3
+          name=PyUnicode_InternFromString(param+1);
+#else
+          name=PyUnicode_DecodeUTF8(param+1, strlen(param+1), NULL);
+#endif
+          if(!name)
+            {
+              Py_DECREF(names);
+              return NULL;
+            }
+        }
+      PyTuple_SET_ITEM(names, arg-1, name);
+    }
+
+  stmt->paramnames=names;
+  return names;
+}
+
+#if PY_VERSION_HEX >= 0x03030000
+/* Returns true if name can't be used for a field because the struct
+   sequence type already has an attribute with that name, or it would
+   replace a special method */
+static int
+statementcache_rowtype_reserved(const char *name)
+{
+  size_t len=strlen(name);
+
+  return !strcmp(name, "n_fields") || !strcmp(name, "n_sequence_fields") || !strcmp(name, "n_unnamed_fields")
+    || !strcmp(name, "_fields") || (len>4 && !strncmp(name, "__", 2) && !strcmp(name+len-2, "__"));
+}
+
+/* Returns a new reference to a field name for colname that isn't
+   reserved or already used, appending _1, _2 etc if necessary */
+static PyObject *
+statementcache_rowtype_name(const char *colname, PyObject *used)
+{
+  PyObject *name;
+  int suffix, found;
+
+  for(suffix=0;;suffix++)
+    {
+      if(!suffix && statementcache_rowtype_reserved(colname))
+        continue;
+      name=suffix?PyUnicode_FromFormat("%s_%d", colname, suffix):convertutf8string(colname);
+      if(!name)
+        return NULL;
+      found=PySet_Contains(used, name);
+      if(!found)
+        break;
+      Py_DECREF(name);
+      if(found<0)
+        return NULL;
+    }
+  if(PySet_Add(used, name))
+    Py_CLEAR(name);
+  return name;
+}
+
+/* Struct sequence types keep pointers to the field names rather than
+   copying them.  The names tuple is the self of this callback which
+   is attached to a weak reference to the type, so it lives exactly as
+   long as the type without being reachable from Python.  The weak
+   reference holds an extra reference to itself which is released
+   here. */
+static PyObject *
+statementcache_rowtype_freed(PyObject *names, PyObject *weakref)
+{
+  (void)names;
+  Py_DECREF(weakref);
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef statementcache_rowtype_freed_def=
+  {"rowtype_freed", (PyCFunction)statementcache_rowtype_freed, METH_O, NULL};
+#endif
+
+/* Builds the struct sequence type for named rows of this statement
+   with a field for each column name.  Duplicate names, and names the
+   type already has as attributes, get _1, _2 etc appended.  The names
+   are also available as the _fields attribute of the type as with
+   namedtuple.  Returns a new reference. */
+static PyObject *
+statementcache_rowtype(APSWStatement *stmt)
+{
+#if PY_VERSION_HEX >= 0x03030000
+  int ncols, i, reprepares;
+  PyObject *names=NULL, *used=NULL, *rowtype=NULL, *callback=NULL, *weakref=NULL;
+  PyStructSequence_Field *fields=NULL;
+  PyStructSequence_Desc desc;
+
+  _PYSQLITE_CALL_V( (ncols=sqlite3_column_count(stmt->vdbestatement), reprepares=sqlite3_stmt_status(stmt->vdbestatement, SQLITE_STMTSTATUS_REPREPARE, 0)) );
+
+  names=PyTuple_New(ncols);
+  used=PySet_New(NULL);
+  fields=PyMem_Malloc(sizeof(PyStructSequence_Field)*(ncols+1));
+  if(!names || !used || !fields)
+    {
+      PyErr_NoMemory();
+      goto finally;
+    }
+
+  for(i=0;i<ncols;i++)
+    {
+      const char *colname;
+      PyObject *name;
+
+      _PYSQLITE_CALL_V(colname=sqlite3_column_name(stmt->vdbestatement, i));
+      if(!colname)
+        {
+          PyErr_NoMemory();
+          goto finally;
+        }
+      name=statementcache_rowtype_name(colname, used);
+      if(!name)
+        goto finally;
+      PyTuple_SET_ITEM(names, i, name);
+      fields[i].name=PyUnicode_AsUTF8(name);
+      fields[i].doc=NULL;
+      if(!fields[i].name)
+        goto finally;
+    }
+  fields[ncols].name=NULL;
+  fields[ncols].doc=NULL;
+
+  desc.name="apsw.Row";
+  desc.doc="Result row with access to the columns by name";
+  desc.fields=fields;
+  desc.n_in_sequence=ncols;
+
+  rowtype=(PyObject*)PyStructSequence_NewType(&desc);
+  if(!rowtype)
+    goto finally;
+  callback=PyCFunction_New(&statementcache_rowtype_freed_def, names);
+  if(callback)
+    weakref=PyWeakref_NewRef(rowtype, callback);
+  if(!weakref)
+    {
+      Py_CLEAR(rowtype);
+      goto finally;
+    }
+  /* released by the callback */
+  Py_INCREF(weakref);
+  if(PyObject_SetAttrString(rowtype, "_fields", names))
+    {
+      Py_CLEAR(rowtype);
+      goto finally;
+    }
+
+  stmt->rowtypencols=ncols;
+  stmt->rowtypereprepares=reprepares;
+
+ finally:
+  Py_XDECREF(weakref);
+  Py_XDECREF(callback);
+  Py_XDECREF(names);
+  Py_XDECREF(used);
+  PyMem_Free(fields);
+  return rowtype;
+#else
+  (void)stmt;
+  return PyErr_Format(PyExc_NotImplementedError, "Named rows need Python 3.3 or later");
+#endif
+}
+
 /* Convert a utf8 buffer to PyUnicode */
 static PyObject *
 convertutf8buffertounicode(PyObject *buffer)
@@ -680,6 +1221,205 @@ convertutf8buffersizetounicode(PyObject *buffer, Py_ssize_t len)
 }
 
 
+/* Prepares query and any statements following it, leaving them in
+   the cache the same way executing them with a cursor would.  Returns
+   0 on success or -1 with an exception set. */
+static int
+statementcache_preload(StatementCache *sc, PyObject *query)
+{
+  APSWStatement *stmt;
+  int res;
+
+  stmt=statementcache_prepare(sc, query, 1); /* INUSE_CALL not needed here */
+  if(!stmt)
+    return -1;
+
+  while(stmt->next)
+    if(statementcache_next(sc, &stmt, 1)!=SQLITE_OK) /* INUSE_CALL not needed here */
+      return -1;
+
+  /* the statement has not been stepped so the reset can't fail */
+  res=statementcache_finalize(sc, stmt, 0); /* INUSE_CALL not needed here */
+  assert(res==SQLITE_OK);
+  return (res==SQLITE_OK)?0:-1;
+}
+
+/* Appends the query text of stmt to list unless it is already in seen */
+static int
+statementcache_manifest_add(PyObject *list, PyObject *seen, APSWStatement *stmt)
+{
+  PyObject *query;
+  int res;
+
+  query=convertutf8buffertounicode(stmt->utf8);
+  if(!query)
+    return -1;
+  res=PySet_Contains(seen, query);
+  if(res==0)
+    res=(PySet_Add(seen, query) || PyList_Append(list, query))?-1:0;
+  else if(res>0)
+    res=0;
+  Py_DECREF(query);
+  return res;
+}
+
+/* Returns a list of the query text of each cached statement, least
+   recently used first and ending with those in use, with each query
+   only present once.  Preloading the list recreates the cache
+   contents. */
+static PyObject *
+statementcache_manifest(StatementCache *sc)
+{
+  PyObject *res, *seen;
+  APSWStatement *stmt;
+  size_t slot;
+
+  res=PyList_New(0);
+  seen=PySet_New(NULL);
+  if(!res || !seen)
+    goto error;
+
+  for(stmt=sc->lru;stmt;stmt=stmt->lru_prev)
+    if(statementcache_manifest_add(res, seen, stmt))
+      goto error;
+
+  /* in use entries are not on the lru list */
+  for(slot=0;sc->table && slot<=sc->tablemask;slot++)
+    if(sc->table[slot].stmt && sc->table[slot].stmt->inuse
+       && statementcache_manifest_add(res, seen, sc->table[slot].stmt))
+      goto error;
+
+  Py_DECREF(seen);
+  return res;
+
+ error:
+  Py_XDECREF(seen);
+  Py_XDECREF(res);
+  return NULL;
+}
+
+/* The sqlite3_stmt_status counters reported for statements */
+static const struct {
+  const char *name;
+  int op;
+} statementcache_statusops[]={
+  {"fullscan_steps", SQLITE_STMTSTATUS_FULLSCAN_STEP},
+  {"sorts", SQLITE_STMTSTATUS_SORT},
+#ifdef SQLITE_STMTSTATUS_AUTOINDEX
+  {"autoindex", SQLITE_STMTSTATUS_AUTOINDEX},
+#endif
+#ifdef SQLITE_STMTSTATUS_VM_STEP
+  {"vm_steps", SQLITE_STMTSTATUS_VM_STEP},
+#endif
+#ifdef SQLITE_STMTSTATUS_REPREPARE
+  {"reprepares", SQLITE_STMTSTATUS_REPREPARE},
+#endif
+#ifdef SQLITE_STMTSTATUS_RUN
+  {"runs", SQLITE_STMTSTATUS_RUN},
+#endif
+#ifdef SQLITE_STMTSTATUS_MEMUSED
+  {"memused", SQLITE_STMTSTATUS_MEMUSED},
+#endif
+};
+
+/* Adds the sqlite3_stmt_status counters of stmt to dict, optionally
+   resetting them.  The counters accumulate over every execution of
+   the statement since it was prepared.  The caller must hold the
+   database mutex so the statement can't be finalized by another
+   thread meanwhile.  Returns 0 on success or -1 with an exception
+   set. */
+static int
+statementcache_stmtstatus(APSWStatement *stmt, int reset, PyObject *dict)
+{
+  unsigned i;
+
+  for(i=0;i<sizeof(statementcache_statusops)/sizeof(statementcache_statusops[0]);i++)
+    {
+      int value=0, res;
+      PyObject *pyvalue;
+
+      if(stmt->vdbestatement)
+        PYSQLITE_LOCKED_CALL(value=sqlite3_stmt_status(stmt->vdbestatement, statementcache_statusops[i].op, reset));
+      pyvalue=PyInt_FromLong(value);
+      if(!pyvalue)
+        return -1;
+      res=PyDict_SetItemString(dict, statementcache_statusops[i].name, pyvalue);
+      Py_DECREF(pyvalue);
+      if(res)
+        return -1;
+    }
+  return 0;
+}
+
+/* Returns a dict of the counters and current usage, including a list
+   of the cached queries with their hit counts if queries is true */
+static PyObject *
+statementcache_stats(StatementCache *sc, int queries)
+{
+  PyObject *res, *list=NULL;
+  size_t slot;
+
+  res=Py_BuildValue("{s:K,s:K,s:K,s:K,s:K,s:I,s:n,s:I,s:n,s:I}",
+                    "hits", (unsigned long long)sc->st_hits,
+                    "misses", (unsigned long long)sc->st_misses,
+                    "hits_inuse", (unsigned long long)sc->st_hitsinuse,
+                    "evictions", (unsigned long long)sc->st_evictions,
+                    "too_big", (unsigned long long)sc->st_toobig,
+                    "entries", sc->numentries,
+                    "bytes", sc->numbytes,
+                    "max_entries", sc->maxentries,
+                    "max_bytes", sc->maxbytes,
+                    "max_instances", sc->maxinstances);
+  if(!res || !queries)
+    return res;
+
+  list=PyList_New(0);
+  if(!list)
+    goto error;
+
+  /* The mutex is held for the whole walk and the GIL is never
+     released, so other threads can't finalize, evict or move entries
+     underneath us.  Each statement is still referenced while used in
+     case building the entry runs Python code that changes the
+     cache, which is also why the table is looked up again every time
+     round the loop. */
+  PYSQLITE_DB_MUTEX_ENTER(sc->db);
+  for(slot=0;sc->table && slot<=sc->tablemask;slot++)
+    {
+      APSWStatement *stmt=sc->table[slot].stmt;
+      PyObject *entry;
+      int ok;
+
+      if(!stmt)
+        continue;
+      Py_INCREF(stmt);
+      entry=Py_BuildValue("{s:N,s:I,s:n,s:O}",
+                          "query", convertutf8buffertounicode(stmt->utf8),
+                          "hits", stmt->hits,
+                          "bytes", stmt->cachebytes,
+                          "inuse", stmt->inuse?Py_True:Py_False);
+      ok=entry && !statementcache_stmtstatus(stmt, 0, entry) && !PyList_Append(list, entry);
+      Py_XDECREF(entry);
+      Py_DECREF(stmt);
+      if(!ok)
+        {
+          PYSQLITE_DB_MUTEX_LEAVE(sc->db);
+          goto error;
+        }
+    }
+  PYSQLITE_DB_MUTEX_LEAVE(sc->db);
+
+  if(PyDict_SetItemString(res, "queries", list))
+    goto error;
+  Py_DECREF(list);
+  return res;
+
+ error:
+  Py_XDECREF(list);
+  Py_XDECREF(res);
+  return NULL;
+}
+
 static PyTypeObject APSWStatementType =
   {
     APSW_PYTYPE_INIT
@@ -48,6 +48,29 @@ do {                                                \
   Py_END_ALLOW_THREADS;                             \
  } while(0)
 
+/* Acquires the database mutex for a sequence of SQLite calls made
+   while holding the GIL.  The GIL is released while waiting for the
+   mutex and then reacquired.  That is the same order as callbacks
+   from within SQLite (which already hold the database mutex when
+   they acquire the GIL) so it can't deadlock.  Only SQLite calls
+   that never call back into Python may be made before the matching
+   PYSQLITE_DB_MUTEX_LEAVE, and they are wrapped in
+   PYSQLITE_LOCKED_CALL. */
+#define PYSQLITE_DB_MUTEX_ENTER(db) \
+  _PYSQLITE_CALL_V(sqlite3_mutex_enter(sqlite3_db_mutex(db)))
+
+#define PYSQLITE_DB_MUTEX_LEAVE(db) \
+  sqlite3_mutex_leave(sqlite3_db_mutex(db))
+
+/* For threads that never hold the GIL such as the cursor prefetch
+   worker.  Leave with PYSQLITE_DB_MUTEX_LEAVE. */
+#define PYSQLITE_NOGIL_MUTEX_ENTER(db) \
+  sqlite3_mutex_enter(sqlite3_db_mutex(db))
+
+/* call made while the database mutex is already held */
+#define PYSQLITE_LOCKED_CALL(x) \
+  do { x; } while(0)
+
 #define INUSE_CALL(x)                               \
   do {                                              \
        assert(self->inuse==0); self->inuse=1;       \
@@ -246,15 +269,18 @@ convert_value_to_pyobject(sqlite3_value *value)
   return NULL;
 }
 
-/* Converts column to PyObject.  Returns a new reference. Almost identical to above 
-   but we cannot just use sqlite3_column_value and then call the above function as 
-   SQLite doesn't allow that ("unprotected values") */
+/* Converts column to PyObject.  Returns a new reference. Almost identical to above
+   but we cannot just use sqlite3_column_value and then call the above function as
+   SQLite doesn't allow that ("unprotected values").  The caller must
+   hold the database mutex (see PYSQLITE_DB_MUTEX_ENTER) so that a
+   whole row can be converted without releasing the GIL for each
+   value. */
 static PyObject *
 convert_column_to_pyobject(sqlite3_stmt *stmt, int col)
 {
   int coltype;
 
-  _PYSQLITE_CALL_V(coltype=sqlite3_column_type(stmt, col));
+  PYSQLITE_LOCKED_CALL(coltype=sqlite3_column_type(stmt, col));
 
   APSW_FAULT_INJECT(UnknownColumnType,,coltype=12348);
 
@@ -263,7 +289,7 @@ convert_column_to_pyobject(sqlite3_stmt *stmt, int col)
     case SQLITE_INTEGER:
       {
         sqlite3_int64 val;
-        _PYSQLITE_CALL_V(val=sqlite3_column_int64(stmt, col));
+        PYSQLITE_LOCKED_CALL(val=sqlite3_column_int64(stmt, col));
 #if PY_MAJOR_VERSION<3
         if (val>=LONG_MIN && val<=LONG_MAX)
           return PyInt_FromLong((long)val);
@@ -274,14 +300,14 @@ convert_column_to_pyobject(sqlite3_stmt *stmt, int col)
     case SQLITE_FLOAT:
       { 
         double d;
-        _PYSQLITE_CALL_V(d=sqlite3_column_double(stmt, col));
+        PYSQLITE_LOCKED_CALL(d=sqlite3_column_double(stmt, col));
         return PyFloat_FromDouble(d);
       }
     case SQLITE_TEXT:
       {
         const char *data;
         size_t len;
-        _PYSQLITE_CALL_V( (data=(const char*)sqlite3_column_text(stmt, col), len=sqlite3_column_bytes(stmt, col)) );
+        PYSQLITE_LOCKED_CALL( (data=(const char*)sqlite3_column_text(stmt, col), len=sqlite3_column_bytes(stmt, col)) );
         return convertutf8stringsize(data, len);
       }
 
@@ -292,7 +318,7 @@ convert_column_to_pyobject(sqlite3_stmt *stmt, int col)
       {
         const void *data;
         size_t len;
-        _PYSQLITE_CALL_V( (data=sqlite3_column_blob(stmt, col), len=sqlite3_column_bytes(stmt, col)) );
+        PYSQLITE_LOCKED_CALL( (data=sqlite3_column_blob(stmt, col), len=sqlite3_column_bytes(stmt, col)) );
         return converttobytes(data, len);
       }
 
@@ -352,3 +378,23 @@ static size_t apsw_strnlen(const char *s, size_t maxlen)
       }
     return res;
 }
+
+/* Microseconds from a clock that only goes forwards, for measuring
+   timeouts.  The starting point is arbitrary. */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static sqlite3_int64
+apsw_monotonic_us(void)
+{
+#ifdef _WIN32
+  return (sqlite3_int64)GetTickCount64()*1000;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (sqlite3_int64)ts.tv_sec*1000000+ts.tv_nsec/1000;
+#endif
+}
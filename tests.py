@@ -344,13 +344,25 @@ class APSW(unittest.TestCase):
         'readonly': 1,
         'db_filename': 1,
         'set_last_insert_rowid': 1,
+        'setnamedrows': 1,
+        'setlazyrows': 1,
+        'preload_statements': 1,
+        'group_commit': 1,
+        'group_execute': 1,
+        'setbusypolicy': 1,
+        'setquerytimeout': 1,
         }
 
     cursor_nargs = {
         'execute': 1,
         'executemany': 2,
+        'executemany_columns': 2,
         'setexectrace': 1,
         'setrowtrace': 1,
+        'setnamedrows': 1,
+        'setlazyrows': 1,
+        'export': 1,
+        'fetcharrow': 1,
     }
 
     blob_nargs = {'write': 1, 'read': 1, 'readinto': 1, 'reopen': 1, 'seek': 2}
@@ -606,6 +618,18 @@ class APSW(unittest.TestCase):
         self.assertEqual((1, None, 3), next(c.execute("select * from foo")))
         c.execute("delete from foo")
 
+        # parameter names are cached with the statement so repeated
+        # executions with different dicts must still look up correctly
+        class strsub(type(u(""))):
+            pass
+
+        for i in range(5):
+            c.execute("insert into foo values(:a,$b,@c)", {'a': i, strsub('b'): i + 1, 'c': i + 2})
+            self.assertEqual((i, i + 1, i + 2), next(c.execute("select * from foo")))
+            c.execute("delete from foo")
+        # a mix of named and unnamed parameters can't use a dict
+        self.assertRaises(apsw.BindingsError, c.execute, "insert into foo values(:a,?,:c)", {'a': 1, 'c': 3})
+
         # these ones should cause errors
         vals = (
             (apsw.BindingsError, "(?,?,?)", (1, 2)),  # too few
@@ -801,6 +825,547 @@ class APSW(unittest.TestCase):
         # fetchall
         self.assertEqual(c.fetchall(), [])
         self.assertEqual(c.execute("select 3; select 4").fetchall(), [(3, ), (4, )])
+        # fetchmany
+        self.assertRaises(TypeError, c.fetchmany)
+        self.assertRaises(TypeError, c.fetchmany, "3")
+        self.assertRaises(ValueError, c.fetchmany, 0)
+        self.assertEqual(c.fetchmany(10), [])
+        c.execute("create table fm(x); insert into fm values(1); insert into fm values(2); insert into fm values(3)")
+        c.execute("select x from fm order by x; select 4; select 5")
+        self.assertEqual(c.fetchmany(2), [(1, ), (2, )])
+        self.assertEqual(c.fetchmany(size=2), [(3, ), (4, )])
+        self.assertEqual(c.fetchmany(1000), [(5, )])
+        self.assertEqual(c.fetchmany(1000), [])
+        # rows skipped by the row tracer don't count
+        c.setrowtrace(lambda cur, row: None if row[0] % 2 else row)
+        self.assertEqual(c.execute("select x from fm order by x; select 4").fetchmany(2), [(2, ), (4, )])
+
+        def tracer(cur, row):
+            if row[0] == 2:
+                1 / 0
+            return row
+
+        c.setrowtrace(tracer)
+        self.assertRaises(ZeroDivisionError, c.execute("select x from fm order by x").fetchmany, 3)
+        c.setrowtrace(None)
+
+    def testCursorFetchInto(self):
+        "Check writing result columns into buffers"
+        import array
+        c = self.db.cursor()
+        c.execute("create table foo(x,y,z)")
+        c.executemany("insert into foo values(?,?,?)", [(i, i * 1.5, None if i % 3 else i) for i in range(10)])
+        xs = array.array('q', [-1] * 4)
+        ys = array.array('d', [-1] * 4)
+        zs = array.array('d', [-1] * 4)
+        znulls = bytearray(4)
+
+        # bad params
+        self.assertRaises(TypeError, c.fetchinto)
+        self.assertRaises(TypeError, c.fetchinto, 3)
+        c.execute("select x,y,z from foo order by x")
+        self.assertRaises(ValueError, c.fetchinto, (None, None, None))
+        self.assertRaises(ValueError, c.fetchinto, (xs, ys, zs), (None, ))
+        self.assertRaises(BufferError, c.fetchinto, (xs, b"abc", zs))
+        self.assertRaises(TypeError, c.fetchinto, (xs, bytearray(8), zs))
+        self.assertRaises(TypeError, c.fetchinto, (xs, array.array('i', [0]), zs))
+        self.assertRaises(TypeError, c.fetchinto, (xs, ys, zs), (None, None, array.array('i', [0])))
+        # column count mismatch
+        self.assertRaises(ValueError, c.fetchinto, (xs, ys))
+
+        res = []
+        c.execute("select x,y,z from foo order by x")
+        while True:
+            n = c.fetchinto((xs, ys, zs), (None, None, znulls))
+            if not n:
+                break
+            for i in range(n):
+                res.append((xs[i], ys[i], None if znulls[i] else zs[i]))
+        self.assertEqual(res, list(c.execute("select x,y,z from foo order by x")))
+        self.assertEqual(c.fetchinto((xs, ys, zs)), 0)
+
+        # ignored columns, memoryview and zero values for nulls
+        ba = bytearray(8 * 3)
+        mv = memoryview(ba).cast('q')
+        c.execute("select z,y from foo order by x")
+        self.assertEqual(c.fetchinto((mv, None), (znulls, None)), 3)
+        self.assertEqual(list(mv), [0, 0, 0])
+        self.assertEqual(list(znulls[:3]), [0, 1, 1])
+        # ints can go into doubles
+        c.execute("select x, x from foo order by x")
+        self.assertEqual(c.fetchinto((xs, ys)), 4)
+        self.assertEqual(list(ys), [0.0, 1.0, 2.0, 3.0])
+        # but not floats into ints, text, blobs or unmasked nulls
+        for sql in ("select 1.5", "select 'abc'", "select x'aabb'", "select null"):
+            c.execute(sql)
+            self.assertRaises(TypeError, c.fetchinto, (xs, ))
+        # the row causing the error was consumed
+        one = array.array('q', [0])
+        c.execute("select 1; select 1.5; select 3")
+        self.assertEqual(c.fetchinto((one, )), 1)
+        self.assertRaises(TypeError, c.fetchinto, (one, ))
+        self.assertEqual(c.fetchinto((one, )), 1)
+        self.assertEqual(one[0], 3)
+
+    def testCursorPrefetch(self):
+        "Check cursor prefetching in a background thread"
+        import array
+        c = self.db.cursor()
+        c.execute("create table foo(x,y,z)")
+        c.executemany("insert into foo values(?,?,?)",
+                      [(i, u"some text %d" % i if i % 3 else None, b"\x01" * (i % 7)) for i in range(1000)])
+        expected = c.execute("select * from foo order by x").fetchall()
+        for prefetch in (0, 1, 2, 3, 64, 5000):
+            self.assertEqual(c.execute("select * from foo order by x", prefetch=prefetch).fetchall(), expected)
+            self.assertEqual(c.execute("select * from foo where x<?", (10, ), prefetch=prefetch).fetchall(), expected[:10])
+            # multiple statements including ones without rows
+            self.assertEqual(
+                c.execute("select 1; select * from foo where x<0; create temp table t(x); drop table t; select * from foo order by x",
+                          prefetch=prefetch).fetchall(), [(1, )] + expected)
+            # lazy rows
+            c.setlazyrows(True)
+            self.assertEqual([tuple(r) for r in c.execute("select * from foo order by x", prefetch=prefetch)], expected)
+            c.setlazyrows(None)
+        # named rows
+        if sys.version_info >= (3, 3):
+            c.setnamedrows(True)
+            self.assertEqual([r.x for r in c.execute("select x from foo order by x", prefetch=4)], list(range(1000)))
+            c.setnamedrows(None)
+        # row tracer
+        c.setrowtrace(lambda cur, row: None if row[0] % 2 else row[0])
+        self.assertEqual(c.execute("select x from foo order by x", prefetch=4).fetchall(), list(range(0, 1000, 2)))
+        c.setrowtrace(None)
+        # stopping part way
+        c.execute("select * from foo order by x", prefetch=8)
+        self.assertEqual([next(c) for i in range(20)], expected[:20])
+        self.assertEqual(c.getdescription()[0][0], "x")
+        self.assertEqual(c.execute("select 3").fetchall(), [(3, )])
+        c.execute("select * from foo", prefetch=8)
+        next(c)
+        next(c)
+        c.close()
+        c = self.db.cursor()
+        c.execute("select * from foo", prefetch=8)
+        next(c)
+        next(c)
+        del c
+        gc.collect()
+        c = self.db.cursor()
+        c.execute("select * from foo", prefetch=8)
+        next(c)
+        next(c)
+        self.db.close(True)
+        self.db = apsw.Connection(TESTFILEPREFIX + "testdb", flags=openflags)
+        c = self.db.cursor()
+        # other cursors and writes while prefetching
+        c2 = self.db.cursor()
+        c.execute("select x from foo order by x", prefetch=4)
+        for i, row in enumerate(c):
+            if i < 5:
+                c2.execute("insert into foo values(?,?,?)", (1000 + i, None, None))
+            self.assertEqual(c2.execute("select ?", (i, )).fetchall(), [(i, )])
+        # errors
+        self.assertRaises(ValueError, c.execute, "select 3", prefetch=-1)
+        self.assertRaises(ValueError, c.execute, "select 3", prefetch=10000000)
+        self.assertRaises(TypeError, c.execute, "select 3", prefetch="3")
+        self.assertRaises(TypeError, c.execute, "select 3", prefetched=3)
+        c.execute("select x from foo", prefetch=4)
+        next(c)
+        self.assertRaises(ValueError, c.fetchinto, [array.array('q', [0])])
+        self.assertRaises(apsw.SQLError, c.execute("select abs(case when x=500 then -9223372036854775808 else x end) from foo",
+                                                   prefetch=4).fetchall)
+        self.db.createscalarfunction("boom", lambda x: 1 / (x - 500))
+        # exceptions in callbacks on the worker thread are raised by the cursor
+        for prefetch in (0, 4, 8):
+            self.assertRaises(ZeroDivisionError, c.execute("select boom(x) from foo", prefetch=prefetch).fetchall)
+            seen = []
+            try:
+                for row in c.execute("select boom(x) from foo", prefetch=prefetch):
+                    seen.append(row)
+                self.fail("Expected exception")
+            except ZeroDivisionError:
+                pass
+            self.assertEqual(len(seen), 500)
+
+        def keyerror(x):
+            if x > 100:
+                raise KeyError(x)
+            return x
+
+        self.db.createscalarfunction("keyerror", keyerror)
+        try:
+            c.execute("select keyerror(x) from foo", prefetch=8).fetchall()
+            self.fail("Expected exception")
+        except KeyError as e:
+            self.assertEqual(e.args, (101, ))
+        # an exception is discarded if the cursor stops early
+        c.execute("select boom(x) from foo", prefetch=8)
+        next(c)
+        time.sleep(0.05)
+        c.close(True)
+        c = self.db.cursor()
+        self.assertEqual(c.execute("select count(*) from foo").fetchall(), [(1005, )])
+
+    def testBindingLifetime(self):
+        "Check large immutable values bound without copying stay valid"
+        import array
+        c = self.db.cursor()
+        c.execute("create table foo(x,y)")
+        big = [u"a" * 300, u"\u00e9" * 300, b"b" * 1000, bytearray(b"c" * 1000), u"d" * 10, b"e" * 10]
+        # tuple, list and dict bindings
+        for v in big:
+            c.execute("delete from foo")
+            c.execute("insert into foo values(?,?)", (v, 1))
+            c.execute("insert into foo values(?,?)", [v, 2])
+            c.execute("insert into foo values(:x,:y)", {"x": v, "y": 3})
+            c.execute("insert into foo values(?,?); insert into foo values(?,?)", [v, 4, v, 5])
+            c.executemany("insert into foo values(?,?)", [(v, 6), [v, 7], (v, 8)])
+            c.executemany_columns("insert into foo values(?,?)", ([v, v], array.array('q', [9, 10])))
+            expected = bytes(v) if isinstance(v, bytearray) else v
+            self.assertEqual(c.execute("select x, y from foo order by y").fetchall(),
+                             [(expected, i) for i in range(1, 11)])
+        # mutable containers changed while the statement is running
+        # (made at runtime so they aren't constants kept alive by the code)
+        n = int("1000")
+        data = [b"f" * n, u"g" * n]
+        ddata = {}
+
+        def mutate():
+            data[0] = data[1] = None
+            ddata["x"] = None
+            gc.collect()
+            # reuse the freed memory
+            junk = [bytes([122]) * 1000 for i in range(100)]
+            return 1
+
+        self.db.createscalarfunction("mutate", mutate, 0)
+        self.assertEqual(c.execute("select mutate(), ?, ?", data).fetchall(), [(1, b"f" * 1000, u"g" * 1000)])
+        ddata["x"] = b"h" * n
+        self.assertEqual(c.execute("select mutate(), :x", ddata).fetchall(), [(1, b"h" * 1000)])
+        # rows of a select with bindings are consumed over several calls
+        c.execute("select ?, x from foo", (u"i" * 1000, ))
+        for row in c:
+            self.assertEqual(row[0], u"i" * 1000)
+
+    def testExecuteManyColumns(self):
+        "Check executemany_columns binding from columns"
+        import array
+        c = self.db.cursor()
+        c.execute("create table foo(x,y,z)")
+        ids = array.array('q', [1, -2, 0x7fffffffffffffff, 4])
+        prices = array.array('d', [0.5, -1e100, 3.0, float("inf")])
+        names = [u"one", None, b"\x03", 4.5]
+        self.assertEqual(c.executemany_columns("insert into foo values(?,?,?)", (ids, prices, names)), 4)
+        self.assertEqual(c.execute("select * from foo order by rowid").fetchall(), list(zip(ids, prices, names)))
+        # nulls, memoryviews, tuples, keyword arguments
+        c.execute("delete from foo")
+        nulls = bytearray([0, 1, 0])
+        self.assertEqual(
+            c.executemany_columns(statement="insert into foo values(?,?,?)",
+                                  columns=(memoryview(bytearray(24)).cast('q'), array.array('d', [1, 2, 3]), (7, 8, 9)),
+                                  nulls=(nulls, None, nulls)), 3)
+        self.assertEqual(c.execute("select * from foo order by rowid").fetchall(), [(0, 1.0, 7), (None, 2.0, None),
+                                                                                     (0, 3.0, 9)])
+        # no rows
+        self.assertEqual(c.executemany_columns("insert into foo values(?,?,?)", ([], [], [])), 0)
+        # statements returning rows, and the exec tracer
+        traced = []
+
+        def tracer(cur, sql, bindings):
+            traced.append(bindings)
+            return True
+
+        c.setexectrace(tracer)
+        self.assertEqual(c.executemany_columns("select ?, ?", (array.array('q', [1, 2]), [u"a", u"b"])), 2)
+        self.assertEqual(traced, [(1, u"a"), (2, u"b")])
+        c.setexectrace(lambda *args: False)
+        self.assertRaises(apsw.ExecTraceAbort, c.executemany_columns, "select ?", ([1], ))
+        c.setexectrace(None)
+        # errors
+        self.assertRaises(TypeError, c.executemany_columns, "select ?", 3)
+        self.assertRaises(TypeError, c.executemany_columns, "select ?", (3, ))
+        self.assertRaises(TypeError, c.executemany_columns, "select ?", (array.array('i', [1]), ))
+        self.assertRaises(TypeError, c.executemany_columns, "select ?", ([object()], ))
+        self.assertRaises(ValueError, c.executemany_columns, "select ?, ?", ([1, 2], [3]))
+        self.assertRaises(ValueError, c.executemany_columns, "select ?", ([1, 2], ), (None, None))
+        self.assertRaises(ValueError, c.executemany_columns, "select ?", ([1, 2], ), (bytearray(1), ))
+        self.assertRaises(ValueError, c.executemany_columns, "select ?; select ?", ([1], [2]))
+        self.assertRaises(apsw.BindingsError, c.executemany_columns, "select ?, ?", ([1], ))
+        self.assertRaises(apsw.SQLError, c.executemany_columns, "select nonexistent(?)", ([1], ))
+        self.assertRaises(OverflowError, c.executemany_columns, "select ?", ([1, 2**70], ))
+        c.execute("delete from foo; create unique index foox on foo(x)")
+        self.assertRaises(apsw.ConstraintError, c.executemany_columns, "insert into foo values(?,?,?)",
+                          ([1, 2, 2, 3], [1, 2, 3, 4], [1, 2, 3, 4]))
+        self.assertEqual(c.execute("select x from foo order by x").fetchall(), [(1, ), (2, )])
+
+        def func(x):
+            1 / 0
+
+        self.db.createscalarfunction("func", func)
+        self.assertRaises(ZeroDivisionError, c.executemany_columns, "insert into foo values(func(?),1,1)", ([5], ))
+        # cursor still usable
+        self.assertEqual(c.execute("select count(*) from foo").fetchall(), [(2, )])
+
+    def testCursorExport(self):
+        "Check exporting rows as csv, tsv and jsonl"
+        import io, csv, json, base64
+        c = self.db.cursor()
+        c.execute("create table foo(x,y,z,[a b])")
+        vals = [(1, u"plain", 1.5, None), (-0x8000000000000000, u"has,comma", u'quote"d', b"\x00\x01\xff"),
+                (0, u"new\nline\r", 1e100, u"tab\there"), (3, u"", float("inf"), u"\u1234\x01/\\"),
+                (5, 0.1, -0.0, 0x7fffffffffffffff)]
+        c.executemany("insert into foo values(?,?,?,?)", vals)
+        fix = lambda v: u"" if v is None else (u"<Binary data>" if isinstance(v, bytes) else v)
+        for fmt, dialect in (("csv", "excel"), ("tsv", "excel-tab")):
+            out = io.StringIO()
+            w = csv.writer(out, dialect=dialect, lineterminator="\n")
+            w.writerow(["x", "y", "z", "a b"])
+            for row in vals:
+                w.writerow([fix(v) for v in row])
+            for prefetch in (0, 2):
+                b = io.BytesIO()
+                self.assertEqual(c.execute("select * from foo", prefetch=prefetch).export(b, format=fmt), len(vals))
+                self.assertEqual(b.getvalue().decode("utf8"), out.getvalue())
+        # jsonl including multiple statements
+        b = io.BytesIO()
+        self.assertEqual(c.execute("select * from foo; select 7 as seven").export(b, "jsonl"), len(vals) + 1)
+        lines = b.getvalue().decode("utf8").split("\n")
+        self.assertEqual(lines[-1], "")
+        for line, row in zip(lines, vals + [(7, )]):
+            d = json.loads(line)
+            self.assertEqual(list(d.values()),
+                             [base64.b64encode(v).decode("ascii") if isinstance(v, bytes) else v for v in row])
+        self.assertEqual(list(json.loads(lines[0]).keys()), ["x", "y", "z", "a b"])
+        self.assertEqual(lines[-2], '{"seven": 7}')
+        # remaining rows only, header, nullvalue
+        c.execute("select x, [a b] from foo")
+        next(c)
+        b = io.BytesIO()
+        self.assertEqual(c.export(b, header=False, nullvalue="NULL"), len(vals) - 1)
+        self.assertTrue(b.getvalue().startswith(b"-9223372036854775808,<Binary data>\n0,tab\there\n"))
+        self.assertEqual(c.export(b), 0)
+        # single empty field is quoted like the csv module
+        b = io.BytesIO()
+        c.execute("select ''").export(b)
+        self.assertEqual(b.getvalue(), b"''\n\"\"\n")
+        # larger than the write buffer, to a file descriptor
+        r, w = os.pipe()
+        result = []
+
+        def export():
+            try:
+                result.append(
+                    c.execute(
+                        "with recursive r(n) as (select 1 union all select n+1 from r where n<100000) select n, 'row '||n from r"
+                    ).export(w, header=False))
+            finally:
+                os.close(w)
+
+        t = threading.Thread(target=export)
+        t.start()
+        data = []
+        try:
+            while True:
+                d = os.read(r, 65536)
+                if not d:
+                    break
+                data.append(d)
+        finally:
+            t.join()
+            os.close(r)
+        self.assertEqual(result, [100000])
+        data = b"".join(data).decode("ascii").split("\n")
+        self.assertEqual(len(data), 100001)
+        self.assertEqual(data[0], "1,row 1")
+        self.assertEqual(data[99999], "100000,row 100000")
+        # errors
+        self.assertRaises(ValueError, c.execute("select 3").export, io.BytesIO(), format="xml")
+        self.assertRaises(ValueError, c.execute("select 3").export, -1)
+        self.assertRaises(AttributeError, c.execute("select 3").export, 3.4)
+        self.assertRaises(TypeError, c.execute("select 3").export, io.StringIO())
+        self.assertRaises(ZeroDivisionError, c.execute("select 3").export, io.BytesIO(), header=BadIsTrue())
+
+        class Writer:
+
+            def write(self, data):
+                1 / 0
+
+        self.assertRaises(ZeroDivisionError, c.execute("select 3").export, Writer())
+        self.assertRaises(OSError, c.execute("select 3").export, 98765)
+
+        # the write method can't use the cursor being exported
+        big = "with recursive r(n) as (select 1 union all select n+1 from r where n<100000) select n from r"
+        for action in (lambda: c.execute("select 'OTHER', 'QUERY'"), lambda: c.close(), lambda: c.fetchall()):
+
+            class Writer:
+
+                def write(self, data):
+                    action()
+
+            self.assertRaises(apsw.ThreadingViolationError, c.execute(big).export, Writer())
+            c.close(True)
+            c = self.db.cursor()
+
+    def testCursorFetchArrow(self):
+        "Check Arrow C Data Interface export"
+        if not ctypes:
+            return
+
+        class ArrowSchema(ctypes.Structure):
+            pass
+
+        ArrowSchema._fields_ = [("format", ctypes.c_char_p), ("name", ctypes.c_char_p), ("metadata", ctypes.c_char_p),
+                                ("flags", ctypes.c_int64), ("n_children", ctypes.c_int64),
+                                ("children", ctypes.POINTER(ctypes.POINTER(ArrowSchema))),
+                                ("dictionary", ctypes.c_void_p), ("release", ctypes.c_void_p),
+                                ("private_data", ctypes.c_void_p)]
+
+        class ArrowArray(ctypes.Structure):
+            pass
+
+        ArrowArray._fields_ = [("length", ctypes.c_int64), ("null_count", ctypes.c_int64), ("offset", ctypes.c_int64),
+                               ("n_buffers", ctypes.c_int64), ("n_children", ctypes.c_int64),
+                               ("buffers", ctypes.POINTER(ctypes.c_void_p)),
+                               ("children", ctypes.POINTER(ctypes.POINTER(ArrowArray))),
+                               ("dictionary", ctypes.c_void_p), ("release", ctypes.c_void_p),
+                               ("private_data", ctypes.c_void_p)]
+
+        getpointer = ctypes.pythonapi.PyCapsule_GetPointer
+        getpointer.restype = ctypes.c_void_p
+        getpointer.argtypes = [ctypes.py_object, ctypes.c_char_p]
+
+        def decode(capsules):
+            # returns list of (name, format, null_count, values)
+            schemacap, arraycap = capsules
+            schema = ArrowSchema.from_address(getpointer(schemacap, b"arrow_schema"))
+            array = ArrowArray.from_address(getpointer(arraycap, b"arrow_array"))
+            self.assertEqual(schema.format, b"+s")
+            self.assertEqual(schema.n_children, array.n_children)
+            self.assertTrue(schema.release and array.release)
+            res = []
+            for i in range(schema.n_children):
+                cs = schema.children[i].contents
+                ca = array.children[i].contents
+                self.assertEqual(ca.length, array.length)
+                fmt = cs.format.decode("ascii")
+                vals = []
+                if fmt == "n":
+                    self.assertEqual(ca.n_buffers, 0)
+                    vals = [None] * ca.length
+                else:
+                    validity = ca.buffers[0]
+                    for r in range(ca.length):
+                        if validity and not (ctypes.c_uint8.from_address(validity + r // 8).value & (1 << (r % 8))):
+                            vals.append(None)
+                        elif fmt == "l":
+                            vals.append(ctypes.c_int64.from_address(ca.buffers[1] + 8 * r).value)
+                        elif fmt == "g":
+                            vals.append(ctypes.c_double.from_address(ca.buffers[1] + 8 * r).value)
+                        else:
+                            start = ctypes.c_int64.from_address(ca.buffers[1] + 8 * r).value
+                            end = ctypes.c_int64.from_address(ca.buffers[1] + 8 * r + 8).value
+                            b = ctypes.string_at(ca.buffers[2] + start, end - start)
+                            vals.append(b.decode("utf8") if fmt == "U" else b)
+                    self.assertEqual(ca.null_count, vals.count(None))
+                res.append((cs.name.decode("utf8"), fmt, ca.null_count, vals))
+            return res
+
+        c = self.db.cursor()
+        c.execute("create table foo(i integer, t text, b blob, r real, n numeric, x)")
+        rows = [(1, u"one", b"\x01", 1.5, 7, None), (None, None, None, None, None, None),
+                (3, u"thr\u00e9e", b"", 3, 2.5, None), (4, u"", b"\x00\xff", -0.5, 9, None)]
+        c.executemany("insert into foo values(?,?,?,?,?,?)", rows)
+        res = decode(c.execute("select * from foo").fetcharrow())
+        self.assertEqual([r[0] for r in res], ["i", "t", "b", "r", "n", "x"])
+        self.assertEqual([r[1] for r in res], ["l", "U", "Z", "g", "g", "n"])
+        self.assertEqual([r[2] for r in res], [1, 1, 1, 1, 1, 4])
+        self.assertEqual(res[0][3], [1, None, 3, 4])
+        self.assertEqual(res[1][3], [u"one", None, u"thr\u00e9e", u""])
+        self.assertEqual(res[2][3], [b"\x01", None, b"", b"\x00\xff"])
+        self.assertEqual(res[3][3], [1.5, None, 3.0, -0.5])
+        # numeric affinity with an integer promoted to double
+        self.assertEqual(res[4][3], [7.0, None, 2.5, 9.0])
+        self.assertEqual(c.fetcharrow(), None)
+        # values converted to the declared type, no nulls, expressions
+        c.execute("insert into foo(i, t) values('12', 99)")
+        res = decode(c.execute("select i, t, i+1 as e, 'x' as s from foo where t=99").fetcharrow())
+        self.assertEqual(res, [("i", "l", 0, [12]), ("t", "U", 0, [u"99"]), ("e", "l", 0, [13]), ("s", "U", 0, [u"x"])])
+        # batches and multiple statements
+        c.execute("create table bar(x); insert into bar values(1); insert into bar values(2); insert into bar values(3)")
+        c.execute("select x from bar; select x*10 as y from bar; select 4 as z")
+        self.assertEqual(decode(c.fetcharrow(2)), [("x", "l", 0, [1, 2])])
+        self.assertRaises(ValueError, c.fetcharrow, 0)
+        self.assertEqual(decode(c.fetcharrow()), [("x", "l", 0, [3])])
+        self.assertEqual(decode(c.fetcharrow(-1)), [("y", "l", 0, [10, 20, 30])])
+        self.assertEqual(next(c), (4, ))
+        self.assertEqual(c.fetcharrow(), None)
+        self.assertEqual(c.execute("select * from bar where x>9").fetcharrow(), None)
+        # more rows than the initial allocation
+        res = decode(
+            c.execute(
+                "with recursive r(n) as (select 0 union all select n+1 from r where n<4999) select n, case when n%3 then n end, 'v'||n from r"
+            ).fetcharrow())
+        self.assertEqual(res[0][3], list(range(5000)))
+        self.assertEqual(res[1][3], [n if n % 3 else None for n in range(5000)])
+        self.assertEqual(res[1][2], 1667)
+        self.assertEqual(res[2][3], [u"v%d" % n for n in range(5000)])
+        # capsules can be freed in any order and the structures released by a consumer
+        s, a = c.execute("select 1").fetcharrow()
+        del s
+        array = ArrowArray.from_address(getpointer(a, b"arrow_array"))
+        ctypes.CFUNCTYPE(None, ctypes.c_void_p)(array.release)(ctypes.addressof(array))
+        self.assertFalse(array.release)
+        del a
+        # errors
+        self.assertRaises(TypeError, c.fetcharrow, "3")
+        self.assertRaises(ValueError, c.execute("select 3", prefetch=2).fetcharrow)
+
+    def testExecuteManyBindPlan(self):
+        "Check executemany reusing a single statement with planned bindings"
+        c = self.db.cursor()
+        c.execute("create table foo(x,y)")
+
+        class myint(int):
+            pass
+
+        class mystr(str):
+            pass
+
+        # types changing between rows in each column
+        vals = [(1, u"one"), (2.5, None), (None, 3), (u"four", b"\x04"), (myint(5), mystr(u"five")), (6, 6.5),
+                (7, u"\u1234 seven"), (8, 8), (2**62, u"")]
+        c.executemany("insert into foo values(?,?)", vals)
+        self.assertEqual(c.execute("select * from foo order by rowid").fetchall(), vals)
+        # dict bindings - missing keys are null even though the statement is reused
+        c.execute("delete from foo")
+        c.executemany("insert into foo values(:x, :y)", ({"x": 1, "y": 2}, {"x": 3}, {"y": 4}, {}))
+        self.assertEqual(c.execute("select * from foo order by rowid").fetchall(), [(1, 2), (3, None), (None, 4),
+                                                                                     (None, None)])
+        # statements returning rows
+        self.assertEqual(list(c.executemany("select ?*2, ?", ((i, u"x" * i) for i in range(5)))),
+                         [(i * 2, u"x" * i) for i in range(5)])
+        # exec tracer is still called for every row
+        traced = []
+
+        def tracer(cur, sql, bindings):
+            traced.append(bindings)
+            return True
+
+        c.setexectrace(tracer)
+        c.executemany("insert into foo values(?,?)", [(1, 2), (3, 4), (5, 6)])
+        self.assertEqual(traced, [(1, 2), (3, 4), (5, 6)])
+        c.setexectrace(None)
+        # errors part way through
+        self.assertRaises(OverflowError, c.executemany, "insert into foo values(?,?)", [(1, 2), (2**70, 3)])
+        self.assertRaises(TypeError, c.executemany, "insert into foo values(?,?)", [(1, 2), (3, object())])
+        self.assertRaises(apsw.BindingsError, c.executemany, "insert into foo values(?,?)", [(1, 2), (3, )])
+        c.execute("delete from foo")
+        c.execute("create unique index foox on foo(x)")
+        self.assertRaises(apsw.ConstraintError, c.executemany, "insert into foo values(?,?)", [(1, 2), (1, 3)])
+        self.assertEqual(c.execute("select * from foo").fetchall(), [(1, 2)])
+        # the statement is usable again afterwards
+        c.executemany("insert into foo values(?,?)", [(10, 2), (11, 3)])
+        self.assertEqual(c.execute("select count(*) from foo").fetchall(), [(3, )])
 
     def testTypes(self):
         "Check type information is maintained"
@@ -1246,6 +1811,127 @@ class APSW(unittest.TestCase):
         self.assertEqual(traced, [False, False])
         self.assertEqual(self.db.getrowtrace(), contrace)
 
+    def testNamedRows(self):
+        "Verify rows with named fields"
+        c = self.db.cursor()
+        c.execute("create table foo(x,y,[z a])")
+        c.execute("insert into foo values(1,2,3)")
+        self.assertEqual(self.db.getnamedrows(), False)
+        self.assertEqual(c.getnamedrows(), None)
+        self.assertRaises(TypeError, c.setnamedrows)
+        self.assertRaises(ZeroDivisionError, c.setnamedrows, BadIsTrue())
+        self.assertRaises(ZeroDivisionError, self.db.setnamedrows, BadIsTrue())
+        self.assertEqual(type(next(c.execute("select * from foo"))), tuple)
+        c.setnamedrows(True)
+        self.assertEqual(c.getnamedrows(), True)
+        row = next(c.execute("select * from foo"))
+        self.assertEqual(row, (1, 2, 3))
+        self.assertTrue(isinstance(row, tuple))
+        self.assertEqual((row.x, row.y, getattr(row, "z a")), (1, 2, 3))
+        self.assertEqual(row._fields, ("x", "y", "z a"))
+        # type is reused
+        self.assertTrue(type(next(c.execute("select * from foo"))) is type(row))
+        # schema changes
+        c.execute("alter table foo rename column x to w")
+        row = next(c.execute("select * from foo"))
+        self.assertEqual((row.w, row.y), (1, 2))
+        c.execute("alter table foo add column v")
+        row = next(c.execute("select * from foo"))
+        self.assertEqual(row._fields, ("w", "y", "z a", "v"))
+        self.assertEqual(row.v, None)
+        # connection setting
+        c.setnamedrows(None)
+        self.assertEqual(type(next(c.execute("select * from foo"))), tuple)
+        self.db.setnamedrows(True)
+        self.assertEqual(self.db.getnamedrows(), True)
+        self.assertEqual(next(c.execute("select 3 as three")).three, 3)
+        c.setnamedrows(False)
+        self.assertEqual(c.getnamedrows(), False)
+        self.assertEqual(type(next(c.execute("select 3 as three"))), tuple)
+        c.setnamedrows(None)
+        # multiple statements and row tracers
+        self.assertEqual([r._fields for r in c.execute("select 1 as one; select 2 as two")], [("one", ), ("two", )])
+        c.setrowtrace(lambda cur, row: row.one)
+        self.assertEqual(c.execute("select 7 as one").fetchall(), [7])
+        c.setrowtrace(None)
+        # duplicate and reserved names are renamed
+        row = next(c.execute("select 1 as a, 2 as a, 3 as a_1, 4 as a"))
+        self.assertEqual(row._fields, ("a", "a_1", "a_1_1", "a_2"))
+        self.assertEqual((row.a, row.a_1, row.a_1_1, row.a_2), (1, 2, 3, 4))
+        row = next(c.execute("select 3 as n_fields, 4 as _fields, 5 as __class__, 6 as n_fields_1, 7 as __, 8 as __len__"))
+        self.assertEqual(row._fields, ("n_fields_1", "_fields_1", "__class___1", "n_fields_1_1", "__", "__len___1"))
+        self.assertEqual([getattr(row, n) for n in row._fields], [3, 4, 5, 6, 7, 8])
+        self.assertEqual((row.n_fields, len(row), type(row).__name__), (6, 6, "Row"))
+        # field names stay valid whatever happens to _fields
+        rows = c.execute("select 1 as first_column_name, 2 as second_column_name union all select 3, 4").fetchall()
+        type(rows[0])._fields = None
+        del type(rows[1])._fields
+        gc.collect()
+        junk = ["Z" * 30 + str(i) for i in range(10000)]
+        self.assertEqual(repr(rows[0]), "apsw.Row(first_column_name=1, second_column_name=2)")
+        self.assertEqual(repr(rows[1]), "apsw.Row(first_column_name=3, second_column_name=4)")
+        del junk
+        # many distinct names
+        for i in range(100):
+            self.assertEqual(next(c.execute("select %d as col%d" % (i, i)))._fields, ("col%d" % i, ))
+
+    def testLazyRows(self):
+        "Verify rows that decode columns on access"
+        c = self.db.cursor()
+        vals = (1, -2.5, u"a\u1234b", b"\x00\x01", None, 0x7fffffffffffffff, u"", b"")
+        c.execute("create table foo(a,b,c,d,e,f,g,h)")
+        c.execute("insert into foo values(?,?,?,?,?,?,?,?)", vals)
+        self.assertEqual(self.db.getlazyrows(), False)
+        self.assertEqual(c.getlazyrows(), None)
+        self.assertRaises(TypeError, c.setlazyrows)
+        self.assertRaises(ZeroDivisionError, c.setlazyrows, BadIsTrue())
+        self.assertRaises(ZeroDivisionError, self.db.setlazyrows, BadIsTrue())
+        c.setlazyrows(True)
+        self.assertEqual(c.getlazyrows(), True)
+        rows = c.execute("select * from foo union all select * from foo").fetchall()
+        self.assertEqual(len(rows), 2)
+        row = rows[0]
+        self.assertTrue(isinstance(row, apsw.LazyRow))
+        self.assertEqual(len(row), len(vals))
+        for i in range(len(vals)):
+            self.assertEqual(row[i], vals[i])
+            self.assertEqual(row[i - len(vals)], vals[i])
+        # same object each time
+        self.assertTrue(row[2] is row[2])
+        self.assertRaises(IndexError, lambda: row[len(vals)])
+        self.assertRaises(IndexError, lambda: row[-len(vals) - 1])
+        self.assertRaises(TypeError, lambda: row["a"])
+        self.assertEqual(row[1:4], vals[1:4])
+        self.assertEqual(row[::-2], vals[::-2])
+        self.assertEqual(row[5:1], ())
+        self.assertEqual(tuple(row), vals)
+        self.assertEqual(list(rows[1]), list(vals))
+        self.assertEqual(row, vals)
+        self.assertEqual(row, rows[1])
+        self.assertNotEqual(row, vals[:-1])
+        self.assertNotEqual(row, list(vals))
+        self.assertEqual(hash(row), hash(vals))
+        self.assertEqual(repr(row), "LazyRow" + repr(vals))
+        # values remain after the cursor is closed
+        row = next(c.execute("select 'hello', x'aabb'"))
+        c.close()
+        self.assertEqual(row, (u"hello", b"\xaa\xbb"))
+        # connection setting, named rows and row tracers
+        c = self.db.cursor()
+        self.assertEqual(type(next(c.execute("select 3"))), tuple)
+        self.db.setlazyrows(True)
+        self.assertEqual(self.db.getlazyrows(), True)
+        self.assertEqual(type(next(c.execute("select 3"))), apsw.LazyRow)
+        if sys.version_info >= (3, 3):
+            c.setnamedrows(True)
+            self.assertEqual(type(next(c.execute("select 3"))), apsw.LazyRow)
+            c.setnamedrows(None)
+        c.setlazyrows(False)
+        self.assertEqual(type(next(c.execute("select 3"))), tuple)
+        c.setlazyrows(None)
+        c.setrowtrace(lambda cur, row: row[-1])
+        self.assertEqual(c.execute("select 1,2 union all select 3,4").fetchall(), [2, 4])
+
     def testScalarFunctions(self):
         "Verify scalar functions"
         c = self.db.cursor()
@@ -1852,6 +2538,155 @@ class APSW(unittest.TestCase):
         self.assertEqual(1, next(cur2.execute("select count(*) from test where x=123"))[0])
         con2.close()
 
+    def testBusyPolicy(self):
+        "Verify busy handling done in C"
+        db = self.db
+        db.cursor().execute("create table foo(x)")
+        self.assertRaises(TypeError, db.setbusypolicy)
+        self.assertRaises(TypeError, db.setbusypolicy, "12")
+        self.assertRaises(ValueError, db.setbusypolicy, -1)
+        self.assertRaises(ValueError, db.setbusypolicy, 100, initial_ms=-1)
+        self.assertRaises(ValueError, db.setbusypolicy, 100, initial_ms=10, max_ms=5)
+        self.assertRaises(ValueError, db.setbusypolicy, 100, multiplier=0.5)
+        self.assertRaises(ValueError, db.setbusypolicy, 100, jitter=1.5)
+        self.assertRaises(ValueError, db.setbusypolicy, 100, max_attempts=-1)
+        self.assertRaises(TypeError, db.busy_stats, "reset", "me")
+        self.assertRaises(ZeroDivisionError, db.busy_stats, BadIsTrue())
+        self.assertEqual(db.busy_stats(), {"episodes": 0, "retries": 0, "giveups": 0, "wait_seconds": 0.0, "max_wait_seconds": 0.0})
+
+        db2 = apsw.Connection(TESTFILEPREFIX + "testdb")
+        db2.cursor().execute("begin exclusive")
+        # timeout
+        db.setbusypolicy(200, initial_ms=1, max_ms=20)
+        start = time.time()
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        self.assertTrue(time.time() - start >= 0.19)
+        stats = db.busy_stats()
+        self.assertEqual(stats["episodes"], 1)
+        self.assertEqual(stats["giveups"], 1)
+        # 1+2+4+8+16 then 20 each
+        self.assertTrue(5 <= stats["retries"] < 20, stats)
+        self.assertTrue(0.15 <= stats["wait_seconds"] < 2, stats)
+        self.assertEqual(stats["wait_seconds"], stats["max_wait_seconds"])
+        # attempts
+        db.setbusypolicy(10000, initial_ms=1, max_ms=1, max_attempts=3)
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        stats = db.busy_stats(reset=True)
+        self.assertEqual(stats["episodes"], 2)
+        self.assertEqual(stats["giveups"], 2)
+        self.assertTrue(stats["retries"] >= 8, stats)
+        self.assertEqual(db.busy_stats()["retries"], 0)
+        # zero timeout gives up immediately
+        db.setbusypolicy(0)
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        self.assertEqual(db.busy_stats(True)["retries"], 0)
+
+        # lock released while waiting
+        db.setbusypolicy(10000, initial_ms=5, max_ms=50, jitter=1)
+
+        def release():
+            time.sleep(0.2)
+            db2.cursor().execute("rollback")
+
+        t = threading.Thread(target=release)
+        t.start()
+        db.cursor().execute("begin immediate; rollback")
+        t.join()
+        stats = db.busy_stats()
+        self.assertEqual(stats["giveups"], 0)
+        self.assertTrue(stats["retries"] >= 3)
+        self.assertTrue(stats["wait_seconds"] >= 0.1)
+
+        # other handlers override, and policy overrides them
+        db2.cursor().execute("begin exclusive")
+        called = []
+        db.setbusyhandler(lambda n: called.append(n) or len(called) < 3)
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        self.assertEqual(len(called), 3)
+        self.assertEqual(db.busy_stats()["episodes"], 1)
+        db.setbusypolicy(0)
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        self.assertEqual(len(called), 3)
+        self.assertEqual(db.busy_stats()["episodes"], 2)
+        db.setbusytimeout(0)
+        self.assertRaises(apsw.BusyError, db.cursor().execute, "begin immediate")
+        self.assertEqual(db.busy_stats()["episodes"], 2)
+        db2.close()
+
+    def testQueryTimeout(self):
+        "Verify query timeouts"
+        forever = "with recursive c(x) as (select 1 union all select x+1 from c) "
+        c = self.db.cursor()
+        self.assertTrue(issubclass(apsw.QueryTimeoutError, apsw.Error))
+        self.assertRaises(ValueError, c.execute, "select 3", timeout=-1)
+        self.assertRaises(TypeError, c.execute, "select 3", timeout="soon")
+        self.assertRaises(TypeError, c.execute, "select 3", timeout=1, deadline=3)
+        self.assertRaises(TypeError, self.db.setquerytimeout)
+        self.assertRaises(TypeError, self.db.setquerytimeout, "soon")
+        self.assertRaises(ValueError, self.db.setquerytimeout, -1)
+        self.assertEqual(self.db.getquerytimeout(), 0)
+        self.assertEqual(c.execute("select 3", timeout=1).fetchall(), [(3, )])
+        self.assertEqual(c.execute("select 3", timeout=None, prefetch=2).fetchall(), [(3, )])
+
+        start = time.time()
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(*) from c", timeout=0.2)
+        self.assertTrue(0.19 <= time.time() - start < 5)
+        # connection and cursor still work
+        self.assertEqual(c.execute("select 4").fetchall(), [(4, )])
+        # time between rows counts
+        c.execute(forever + "select x from c", timeout=0.2)
+        next(c)
+        time.sleep(0.25)
+        self.assertRaises(apsw.QueryTimeoutError, c.fetchall)
+        # prefetch
+        c.execute(forever + "select x from c", timeout=0.2, prefetch=10)
+        self.assertRaises(apsw.QueryTimeoutError, c.fetchall)
+
+        # connection default
+        self.db.setquerytimeout(0.2)
+        self.assertEqual(self.db.getquerytimeout(), 0.2)
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(*) from c")
+        self.assertRaises(apsw.QueryTimeoutError, c.executemany, forever + "select count(*) from c where ?", [(1, )])
+        self.assertRaises(apsw.QueryTimeoutError, self.db.cursor().execute, forever + "select count(*) from c")
+        # overriding the default
+        c.execute(forever + "select x from c", timeout=0)
+        time.sleep(0.25)
+        self.assertEqual(c.fetchmany(1000)[-1], (1000, ))
+        c.execute(forever + "select x from c where x>50000 limit 1", timeout=10)
+        time.sleep(0.25)
+        self.assertEqual(c.fetchall(), [(50001, )])
+        self.db.setquerytimeout(0)
+
+        # progress handlers still work, and are distinguished
+        calls = []
+
+        def ph():
+            calls.append(1)
+            return len(calls) > 100
+
+        self.db.setprogresshandler(ph, 50)
+        self.assertRaises(apsw.InterruptError, c.execute, forever + "select count(*) from c", timeout=100)
+        self.assertEqual(len(calls), 101)
+        del calls[:]
+        self.db.setprogresshandler(lambda: calls.append(1) and False, 1000)
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(*) from c", timeout=0.1)
+        self.assertTrue(len(calls) > 10)
+
+        def ph():
+            1 / 0
+
+        self.db.setprogresshandler(ph, 50)
+        self.assertRaises(ZeroDivisionError, c.execute, forever + "select count(*) from c", timeout=0.1)
+        self.db.setprogresshandler(None)
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(*) from c", timeout=0.1)
+
+        # statements run by user defined functions keep the outer deadline
+        inner = self.db.cursor()
+        self.db.createscalarfunction("nested", lambda: inner.execute("select 1").fetchall()[0][0])
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(nested()) from c", timeout=0.1)
+        self.db.createscalarfunction("nested", lambda: inner.execute("select 1", timeout=100).fetchall()[0][0])
+        self.assertRaises(apsw.QueryTimeoutError, c.execute, forever + "select count(nested()) from c", timeout=0.1)
+
     def testInterruptHandling(self):
         "Verify interrupt function"
         # this is tested by having a user defined function make the interrupt
@@ -3769,6 +4604,748 @@ class APSW(unittest.TestCase):
         self.db = apsw.Connection(TESTFILEPREFIX + "testdb", statementcachesize=-1)
         self.testStatementCache(-1)
 
+    def testStatementCacheLimits(self):
+        "Check statement cache entry and byte limits"
+        # the authorizer is only called when preparing, so counts cache misses
+        prepares = []
+
+        def authorizer(*args):
+            if args[0] == apsw.SQLITE_SELECT:
+                prepares.append(1)
+            return apsw.SQLITE_OK
+
+        self.db.setauthorizer(authorizer)
+        cur = self.db.cursor()
+
+        def run(sql):
+            del prepares[:]
+            self.assertEqual(cur.execute(sql).fetchall(), [(sql[8:-1], )])
+            return len(prepares)
+
+        self.assertEqual(self.db.statement_cache_limits(), (100, 16 * 1024 * 1024, 4))
+        self.assertEqual(self.db.statement_cache_limits(entries=2), (100, 16 * 1024 * 1024, 4))
+        self.assertEqual(self.db.statement_cache_limits(), (2, 16 * 1024 * 1024, 4))
+        self.assertEqual(run("select 'a'"), 1)
+        self.assertEqual(run("select 'b'"), 1)
+        self.assertEqual(run("select 'a'"), 0)
+        self.assertEqual(run("select 'c'"), 1)  # evicts b
+        self.assertEqual(run("select 'a'"), 0)
+        self.assertEqual(run("select 'b'"), 1)
+        # too big to cache
+        self.db.statement_cache_limits(bytes=10)
+        self.assertEqual(run("select 'a'"), 1)
+        self.assertEqual(run("select 'a'"), 1)
+        # disabled
+        self.assertEqual(self.db.statement_cache_limits(0, 1000000), (2, 10, 4))
+        self.assertEqual(run("select 'a'"), 1)
+        self.assertEqual(run("select 'a'"), 1)
+        self.db.statement_cache_limits(10)
+        self.assertEqual(run("select 'a'"), 1)
+        self.assertEqual(run("select 'a'"), 0)
+        # limits reduced while a cached statement is in use
+        c2 = self.db.cursor()
+        c2.execute("select 'a' union all select 'a'")
+        c2.execute("select 'a' union all select 'a'")
+        self.assertEqual(next(c2), ("a", ))
+        self.db.statement_cache_limits(0)
+        self.assertEqual(c2.fetchall(), [("a", )])
+        self.assertEqual(run("select 'a'"), 1)
+        # lots of entries coming and going
+        self.db.setauthorizer(None)
+        self.db.statement_cache_limits(37)
+        queries = ["select '%d'" % i for i in range(300)]
+        for i in range(3000):
+            q = queries[(i * 7919) % 211 + (i % 89)]
+            self.assertEqual(cur.execute(q).fetchall(), [(q[8:-1], )])
+        # non-ascii and multiple statements
+        self.assertEqual(cur.execute(u(r"select '\N{LATIN SMALL LETTER E WITH CIRCUMFLEX}'; select 3")).fetchall(),
+                         [(u(r"\N{LATIN SMALL LETTER E WITH CIRCUMFLEX}"), ), (3, )])
+        self.assertEqual(cur.execute(u(r"select '\N{LATIN SMALL LETTER E WITH CIRCUMFLEX}'; select 3")).fetchall(),
+                         [(u(r"\N{LATIN SMALL LETTER E WITH CIRCUMFLEX}"), ), (3, )])
+        self.assertRaises(TypeError, self.db.statement_cache_limits, "one")
+        self.assertRaises(TypeError, self.db.statement_cache_limits, bytes="two")
+        self.assertRaises(ValueError, self.db.statement_cache_limits, instances=0)
+
+        # nested cursors running the same query each get a cached instance
+        self.db.statement_cache_limits(entries=100, instances=3)
+        q = "select 'x' union all select 'x'"
+
+        def prepared():
+            stats = self.db.statement_cache_stats()
+            return stats["misses"] + stats["hits_inuse"]
+
+        def nest(depth):
+            rows = 0
+            for row in self.db.cursor().execute(q):
+                rows += 1 + (nest(depth - 1) if depth else 0)
+            return rows
+
+        before = prepared()
+        self.assertEqual(nest(3), 30)
+        self.assertEqual(prepared() - before, 4)
+        before = prepared()
+        self.assertEqual(nest(2), 14)
+        self.assertEqual(prepared() - before, 0)
+        self.assertEqual(len([x for x in self.db.statement_cache_stats(True)["queries"] if x["query"] == q]), 3)
+        # a fourth level is over the limit
+        before = prepared()
+        self.assertEqual(nest(3), 30)
+        self.assertEqual(prepared() - before, 8)
+        self.assertEqual(len([x for x in self.db.statement_cache_stats(True)["queries"] if x["query"] == q]), 3)
+
+    def testStatementCacheStats(self):
+        "Check statement cache statistics"
+        db = apsw.Connection(":memory:", statementcachesize=3)
+        stats = db.statement_cache_stats()
+        self.assertNotIn("queries", stats)
+        self.assertEqual(
+            stats, {
+                "hits": 0,
+                "misses": 0,
+                "hits_inuse": 0,
+                "evictions": 0,
+                "too_big": 0,
+                "entries": 0,
+                "bytes": 0,
+                "max_entries": 3,
+                "max_bytes": 16 * 1024 * 1024,
+                "max_instances": 4
+            })
+        cur = db.cursor()
+        for i in range(5):
+            cur.execute("select 1").fetchall()
+        cur.execute("select 2").fetchall()
+        stats = db.statement_cache_stats(True)
+        self.assertEqual((stats["hits"], stats["misses"], stats["entries"]), (4, 2, 2))
+        self.assertTrue(stats["bytes"] > len("select 1select 2"))
+        self.assertEqual(sum(q["bytes"] for q in stats["queries"]), stats["bytes"])
+        self.assertEqual(sorted((q["query"], q["hits"], q["inuse"]) for q in stats["queries"]), [("select 1", 4, False),
+                                                                                                  ("select 2", 0, False)])
+        # nested use of the same query
+        c2 = db.cursor()
+        c2.execute("select 1 union all select 1")
+        for row in c2.execute("select 1 union all select 1"):
+            self.assertEqual(db.cursor().execute("select 1 union all select 1").fetchall(), [(1, ), (1, )])
+            inuse = [q for q in db.statement_cache_stats(queries=True)["queries"] if q["inuse"]]
+            self.assertEqual([q["query"] for q in inuse], ["select 1 union all select 1"])
+        # the first nested execution caches a second instance which the
+        # next one can use
+        self.assertEqual(db.statement_cache_stats()["hits_inuse"], 1)
+        # evictions
+        for i in range(10):
+            cur.execute("select %d" % (i + 100)).fetchall()
+        stats = db.statement_cache_stats()
+        self.assertEqual(stats["entries"], 3)
+        self.assertEqual(stats["evictions"], stats["misses"] + stats["hits_inuse"] - 3)
+        db.statement_cache_limits(bytes=10)
+        self.assertEqual(db.statement_cache_stats()["entries"], 0)
+        cur.execute("select 1").fetchall()
+        self.assertEqual(db.statement_cache_stats()["too_big"], 1)
+        self.assertRaises(TypeError, db.statement_cache_stats, 1, 2)
+
+    def testStatementStatus(self):
+        "Check statement status counters"
+        c = self.db.cursor()
+        c.execute("create table foo(x,y); create table bar(z)")
+        c.executemany("insert into foo values(?,?)", [(i, i * 2) for i in range(100)])
+        c.executemany("insert into bar values(?)", [(i, ) for i in range(100)])
+        self.assertRaises(apsw.ExecutionCompleteError, c.statement_status)
+        self.assertRaises(TypeError, c.statement_status, 1, 2)
+        self.assertRaises(TypeError, c.statement_status, foo=1)
+        keys = {"fullscan_steps", "sorts", "autoindex", "vm_steps", "reprepares", "runs", "memused"}
+        query = "select x from foo order by y desc"
+        for row in c.execute(query):
+            status = c.statement_status()
+            self.assertEqual(set(status.keys()), keys)
+            self.assertEqual(status["sorts"], 1)
+            self.assertEqual(status["fullscan_steps"], 99)
+            self.assertEqual(status["runs"], 1)
+            self.assertTrue(status["vm_steps"] > 100)
+            self.assertTrue(status["memused"] > 0)
+            self.assertEqual(status, c.statement_status(reset=True))
+            after = c.statement_status()
+            self.assertEqual(after["sorts"], 0)
+            self.assertEqual(after["vm_steps"], 0)
+            self.assertEqual(after["memused"], status["memused"])
+            break
+        c.close(True)
+        c = self.db.cursor()
+        # counters accumulate over executions of cached statements
+        c.execute(query).fetchall()
+        for i in range(2):
+            c.execute("select * from foo, bar where y=z").fetchall()
+        stats = dict((q["query"], q) for q in self.db.statement_cache_stats(True)["queries"])
+        self.assertEqual(stats[query]["runs"], 1)
+        self.assertEqual(stats[query]["sorts"], 1)
+        self.assertEqual(stats["select * from foo, bar where y=z"]["runs"], 2)
+        self.assertTrue(stats["select * from foo, bar where y=z"]["autoindex"] > 0)
+        self.assertEqual(stats["insert into bar values(?)"]["runs"], 100)
+        for q in stats.values():
+            self.assertTrue(keys.issubset(q.keys()))
+        c.close()
+        self.assertRaises(apsw.CursorClosedError, c.statement_status)
+        # walking the cache while another thread evicts entries
+        self.db.statement_cache_limits(entries=8)
+        stop = []
+
+        def churn():
+            cur = self.db.cursor()
+            i = 0
+            while not stop:
+                cur.execute("select %d from foo where x>?" % (i % 50), (i % 100, )).fetchall()
+                i += 1
+
+        t = ThreadRunner(churn)
+        t.start()
+        try:
+            for i in range(200):
+                for q in self.db.statement_cache_stats(True)["queries"]:
+                    self.assertTrue(keys.issubset(q.keys()))
+        finally:
+            stop.append(1)
+            t.go()
+
+    def testScanStatus(self):
+        "Check query plan scan status"
+        c = self.db.cursor()
+        if not hasattr(c, "scanstatus"):
+            return
+        self.assertRaises(apsw.ExecutionCompleteError, c.scanstatus)
+        self.assertRaises(TypeError, c.scanstatus, 1, 2)
+        c.execute("create table foo(x,y); create index fooy on foo(y)")
+        c.executemany("insert into foo values(?,?)", [(i, i % 10) for i in range(100)])
+        query = "select * from foo where x>?; select * from foo where y=?"
+        c.execute(query, (90, 3)).fetchall()
+        status = c.scanstatus()
+        self.assertEqual(len(status), 1)
+        self.assertEqual(set(status[0].keys()), {"name", "explain", "loops", "rows_visited", "estimated_rows", "selectid"})
+        self.assertEqual(status[0]["name"], "fooy")
+        self.assertIn("fooy", status[0]["explain"])
+        self.assertEqual(status[0]["loops"], 1)
+        self.assertEqual(status[0]["rows_visited"], 10)
+        # accumulates until reset
+        c.execute(query, (90, 3)).fetchall()
+        self.assertEqual(c.scanstatus(reset=True)[0]["loops"], 2)
+        self.assertEqual(c.scanstatus()[0]["loops"], 0)
+        # current statement
+        for row in c.execute("select * from foo"):
+            status = c.scanstatus()
+            self.assertEqual(status[0]["name"], "foo")
+            self.assertTrue(status[0]["rows_visited"] >= 1)
+            break
+        c.close(True)
+        self.assertRaises(apsw.CursorClosedError, c.scanstatus)
+        # statement not cached
+        self.db.statement_cache_limits(entries=0)
+        c = self.db.cursor()
+        c.execute("select * from foo where y=2").fetchall()
+        self.assertEqual(c.scanstatus()[0]["rows_visited"], 10)
+        # nothing once something else starts
+        self.assertRaises(apsw.SQLError, c.execute, "select * from nosuchtable")
+        self.assertRaises(apsw.ExecutionCompleteError, c.scanstatus)
+
+    def testStatementCacheScripts(self):
+        "Check multiple statement scripts in the statement cache"
+        db = apsw.Connection(":memory:", statementcachesize=10)
+        c = db.cursor()
+        c.execute("create table foo(x)")
+        script = "insert into foo(x) values(?); select count(*) from foo; select max(x) from foo where x<?"
+        for i in range(5):
+            self.assertEqual(c.execute(script, (i, 100)).fetchall(), [(i + 1, ), (i, )])
+        stats = db.statement_cache_stats(True)
+        self.assertEqual(stats["hits"], 12)
+        self.assertEqual(sorted(q["hits"] for q in stats["queries"] if q["query"] in script), [4, 4, 4])
+        # nested use of the same script
+        for row in c.execute(script, (10, 100)):
+            self.assertEqual(db.cursor().execute(script, (20, 15)).fetchall(), [(row[0] + 1, ), (10, )])
+            break
+        c.close(True)
+        for i in range(3):
+            self.assertEqual(db.cursor().execute(script, (30 + i, 100)).fetchall(), [(8 + i, ), (30 + i, )])
+        # chained statements being evicted
+        db.statement_cache_limits(entries=2)
+        for i in range(3):
+            self.assertEqual(db.cursor().execute(script, (40 + i, 100)).fetchall(), [(11 + i, ), (40 + i, )])
+        db.statement_cache_limits(entries=10)
+        for i in range(3):
+            self.assertEqual(db.cursor().execute(script, (50 + i, 100)).fetchall(), [(14 + i, ), (50 + i, )])
+        # schema changes
+        db.cursor().execute("alter table foo add column y")
+        self.assertEqual(db.cursor().execute(script, (60, 100)).fetchall(), [(17, ), (60, )])
+        self.assertEqual(db.cursor().execute(script + "; select y from foo where x=70", (70, 100)).fetchall(),
+                         [(18, ), (70, ), (None, )])
+        # errors part way through
+        db.cursor().execute("create table bar(z)")
+        bad = "select 1; select z from bar; select 3"
+        self.assertEqual(db.cursor().execute(bad).fetchall(), [(1, ), (3, )])
+        self.assertEqual(db.cursor().execute(bad).fetchall(), [(1, ), (3, )])
+        db.cursor().execute("drop table bar")
+        self.assertRaises(apsw.SQLError, db.cursor().execute(bad).fetchall)
+        self.assertRaises(apsw.SQLError, db.cursor().execute(bad).fetchall)
+        db.cursor().execute("create table bar(z)")
+        self.assertEqual(db.cursor().execute(bad).fetchall(), [(1, ), (3, )])
+        db.close()
+
+    def testStatementCachePreload(self):
+        "Check preloading the statement cache"
+        queries = ["select * from foo", "select z from bar where z=?", "insert into foo values(?,?); select 3"]
+        db = apsw.Connection(":memory:", statementcachesize=10)
+        self.assertEqual(db.statement_cache_manifest(), [])
+        db.cursor().execute("create table foo(x,y); create table bar(z)")
+        start = db.statement_cache_stats()["misses"]
+        db.preload_statements(queries)
+        self.assertEqual(db.statement_cache_stats()["misses"] - start, 4)
+        manifest = db.statement_cache_manifest()
+        self.assertEqual(manifest[-4:], queries + ["select 3"])
+        # executing uses the cache
+        hits = db.statement_cache_stats()["hits"]
+        cur = db.cursor()
+        cur.execute("insert into foo values(?,?); select 3", (1, 2)).fetchall()
+        cur.execute("select * from foo").fetchall()
+        self.assertEqual(db.statement_cache_stats()["hits"] - hits, 3)
+        self.assertEqual(db.statement_cache_manifest()[-3:],
+                         ["insert into foo values(?,?); select 3", "select 3", "select * from foo"])
+        # in use queries come last, once
+        for row in cur.execute("select z from bar union all select 1"):
+            db.cursor().execute("select z from bar union all select 1").fetchall()
+            m = db.statement_cache_manifest()
+            self.assertEqual(m[-1], "select z from bar union all select 1")
+            self.assertEqual(len(m), len(set(m)))
+        # recreate elsewhere
+        db2 = apsw.Connection(":memory:", statementcachesize=10)
+        db2.cursor().execute("create table foo(x,y); create table bar(z)")
+        db2.preload_statements(iter(db.statement_cache_manifest()))
+        self.assertEqual(db2.statement_cache_manifest()[-6:], db.statement_cache_manifest()[-6:])
+        # limits apply
+        db2.statement_cache_limits(entries=2)
+        db2.preload_statements(queries)
+        self.assertEqual(db2.statement_cache_manifest(), queries[2:] + ["select 3"])
+        # errors
+        self.assertRaises(TypeError, db.preload_statements)
+        self.assertRaises(TypeError, db.preload_statements, 3)
+        self.assertRaises(TypeError, db.preload_statements, [3])
+        self.assertRaises(TypeError, db.preload_statements, [db.prepare("select 4")])
+        self.assertRaises(apsw.SQLError, db.preload_statements, ["select 4", "select * from nosuchtable", "select 5"])
+        m = db.statement_cache_manifest()
+        self.assertIn("select 4", m)
+        self.assertNotIn("select 5", m)
+        self.assertRaises(ZeroDivisionError, db.preload_statements, ("select %d" % (1 / x) for x in (1, 0)))
+        self.assertRaises(TypeError, db.statement_cache_manifest, 1)
+        db.preload_statements([])
+        db.preload_statements([""])
+
+    def testPreparedStatement(self):
+        "Check prepared statements"
+        c = self.db.cursor()
+        c.execute("create table foo(x,y)")
+        self.assertRaises(TypeError, self.db.prepare)
+        self.assertRaises(TypeError, self.db.prepare, 3)
+        self.assertRaises(ValueError, self.db.prepare, "select 1; select 2")
+        self.assertRaises(apsw.SQLError, self.db.prepare, "selec 1")
+        ins = self.db.prepare("insert into foo values(?,?)")
+        self.assertTrue(isinstance(ins, apsw.PreparedStatement))
+        self.assertEqual(ins.sql, "insert into foo values(?,?)")
+        ins.executemany([(i, i * 2) for i in range(10)])
+        ins.execute((10, 20))
+        self.assertRaises(apsw.BindingsError, ins.execute, (1, ))
+        self.assertRaises(apsw.BindingsError, ins.execute)
+        self.assertRaises(TypeError, ins.execute, 1, 2)
+        q = self.db.prepare("select y from foo where x=$x", False)
+        self.assertEqual(q.execute({"x": 3}).fetchall(), [(6, )])
+        # bindings from bind
+        q.bind({"x": 4})
+        self.assertEqual(q.execute().fetchall(), [(8, )])
+        self.assertEqual(q.execute({"x": 5}).fetchall(), [(10, )])
+        self.assertEqual(q.execute(None).fetchall(), [(8, )])
+        q.bind(None)
+        self.assertRaises(apsw.BindingsError, q.execute)
+        # execute restarts
+        self.assertEqual(next(q.execute({"x": 1})), (2, ))
+        self.assertEqual(q.execute({"x": 2}).fetchall(), [(4, )])
+        # cursor execution
+        self.assertEqual(c.execute(q, {"x": 7}).fetchall(), [(14, )])
+        self.assertEqual(c.execute(q, {"x": 7}).getdescription(), (("y", None), ))
+        self.assertEqual(list(c.executemany(q, [{"x": 1}, {"x": 2}])), [(2, ), (4, )])
+        # only one execution at a time
+        for row in c.execute(q, {"x": 1}):
+            self.assertRaises(apsw.ThreadingViolationError, self.db.cursor().execute, q, {"x": 1})
+            self.assertRaises(apsw.ThreadingViolationError, q.execute, {"x": 1})
+        self.assertEqual(q.execute({"x": 9}).fetchall(), [(18, )])
+        # not cached
+        self.assertEqual([s["query"] for s in self.db.statement_cache_stats(True)["queries"] if "$x" in s["query"]], [])
+        # other connection
+        db2 = apsw.Connection(":memory:")
+        self.assertRaises(ValueError, db2.cursor().execute, q)
+        db2.close()
+        # closing
+        self.assertRaises(TypeError, q.close, "a")
+        cur = q.execute({"x": 2})
+        q.close()
+        q.close()
+        self.assertRaises(ValueError, q.execute)
+        self.assertRaises(ValueError, q.executemany, [])
+        self.assertRaises(ValueError, q.bind, None)
+        self.assertRaises(ValueError, getattr, q, "sql")
+        self.assertRaises(ValueError, c.execute, q)
+        # closing while the cursor is stepping in another thread
+        entered, release = threading.Event(), threading.Event()
+
+        def wait(x):
+            if x == 3:
+                entered.set()
+                release.wait(10)
+            return x
+
+        self.db.createscalarfunction("waitfor", wait)
+        q = self.db.prepare("select waitfor(x) from (select distinct x from foo where x<10) order by x")
+        t = ThreadRunner(lambda: [r[0] for r in q.execute()])
+        t.start()
+        self.assertTrue(entered.wait(10))
+        self.assertRaises(apsw.ThreadingViolationError, q.close, True)
+        self.assertRaises(apsw.ThreadingViolationError, q.execute)
+        release.set()
+        self.assertEqual(t.go(), list(range(10)))
+        q.close()
+        # and re-entrantly
+        q = self.db.prepare("select waitfor(x) from foo where x=0")
+        self.db.createscalarfunction("waitfor", lambda x: q.close(True))
+        self.assertRaises(apsw.ThreadingViolationError, q.execute)
+        self.db.createscalarfunction("waitfor", lambda x: q.executemany([()]))
+        self.assertRaises(apsw.ThreadingViolationError, q.execute)
+        q.close()
+        # connection closing closes prepared statements
+        q = self.db.prepare("select 3")
+        self.assertEqual(c.execute(q).fetchall(), [(3, )])
+        q2 = self.db.prepare("select 4")
+        del q2
+        gc.collect()
+        self.db.close()
+        self.assertRaises(ValueError, q.execute)
+        self.assertRaises(apsw.ConnectionClosedError, self.db.prepare, "select 3")
+
+    def testConnectionPool(self):
+        "Check connection pools"
+        self.assertRaises(TypeError, apsw.ConnectionPool)
+        self.assertRaises(ValueError, apsw.ConnectionPool, TESTFILEPREFIX + "testdb", readers=0)
+        self.assertRaises(TypeError, apsw.ConnectionPool, TESTFILEPREFIX + "testdb", readers="three")
+        self.assertRaises(apsw.CantOpenError, apsw.ConnectionPool, TESTFILEPREFIX + "testdb2", flags=apsw.SQLITE_OPEN_READONLY)
+        pool = apsw.ConnectionPool(TESTFILEPREFIX + "testdb", readers=3)
+        self.assertEqual(pool.readers, 3)
+        self.assertEqual(pool.available, (True, 3))
+        self.assertRaises(TypeError, pool.reader, "forever")
+        with pool.writer() as db:
+            self.assertTrue(isinstance(db, apsw.Connection))
+            self.assertEqual(pool.available, (False, 3))
+            self.assertEqual(db.cursor().execute("pragma journal_mode").fetchall()[0][0], "wal")
+            db.cursor().execute("create table foo(x); insert into foo values(1)")
+            # writer is exclusive
+            self.assertRaises(apsw.BusyError, pool.writer(timeout=0).__enter__)
+            start = time.time()
+            self.assertRaises(apsw.BusyError, pool.writer(timeout=0.2).__enter__)
+            self.assertTrue(time.time() - start >= 0.15)
+        self.assertEqual(pool.available, (True, 3))
+        # readers can't change anything
+        with pool.reader() as db:
+            self.assertEqual(db.cursor().execute("select * from foo").fetchall(), [(1, )])
+            self.assertRaises(apsw.ReadOnlyError, db.cursor().execute, "insert into foo values(2)")
+        # distinct readers
+        with pool.reader() as r1, pool.reader() as r2, pool.reader() as r3:
+            self.assertEqual(len(set(id(r) for r in (r1, r2, r3))), 3)
+            self.assertEqual(pool.available, (True, 0))
+            self.assertRaises(apsw.BusyError, pool.reader(timeout=0.01).__enter__)
+        # checkout objects
+        checkout = pool.reader()
+        self.assertRaises(ValueError, checkout.__exit__, None, None, None)
+        db = checkout.__enter__()
+        self.assertRaises(ValueError, checkout.__enter__)
+        self.assertEqual(pool.available, (True, 2))
+        del checkout
+        gc.collect()
+        self.assertEqual(pool.available, (True, 3))
+        # open transactions are rolled back
+        with pool.writer() as db:
+            db.cursor().execute("begin; insert into foo values(2)")
+        with pool.writer() as db:
+            self.assertTrue(db.getautocommit())
+            self.assertEqual(db.cursor().execute("select count(*) from foo").fetchall()[0][0], 1)
+        # exceptions pass through
+        try:
+            with pool.writer() as db:
+                db.cursor().execute("begin; insert into foo values(2)")
+                1 / 0
+        except ZeroDivisionError:
+            pass
+        self.assertEqual(pool.available, (True, 3))
+        # closed connections are replaced
+        with pool.writer() as db:
+            db.close()
+        with pool.writer() as db2:
+            self.assertEqual(db2.cursor().execute("select count(*) from foo").fetchall()[0][0], 1)
+        self.assertTrue(db is not db2)
+        # connection hooks run for each connection
+        opened = []
+        apsw.connection_hooks = [opened.append]
+        pool2 = apsw.ConnectionPool(TESTFILEPREFIX + "testdb", readers=2, wal=False)
+        self.assertEqual(len(opened), 3)
+        pool2.close()
+        apsw.connection_hooks = [lambda c: 1 / 0]
+        self.assertRaises(ZeroDivisionError, apsw.ConnectionPool, TESTFILEPREFIX + "testdb")
+        apsw.connection_hooks = []
+
+        # threads
+        def reader(results):
+            for i in range(20):
+                with pool.reader() as db:
+                    results.append(db.cursor().execute("select count(*) from foo").fetchall()[0][0])
+                    time.sleep(0.001)
+
+        def writer():
+            for i in range(20):
+                with pool.writer() as db:
+                    with db:
+                        db.cursor().execute("insert into foo values(?)", (i, ))
+                        time.sleep(0.001)
+
+        results = []
+        threads = [threading.Thread(target=reader, args=(results, )) for i in range(6)]
+        threads.extend(threading.Thread(target=writer) for i in range(3))
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(len(results), 120)
+        self.assertEqual(pool.available, (True, 3))
+        with pool.reader() as db:
+            self.assertEqual(db.cursor().execute("select count(*) from foo").fetchall()[0][0], 61)
+
+        # closing
+        checkout = pool.writer()
+        db = checkout.__enter__()
+        got = []
+
+        def waiter():
+            try:
+                with pool.writer():
+                    got.append(None)
+            except ValueError as e:
+                got.append(e)
+
+        t = threading.Thread(target=waiter)
+        t.start()
+        time.sleep(0.1)
+        pool.close()
+        t.join()
+        self.assertEqual(len(got), 1)
+        self.assertTrue(isinstance(got[0], ValueError))
+        pool.close()
+        # checked out connection still works until returned
+        self.assertEqual(db.cursor().execute("select 3").fetchall(), [(3, )])
+        checkout.__exit__(None, None, None)
+        self.assertRaises(apsw.ConnectionClosedError, db.cursor)
+        self.assertRaises(ValueError, pool.reader)
+        self.assertRaises(ValueError, getattr, pool, "available")
+        self.assertEqual(pool.readers, 3)
+
+    def testAsyncio(self):
+        "Check apsw.aio"
+        if not hasattr(apsw, "aio"):
+            return
+        import asyncio
+        from apsw import aio
+
+        async def main():
+            db = await aio.connect(TESTFILEPREFIX + "testdb", batch=10)
+            self.assertTrue(isinstance(db.connection, apsw.Connection))
+            self.assertEqual(db.batch, 10)
+            c = await db.execute("create table foo(x,y)")
+            self.assertEqual(await c.fetchall(), [])
+            self.assertEqual(await c.fetchone(), None)
+            await db.executemany("insert into foo values(?,?)", [(i, "a" * i) for i in range(95)])
+            # rows come back in batches
+            calls = []
+            run = db.run
+
+            def counting(*args):
+                calls.append(args)
+                return run(*args)
+
+            db.run = counting
+            c = await db.execute("select x from foo where x>=?", (5, ))
+            self.assertEqual(c.getdescription(), (("x", None), ))
+            self.assertEqual([row async for row in c], [(i, ) for i in range(5, 95)])
+            self.assertEqual(len(calls), 10)
+            del db.run
+            # results smaller than a batch, and empty ones
+            c = await db.execute("select 1 as a, 2 as b")
+            self.assertEqual(c.getdescription(), (("a", None), ("b", None)))
+            self.assertEqual(await c.fetchall(), [(1, 2)])
+            self.assertEqual(c.getdescription(), (("a", None), ("b", None)))
+            c = await db.execute("select x, y from foo where x<0")
+            self.assertEqual(c.getdescription(), (("x", None), ("y", None)))
+            self.assertEqual(await c.fetchall(), [])
+            c = await db.execute("create table bar(z)")
+            self.assertEqual(c.getdescription(), ())
+            c = await db.executemany("insert into bar values(?)", [(1, ), (2, )])
+            self.assertEqual(c.getdescription(), ())
+            c = await db.executemany("insert into bar values(?)", [])
+            self.assertRaises(apsw.ExecutionCompleteError, c.getdescription)
+            self.assertEqual(await (await db.execute("select count(*) from bar")).fetchall(), [(2, )])
+            c = await db.executemany("select x from foo where x=?", [(-1, ), (-2, )])
+            self.assertEqual(c.getdescription(), (("x", None), ))
+            # connection execution tracers are called exactly as usual
+            traced = []
+            await db.run(lambda db: db.setexectrace(lambda *args: traced.append(args[1]) or True))
+            c = await db.execute("select 1 as a; select 2 as b")
+            self.assertEqual(await c.fetchall(), [(1, ), (2, )])
+            self.assertEqual(c.getdescription(), (("a", None), ))
+            self.assertEqual(traced, ["select 1 as a;", "select 2 as b"])
+            del traced[:]
+            c = await db.executemany("select x from foo where x=?", [(-1, ), (-2, ), (3, )])
+            self.assertEqual(c.getdescription(), (("x", None), ))
+            self.assertEqual(await c.fetchall(), [(3, )])
+            self.assertEqual(len(traced), 3)
+            await db.run(lambda db: db.setexectrace(None))
+            c = await db.execute("select x from foo order by x")
+            self.assertEqual(await c.fetchone(), (0, ))
+            self.assertEqual(await c.fetchone(), (1, ))
+            self.assertEqual(len(await c.fetchall()), 93)
+            self.assertEqual(await c.fetchone(), None)
+            # exceptions are raised in the coroutine
+            try:
+                await db.execute("select * from nosuchtable")
+                1 / 0
+            except apsw.SQLError:
+                pass
+            try:
+                await db.run(lambda db: 1 / 0)
+                self.fail("Exception expected")
+            except ZeroDivisionError:
+                pass
+            self.assertEqual(await db.run(lambda conn, a, b=0: (conn is db.connection, a + b), 3, b=4), (True, 7))
+
+            # the loop keeps running during a slow query
+            def slow(x):
+                time.sleep(0.01)
+                return x
+
+            await db.run(lambda db: db.createscalarfunction("slow", slow))
+            ticks = []
+
+            async def ticker():
+                while True:
+                    ticks.append(None)
+                    await asyncio.sleep(0.005)
+
+            t = asyncio.ensure_future(ticker())
+            c = await db.execute("select slow(x) from foo where x<20")
+            self.assertEqual(len(await c.fetchall()), 20)
+            t.cancel()
+            self.assertTrue(len(ticks) > 5)
+
+            # cancelled awaits don't stop later calls
+            f = asyncio.ensure_future(db.execute("select slow(x) from foo where x<5"))
+            await asyncio.sleep(0)
+            f.cancel()
+            self.assertEqual(await (await db.execute("select count(*) from foo")).fetchall(), [(95, )])
+
+            await db.close()
+            await db.close()
+            self.assertRaises(apsw.ConnectionClosedError, db.connection.cursor)
+            try:
+                await db.execute("select 3")
+                1 / 0
+            except apsw.ConnectionClosedError:
+                pass
+
+            # context manager and open failures
+            async with await aio.connect(TESTFILEPREFIX + "testdb") as db:
+                self.assertEqual(await (await db.execute("select count(*) from foo")).fetchall(), [(95, )])
+            self.assertRaises(apsw.ConnectionClosedError, db.connection.cursor)
+            try:
+                await aio.connect(TESTFILEPREFIX + "testdb2", flags=apsw.SQLITE_OPEN_READONLY)
+                1 / 0
+            except apsw.CantOpenError:
+                pass
+
+        loop = asyncio.new_event_loop()
+        try:
+            loop.run_until_complete(main())
+        finally:
+            loop.close()
+
+    def testGroupCommit(self):
+        "Check group commit"
+        db = self.db
+        db.cursor().execute("create table foo(x unique)")
+        self.assertRaises(ValueError, db.group_execute, "insert into foo values(1)")
+        self.assertRaises(TypeError, db.group_commit)
+        self.assertRaises(TypeError, db.group_commit, "10")
+        self.assertRaises(ValueError, db.group_commit, -1)
+        self.assertRaises(ValueError, db.group_commit, 10, 0)
+        db.group_commit(0)
+        commits = []
+
+        def commithook():
+            commits.append(1)
+            return False
+
+        db.setcommithook(commithook)
+        self.assertEqual(db.group_execute("insert into foo values(?)", (1, )), None)
+        self.assertEqual(len(commits), 1)
+        self.assertTrue(db.getautocommit())
+        # a failing write doesn't affect others and gets its own exception
+        self.assertRaises(apsw.ConstraintError, db.group_execute, "insert into foo values(2); insert into foo values(1)")
+        self.assertEqual(db.cursor().execute("select * from foo").fetchall(), [(1, )])
+        self.assertRaises(apsw.SQLError, db.group_execute, "insert into nosuchtable values(1)")
+        db.group_execute("select * from foo")
+        db.group_execute("insert into foo values(:x)", {"x": 3})
+
+        # many threads
+        db.group_commit(window_ms=50, max_batch=25)
+        del commits[:]
+        errors = []
+
+        def writer(n):
+            for i in range(10):
+                try:
+                    db.group_execute("insert into foo values(?)", (n * 100 + i, ))
+                except apsw.ConstraintError as e:
+                    errors.append(e)
+
+        threads = [threading.Thread(target=writer, args=(n + 1, )) for n in range(20)]
+        # thread 1 will conflict with row 103
+        db.group_execute("insert into foo values(103)")
+        del commits[:]
+        start = time.time()
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+        self.assertEqual(len(errors), 1)
+        self.assertEqual(db.cursor().execute("select count(*) from foo").fetchall()[0][0], 3 + 199)
+        # far fewer commits than writes
+        self.assertTrue(len(commits) <= 20, len(commits))
+        self.assertTrue(time.time() - start < 20)
+
+        # the whole batch fails
+        db.setcommithook(lambda: True)
+        self.assertRaises(apsw.ConstraintError, db.group_execute, "insert into foo values(0)")
+        db.setcommithook(None)
+        self.assertEqual(db.cursor().execute("select count(*) from foo where x=0").fetchall()[0][0], 0)
+        db.cursor().execute("begin")
+        self.assertRaises(apsw.SQLError, db.group_execute, "insert into foo values(0)")
+        db.cursor().execute("rollback")
+        # busy
+        db2 = apsw.Connection(TESTFILEPREFIX + "testdb")
+        db2.cursor().execute("begin immediate")
+        self.assertRaises(apsw.BusyError, db.group_execute, "insert into foo values(0)")
+        db2.cursor().execute("rollback")
+        db2.close()
+        db.group_commit(0)
+        db.group_execute("insert into foo values(0)")
+        db.close()
+        self.assertRaises(apsw.ConnectionClosedError, db.group_execute, "insert into foo values(-1)")
+
     def testWikipedia(self):
         "Use front page of wikipedia to check unicode handling"
         # the text also includes characters that can't be represented in 16 bits
@@ -3796,7 +5373,7 @@ class APSW(unittest.TestCase):
         'sqlite3api': { # items of interest - sqlite3 calls
                         'match': re.compile(r"(sqlite3_[A-Za-z0-9_]+)\s*\("),
                         # what must also be on same or preceding line
-                        'needs': re.compile("PYSQLITE(_|_BLOB_|_CON_|_CUR_|_SC_|_VOID_|_BACKUP_)CALL"),
+                        'needs': re.compile("PYSQLITE(_|_BLOB_|_CON_|_CUR_|_SC_|_VOID_|_BACKUP_|_LOCKED_)CALL"),
 
            # except if match.group(1) matches this - these don't
            # acquire db mutex so no need to wrap (determined by
@@ -3839,14 +5416,14 @@ class APSW(unittest.TestCase):
 
     def sourceCheckFunction(self, filename, name, lines):
         # not further checked
-        if name.split("_")[0] in ("ZeroBlobBind", "APSWVFS", "APSWVFSFile", "APSWBuffer", "FunctionCBInfo",
-                                  "apswurifilename"):
+        if name.split("_")[0] in ("ZeroBlobBind", "APSWLazyRow", "APSWVFS", "APSWVFSFile", "APSWBuffer", "FunctionCBInfo",
+                                  "apswurifilename", "PoolCheckout", "groupcommit"):
             return
 
         checks = {
             "APSWCursor": {
-                "skip": ("dealloc", "init", "dobinding", "dobindings", "doexectrace", "dorowtrace", "step", "close",
-                         "close_internal"),
+                "skip": ("dealloc", "init", "dobinding", "dobinding_planned", "dobindings", "bindlifetime", "doexectrace", "dorowtrace", "step", "close",
+                         "close_internal", "getrow", "getlazyrow"),
                 "req": {
                     "use": "CHECK_USE",
                     "closed": "CHECK_CURSOR_CLOSED",
@@ -3855,7 +5432,8 @@ class APSW(unittest.TestCase):
             },
             "Connection": {
                 "skip": ("internal_cleanup", "dealloc", "init", "close", "interrupt", "close_internal",
-                         "remove_dependent", "readonly", "getmainfilename", "db_filename"),
+                         "remove_dependent", "readonly", "getmainfilename", "db_filename", "group_execute",
+                         "installprogress"),
                 "req": {
                     "use": "CHECK_USE",
                     "closed": "CHECK_CLOSED",
@@ -3870,6 +5448,21 @@ class APSW(unittest.TestCase):
                 },
                 "order": ("use", "closed")
             },
+            "APSWPreparedStatement": {
+                "skip": ("dealloc", "init", "close_internal", "getcursor", "close"),
+                "req": {
+                    "use": "CHECK_USE",
+                    "closed": "CHECK_PREPARED_CLOSED"
+                },
+                "order": ("use", "closed")
+            },
+            "ConnectionPool": {
+                "skip": ("dealloc", "init", "signal", "open", "close_internal", "findfree", "return", "reader", "writer",
+                         "close", "getreaders"),
+                "req": {
+                    "closed": "CHECK_POOL_CLOSED"
+                },
+            },
             "APSWBackup": {
                 "skip": ("dealloc", "init", "close_internal", "get_remaining", "get_pagecount"),
                 "req": {
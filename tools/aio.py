@@ -0,0 +1,247 @@
+#!/usr/bin/env python3
+
+# This is compiled into the C source and available as apsw.aio
+
+import asyncio
+import threading
+import queue
+import apsw
+
+
+def connect(*args, **kwargs):
+    """Opens a :class:`apsw.Connection` on a new worker thread and returns
+    an awaitable giving the :class:`apsw.aio.Connection`.  The
+    arguments are the same as for :class:`apsw.Connection` with these
+    additional keywords:
+
+    :param batch: How many rows are fetched at a time by the worker
+    :param loop: The event loop, default being the running loop"""
+    batch = kwargs.pop("batch", 256)
+    loop = kwargs.pop("loop", None)
+    worker = _Worker(loop or asyncio.get_event_loop())
+    future = worker.submit(apsw.Connection, *args, **kwargs)
+
+    async def opened():
+        try:
+            return Connection(await future, worker, batch)
+        except:
+            worker.stop()
+            raise
+
+    return opened()
+
+
+class _Worker(object):
+    "Runs calls in order on a dedicated thread, resolving futures on the event loop"
+
+    def __init__(self, loop):
+        self.loop = loop
+        self.queue = queue.Queue()
+        self.thread = threading.Thread(target=self.run, name="apsw.aio worker")
+        self.thread.daemon = True
+        self.thread.start()
+
+    def submit(self, func, *args, **kwargs):
+        future = self.loop.create_future()
+        self.queue.put((future, func, args, kwargs))
+        return future
+
+    def stop(self):
+        self.queue.put(None)
+
+    def run(self):
+        while True:
+            job = self.queue.get()
+            if job is None:
+                return
+            future, func, args, kwargs = job
+            if future.cancelled():
+                continue
+            try:
+                result, exc = func(*args, **kwargs), None
+            except BaseException as e:
+                result, exc = None, e
+            try:
+                self.loop.call_soon_threadsafe(self.resolve, future, result, exc)
+            except RuntimeError:
+                # loop has been closed
+                pass
+            del job, future, result, exc
+
+    @staticmethod
+    def resolve(future, result, exc):
+        if future.cancelled():
+            return
+        if exc is not None:
+            future.set_exception(exc)
+        else:
+            future.set_result(result)
+
+
+def _describe(db, statements, bindings):
+    """Returns the description of the first statement, or None if it
+    can't be found.  The statement is prepared but an execution tracer
+    stops it from running."""
+    description = []
+
+    def tracer(cursor, sql, bindings):
+        description.append(cursor.getdescription())
+        return False
+
+    cursor = db.cursor()
+    cursor.setexectrace(tracer)
+    try:
+        cursor.execute(statements, bindings)
+    except apsw.Error:
+        pass
+    finally:
+        cursor.close(True)
+    return description[0] if description else None
+
+
+class Connection(object):
+    """Wraps a :class:`apsw.Connection` so that queries run on its worker
+    thread while the event loop carries on.  Use :func:`apsw.aio.connect`
+    to make one.
+
+    Calls are run one at a time in the order they are made.  Result
+    rows are fetched by the worker :attr:`batch` at a time using
+    :meth:`apsw.Cursor.fetchmany` so the event loop only wakes once per
+    batch."""
+
+    def __init__(self, connection, worker, batch):
+        self.connection = connection
+        "The underlying :class:`apsw.Connection`"
+        self.batch = batch
+        "How many rows are fetched at a time"
+        self._worker = worker
+
+    def run(self, func, *args, **kwargs):
+        """Calls ``func(connection, *args, **kwargs)`` on the worker thread
+        and returns an awaitable for the result.  Use this for any other
+        :class:`apsw.Connection` methods, or several operations that
+        should happen together::
+
+            def transfer(db, amount):
+                with db:
+                    db.cursor().execute("update ...", (amount,))
+                    db.cursor().execute("update ...", (amount,))
+
+            await conn.run(transfer, 100)
+        """
+        if self._worker is None:
+            raise apsw.ConnectionClosedError("The connection has been closed")
+        return self._worker.submit(func, self.connection, *args, **kwargs)
+
+    def _execute(self, method, statements, bindings):
+        def work(db):
+            cursor = getattr(db.cursor(), method)(statements, bindings)
+            # the description has to be taken before fetching, while a
+            # row is pending
+            try:
+                description = cursor.getdescription()
+            except apsw.ExecutionCompleteError:
+                if method == "executemany":
+                    bindings_ = bindings[0] if isinstance(bindings, (list, tuple)) and bindings else None
+                else:
+                    bindings_ = bindings
+                description = _describe(db, statements, bindings_)
+            return cursor, description, cursor.fetchmany(self.batch)
+
+        return self.run(work)
+
+    async def execute(self, statements, bindings=None):
+        """Runs :meth:`apsw.Cursor.execute` on the worker thread, returning
+        a :class:`apsw.aio.Cursor` once the first batch of rows is
+        available::
+
+            cursor = await conn.execute("select * from items where price > ?", (10,))
+            async for row in cursor:
+                print(row)
+        """
+        cursor, description, rows = await self._execute("execute", statements, bindings)
+        return Cursor(self, cursor, description, rows)
+
+    async def executemany(self, statements, sequenceofbindings):
+        "Runs :meth:`apsw.Cursor.executemany` on the worker thread"
+        cursor, description, rows = await self._execute("executemany", statements, sequenceofbindings)
+        return Cursor(self, cursor, description, rows)
+
+    async def close(self, force=False):
+        """Closes the connection and stops the worker thread.  It is okay
+        to call this multiple times."""
+        if self._worker is None:
+            return
+        try:
+            await self.run(lambda db: db.close(force))
+        finally:
+            self._worker.stop()
+            self._worker = None
+
+    async def __aenter__(self):
+        return self
+
+    async def __aexit__(self, etype, evalue, etb):
+        await self.close()
+        return False
+
+
+class Cursor(object):
+    """Results from :meth:`apsw.aio.Connection.execute`.  Iterate with
+    ``async for``, or use :meth:`fetchone` and :meth:`fetchall`."""
+
+    def __init__(self, connection, cursor, description, rows):
+        self.connection = connection
+        "The :class:`apsw.aio.Connection`"
+        self.cursor = cursor
+        "The underlying :class:`apsw.Cursor` which must only be used via :meth:`apsw.aio.Connection.run`"
+        self._description = description
+        self._rows = rows
+        self._pos = 0
+        self._done = len(rows) < connection.batch
+
+    def getdescription(self):
+        """Returns :meth:`apsw.Cursor.getdescription` for the first
+        statement that returned rows, or the first statement if none
+        did.  Unlike the underlying cursor it is available even when
+        there are no rows, or all of them have been fetched.
+        :exc:`apsw.ExecutionCompleteError` is raised if it can't be
+        found, such as for :meth:`executemany` with no bindings."""
+        if self._description is None:
+            raise apsw.ExecutionCompleteError("Can't get description for statements that have completed execution")
+        return self._description
+
+    async def _fill(self):
+        if self._pos < len(self._rows) or self._done:
+            return
+        batch = self.connection.batch
+        self._rows = await self.connection.run(lambda db: self.cursor.fetchmany(batch))
+        self._pos = 0
+        self._done = len(self._rows) < batch
+
+    async def fetchone(self):
+        "Returns the next row or None if there are no more"
+        await self._fill()
+        if self._pos < len(self._rows):
+            self._pos += 1
+            return self._rows[self._pos - 1]
+        return None
+
+    async def fetchall(self):
+        "Returns all the remaining rows as a list"
+        rows = self._rows[self._pos:]
+        self._rows, self._pos = [], 0
+        if not self._done:
+            self._done = True
+            rows.extend(await self.connection.run(lambda db: self.cursor.fetchall()))
+        return rows
+
+    def __aiter__(self):
+        return self
+
+    async def __anext__(self):
+        await self._fill()
+        if self._pos < len(self._rows):
+            self._pos += 1
+            return self._rows[self._pos - 1]
+        raise StopAsyncIteration
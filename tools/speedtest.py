@@ -402,6 +402,34 @@ def doit():
         "pysqlite individual statements without bindings"
         return pysqlite_statements(con, withoutbindings)
 
+    # A wide table (as found in reporting queries) where the cost is
+    # dominated by turning each row into Python objects.  The table is
+    # filled before timing starts so only the reading is measured.
+    widerows_columns = 40
+    widerows_count = options.scale * 5000
+
+    def widerows_prepare(con):
+        cols = []
+        for i in xrange(widerows_columns):
+            cols.append(("c%d" % i, ("x", "x*1.5", "'row '||x", "null")[i % 4]))
+        cursor = con.cursor()
+        cursor.execute("CREATE TABLE wide(%s)" % (", ".join([c[0] for c in cols]), ))
+        cursor.execute(
+            "WITH RECURSIVE counter(x) AS (VALUES(1) UNION ALL SELECT x+1 FROM counter WHERE x<%d) "
+            "INSERT INTO wide SELECT %s FROM counter" % (widerows_count, ", ".join([c[1] for c in cols])))
+
+    def apsw_widerows(con):
+        "APSW wide rows"
+        for row in con.cursor().execute("SELECT * FROM wide"):
+            pass
+        return widerows_count
+
+    def pysqlite_widerows(con):
+        "pysqlite wide rows"
+        for row in con.cursor().execute("SELECT * FROM wide"):
+            pass
+        return widerows_count
+
     # Do the work
     write("\nRunning tests - elapsed, CPU (results in seconds, lower is better)\n")
 
@@ -422,15 +450,22 @@ def doit():
                     write("\t" + func.__name__ + (" " * (40 - len(func.__name__))))
                     sys.stdout.flush()
                     con = locals().get(driver + "_setup")(options.database)
+                    prepare = locals().get(test + "_prepare", None)
+                    if prepare:
+                        prepare(con)
                     gc.collect(2)
                     b4cpu = timerfn()
                     b4 = time.time()
-                    func(con)
+                    rows = func(con)
                     con.close()  # see note above as to why we include this in the timing
                     gc.collect(2)
                     after = time.time()
                     aftercpu = timerfn()
-                    write("%0.3f %0.3f\n" % (after - b4, aftercpu - b4cpu))
+                    if rows:
+                        write("%0.3f %0.3f (%0.3f usec/row)\n" % (after - b4, aftercpu - b4cpu,
+                                                                  (after - b4) * 1000000.0 / rows))
+                    else:
+                        write("%0.3f %0.3f\n" % (after - b4, aftercpu - b4cpu))
 
     # Cleanup if using valgrind
     if options.apsw:
@@ -533,6 +568,14 @@ statements_nobindings:
   In theory all the tests above should run in almost identical time
   as well as when using the SQLite command line shell.  This tool
   shows you what happens in practise.
+
+widerows:
+
+  Reads every row of a 40 column table of integers, floats, text and
+  nulls (5,000 rows per unit of scale).  The table is filled before
+  timing starts, so this measures the cost of turning result rows into
+  Python objects and the time per row is also shown.  It is not run by
+  default - use --tests=widerows
     \n"""
 
 if __name__ == "__main__":